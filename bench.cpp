@@ -0,0 +1,358 @@
+#include "set.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef SG_PLOTS_DIR
+#define SG_PLOTS_DIR "plots"
+#endif
+
+namespace
+{
+    // Number of operations timed together as one sample: a sample takes
+    // long enough for the clock to resolve it, and short enough for
+    // the percentiles to show the slow ones.
+    constexpr unsigned int batch_size = 64;
+
+    using bench_clock_t = std::chrono::steady_clock;
+
+    // Keys are made from even numbers, and the odd number right after
+    // every key makes a key that is surely missing. The 64-bit keys don't
+    // fit in 32 bits, and the strings don't fit in the small string buffer;
+    // both keep the order of the numbers.
+    template <typename Tkey>
+    Tkey make_key(std::uint64_t number);
+
+    template <>
+    int make_key<int>(std::uint64_t number)
+    {
+        return static_cast<int>(number);
+    }
+
+    template <>
+    std::uint64_t make_key<std::uint64_t>(std::uint64_t number)
+    {
+        return number << 24;
+    }
+
+    template <>
+    std::string make_key<std::string>(std::uint64_t number)
+    {
+        std::string digits = std::to_string(number);
+        return "key:" + std::string(16 - digits.size(), '0') + digits;
+    }
+
+    // Folds a key into a number, so that the loops reading keys can't be
+    // optimized out.
+    std::uint64_t digest(int key)
+    {
+        return key;
+    }
+
+    std::uint64_t digest(std::uint64_t key)
+    {
+        return key;
+    }
+
+    std::uint64_t digest(const std::string& key)
+    {
+        return key.size() + key.back();
+    }
+
+    enum class distribution_t
+    {
+        uniform,
+        sequential,
+        zipf
+    };
+
+    const char* distribution_name(distribution_t distribution)
+    {
+        switch(distribution)
+        {
+        case distribution_t::uniform:
+            return "uniform";
+        case distribution_t::sequential:
+            return "sequential";
+        default:
+            return "zipf";
+        }
+    }
+
+    // Generates the numbers of count keys to insert, all even: uniformly
+    // random ones, increasing ones, or ones drawn from the Zipf
+    // distribution (s = 0.99) over count random numbers, where the most
+    // frequent number comes up about every tenth time and most of the others
+    // hardly ever, so that many insertions are duplicates.
+    std::vector<std::uint64_t> generate_numbers(distribution_t distribution, unsigned int count, std::mt19937_64& engine)
+    {
+        constexpr std::uint64_t number_range = 1000000000;
+        std::uniform_int_distribution<std::uint64_t> uniform{0, number_range};
+
+        std::vector<std::uint64_t> numbers(count);
+        if(distribution == distribution_t::sequential)
+        {
+            for(unsigned int i = 0; i < count; ++i)
+            {
+                numbers[i] = 2 * static_cast<std::uint64_t>(i);
+            }
+        }
+        else if(distribution == distribution_t::uniform)
+        {
+            for(std::uint64_t& number : numbers)
+            {
+                number = 2 * uniform(engine);
+            }
+        }
+        else
+        {
+            std::vector<double> weights(count);
+            double total = 0;
+            for(unsigned int rank = 0; rank < count; ++rank)
+            {
+                total += 1 / std::pow(rank + 1, 0.99);
+                weights[rank] = total;
+            }
+            std::vector<std::uint64_t> ranked(count);
+            for(std::uint64_t& number : ranked)
+            {
+                number = 2 * uniform(engine);
+            }
+            std::uniform_real_distribution<double> real{0, total};
+            for(std::uint64_t& number : numbers)
+            {
+                std::size_t rank = std::lower_bound(weights.begin(), weights.end(), real(engine)) - weights.begin();
+                number = ranked[std::min<std::size_t>(rank, count - 1)];
+            }
+        }
+        return numbers;
+    }
+
+    template <typename Tkey, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded>
+    bool contains(sg::set<Tkey, Tcompare, Tallocator, Vranked, Vthreaded>& set, const Tkey& key)
+    {
+        return set.search(key) != set.end();
+    }
+
+    template <typename Tkey>
+    bool contains(std::set<Tkey>& set, const Tkey& key)
+    {
+        return set.find(key) != set.end();
+    }
+
+    // Nanoseconds per operation of every sample, and of the whole run.
+    struct samples_t
+    {
+        std::vector<double> per_operation;
+        double total_time = 0;
+        std::uint64_t operation_count = 0;
+
+        void add(bench_clock_t::duration duration, unsigned int count)
+        {
+            double time = std::chrono::duration<double, std::nano>(duration).count();
+            per_operation.push_back(time / count);
+            total_time += time;
+            operation_count += count;
+        }
+
+        double mean() const
+        {
+            return operation_count == 0 ? 0 : total_time / operation_count;
+        }
+
+        double percentile(double fraction)
+        {
+            if(per_operation.empty())
+                return 0;
+            std::size_t index = std::min<std::size_t>(per_operation.size() - 1, fraction * per_operation.size());
+            std::nth_element(per_operation.begin(), per_operation.begin() + index, per_operation.end());
+            return per_operation[index];
+        }
+    };
+
+    constexpr std::size_t operation_count = 6;
+    constexpr std::array<const char*, operation_count> operation_names
+    {
+        "insert",
+        "search_hit",
+        "search_miss",
+        "iterate",
+        "copy",
+        "teardown",
+    };
+
+    // Runs every operation on a set of the given type round_count times:
+    // inserts the keys (timed in batches), searches for all of them and
+    // for as many missing keys in the same order, iterates over the set,
+    // copies it and destroys it. A copy or a teardown is one sample of
+    // the whole set, divided by its size.
+    template <typename Tset, typename Tkey>
+    std::array<samples_t, operation_count> run_operations(const std::vector<Tkey>& keys, const std::vector<Tkey>& missing,
+                                                          unsigned int round_count, std::uint64_t& sink, std::size_t& set_size)
+    {
+        std::array<samples_t, operation_count> samples;
+        for(unsigned int round = 0; round < round_count; ++round)
+        {
+            Tset* set = new Tset;
+
+            for(std::size_t first = 0; first < keys.size(); first += batch_size)
+            {
+                std::size_t last = std::min(keys.size(), first + batch_size);
+                auto start = bench_clock_t::now();
+                for(std::size_t i = first; i < last; ++i)
+                {
+                    set->insert(keys[i]);
+                }
+                samples[0].add(bench_clock_t::now() - start, last - first);
+            }
+            set_size = set->size();
+
+            for(int kind = 1; kind <= 2; ++kind)
+            {
+                const std::vector<Tkey>& searched = kind == 1 ? keys : missing;
+                for(std::size_t first = 0; first < searched.size(); first += batch_size)
+                {
+                    std::size_t last = std::min(searched.size(), first + batch_size);
+                    unsigned int found = 0;
+                    auto start = bench_clock_t::now();
+                    for(std::size_t i = first; i < last; ++i)
+                    {
+                        found += contains(*set, searched[i]);
+                    }
+                    samples[kind].add(bench_clock_t::now() - start, last - first);
+                    sink += found;
+                }
+            }
+
+            auto iter = set->begin();
+            auto end = set->end();
+            while(iter != end)
+            {
+                unsigned int count = 0;
+                auto start = bench_clock_t::now();
+                for(; count < batch_size && iter != end; ++count, ++iter)
+                {
+                    sink += digest(*iter);
+                }
+                samples[3].add(bench_clock_t::now() - start, count);
+            }
+
+            auto copy_start = bench_clock_t::now();
+            Tset* copy = new Tset{*set};
+            samples[4].add(bench_clock_t::now() - copy_start, std::max<std::size_t>(1, set_size));
+            sink += copy->size();
+            delete copy;
+
+            auto teardown_start = bench_clock_t::now();
+            delete set;
+            samples[5].add(bench_clock_t::now() - teardown_start, std::max<std::size_t>(1, set_size));
+        }
+        return samples;
+    }
+
+    // Prints the results of one container and writes them to the CSV file.
+    void report(const char* container, const char* key_name, distribution_t distribution, unsigned int size, std::size_t set_size,
+                std::array<samples_t, operation_count>& samples, const std::string& label, std::ofstream& csv)
+    {
+        std::cout << std::setw(8) << container << "; key: " << std::setw(6) << key_name << "; ";
+        std::cout << std::setw(10) << distribution_name(distribution) << "; size: " << std::setw(8) << set_size << "; ";
+        std::cout << "ns/op p50/p99:" << std::fixed << std::setprecision(1);
+        for(std::size_t operation = 0; operation < operation_count; ++operation)
+        {
+            double p50 = samples[operation].percentile(0.5);
+            double p99 = samples[operation].percentile(0.99);
+            std::cout << " " << operation_names[operation] << " " << p50 << "/" << p99;
+
+            csv << label << "," << container << "," << key_name << "," << distribution_name(distribution) << ",";
+            csv << size << "," << set_size << "," << operation_names[operation] << ",";
+            csv << samples[operation].mean() << "," << p50 << "," << p99 << "\n";
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+
+    // Benchmarks sg::set against std::set for keys of one type in every
+    // distribution and size.
+    template <typename Tkey>
+    void bench_key_type(const char* key_name, const std::vector<unsigned int>& sizes, const std::string& label, std::ofstream& csv)
+    {
+        std::uint64_t sink = 0;
+        for(distribution_t distribution : {distribution_t::uniform, distribution_t::sequential, distribution_t::zipf})
+        {
+            for(unsigned int size : sizes)
+            {
+                // The same keys for both sets; small sets are run more times,
+                // so that every size gets about as many samples.
+                std::mt19937_64 engine{size};
+                std::vector<std::uint64_t> numbers = generate_numbers(distribution, size, engine);
+                std::vector<Tkey> keys;
+                std::vector<Tkey> missing;
+                keys.reserve(size);
+                missing.reserve(size);
+                for(std::uint64_t number : numbers)
+                {
+                    keys.push_back(make_key<Tkey>(number));
+                    missing.push_back(make_key<Tkey>(number + 1));
+                }
+                unsigned int round_count = std::max(3u, 1000000 / size);
+
+                std::size_t set_size = 0;
+                auto sg_samples = run_operations<sg::set<Tkey>>(keys, missing, round_count, sink, set_size);
+                report("sg::set", key_name, distribution, size, set_size, sg_samples, label, csv);
+                auto stl_samples = run_operations<std::set<Tkey>>(keys, missing, round_count, sink, set_size);
+                report("std::set", key_name, distribution, size, set_size, stl_samples, label, csv);
+            }
+        }
+
+        // The sink is printed only to keep the operations from being optimized out.
+        if(sink == 42)
+            std::cout << sink << std::endl;
+    }
+
+} // unnamed namespace
+
+// Usage: red_black_tree_2_bench [label [max_size]]
+//
+// Writes plots/bench_<label>.csv (the label defaults to "current"), with
+// one row per container, key type, distribution, size and operation:
+// mean, median and 99th percentile time of an operation in nanoseconds.
+// Comparing the files of two versions shows the regressions between them.
+int main(int argc, char** argv)
+{
+    std::string label = argc > 1 ? argv[1] : "current";
+    unsigned int max_size = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+
+    std::vector<unsigned int> sizes;
+    for(unsigned int size = 1000; size <= max_size; size *= 10)
+    {
+        sizes.push_back(size);
+    }
+
+    std::string path = std::string{SG_PLOTS_DIR} + "/bench_" + label + ".csv";
+    std::ofstream csv{path, std::ios::trunc};
+    if(!csv)
+    {
+        std::cerr << "Can't write " << path << std::endl;
+        return 1;
+    }
+    csv << std::fixed << std::setprecision(2);
+    csv << "label,container,key,distribution,operations,size,operation,mean_ns,p50_ns,p99_ns\n";
+
+    bench_key_type<int>("int", sizes, label, csv);
+    bench_key_type<std::uint64_t>("uint64", sizes, label, csv);
+    bench_key_type<std::string>("string", sizes, label, csv);
+
+    std::cout << "Results written to " << path << std::endl;
+    return 0;
+}
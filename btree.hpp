@@ -0,0 +1,609 @@
+#ifndef __BTREE_HPP__
+#define __BTREE_HPP__
+
+#include "compare.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace sg
+{
+    // Node of a B-tree: up to capacity sorted values, stored inline, so that
+    // a search compares against many values per cache miss instead of one.
+    // Leaves have no children and take only this part; internal nodes
+    // extend it with the array of children (see btree_inner_t).
+    //
+    // Values must be default-constructible, the unused slots hold
+    // default values.
+    template <typename Tvalue>
+    struct alignas(64) btree_node_t
+    {
+        // Nodes take about four cache lines; the capacity is odd, so that
+        // a full node splits into two halves around its middle value.
+        static constexpr std::size_t node_size = 256;
+        static constexpr std::size_t header_size = sizeof(void*) + 3 * sizeof(unsigned short);
+        static constexpr std::size_t fit = node_size > header_size + 3 * sizeof(Tvalue) ?
+                                           (node_size - header_size) / sizeof(Tvalue) : 3;
+        static constexpr std::size_t capacity = fit % 2 == 1 ? fit : fit - 1;
+
+        sg::btree_node_t<Tvalue>* __parent = nullptr;
+        unsigned short __count = 0;    // Number of values in the node
+        unsigned short __position = 0; // Index of the node among the children of its parent
+        bool __leaf = true;
+        Tvalue __values[capacity];
+    };
+
+    template <typename Tvalue>
+    struct btree_inner_t : public sg::btree_node_t<Tvalue>
+    {
+        sg::btree_node_t<Tvalue>* __children[sg::btree_node_t<Tvalue>::capacity + 1] = {};
+    };
+
+    // Sorted set of unique values kept in a B-tree: the same interface as
+    // sg::set for searching, inserting and iterating, but with wide nodes,
+    // which take less memory per value and less cache misses per search.
+    template <typename Tvalue, typename Tcompare = std::less<Tvalue>>
+    class btree_set
+    {
+    public:
+        btree_set();
+        explicit btree_set(const Tcompare& compare);
+        template <typename Titerator> btree_set(Titerator first, Titerator last);
+        btree_set(const sg::btree_set<Tvalue, Tcompare>& obj);
+        btree_set(sg::btree_set<Tvalue, Tcompare>&& obj);
+        ~btree_set();
+
+        sg::btree_set<Tvalue, Tcompare>& operator=(const sg::btree_set<Tvalue, Tcompare>& obj);
+        sg::btree_set<Tvalue, Tcompare>& operator=(sg::btree_set<Tvalue, Tcompare>&& obj);
+
+        class iterator
+        {
+        public:
+            iterator() = delete;
+
+            const Tvalue& operator->();
+            const Tvalue& operator*();
+            sg::btree_set<Tvalue, Tcompare>::iterator operator++();
+            sg::btree_set<Tvalue, Tcompare>::iterator operator++(int);
+            sg::btree_set<Tvalue, Tcompare>::iterator operator--();
+            sg::btree_set<Tvalue, Tcompare>::iterator operator--(int);
+            bool operator==(sg::btree_set<Tvalue, Tcompare>::iterator iter);
+            bool operator!=(sg::btree_set<Tvalue, Tcompare>::iterator iter);
+
+        private:
+            iterator(sg::btree_node_t<Tvalue>* node, unsigned int index, const sg::btree_set<Tvalue, Tcompare>* set);
+            sg::btree_node_t<Tvalue>* __node = nullptr; // nullptr for the end
+            unsigned int __index = 0;
+            const sg::btree_set<Tvalue, Tcompare>* __set = nullptr;
+            friend class sg::btree_set<Tvalue, Tcompare>;
+        };
+
+        sg::btree_set<Tvalue, Tcompare>::iterator search(const Tvalue& value);
+        template <typename Tkey, typename Tc = Tcompare, typename = typename Tc::is_transparent>
+        sg::btree_set<Tvalue, Tcompare>::iterator search(const Tkey& key);
+        std::pair<sg::btree_set<Tvalue, Tcompare>::iterator, bool> insert(const Tvalue& value);
+        sg::btree_set<Tvalue, Tcompare>::iterator begin();
+        sg::btree_set<Tvalue, Tcompare>::iterator end();
+        void clear();
+
+        unsigned int size();
+
+    protected:
+        using node_t = sg::btree_node_t<Tvalue>;
+        using inner_t = sg::btree_inner_t<Tvalue>;
+
+        template <typename Ta, typename Tb> bool less(const Ta& a, const Tb& b) const;
+        template <typename Tkey> unsigned int lower_index(const node_t* node, const Tkey& key) const;
+        template <typename Tkey> sg::btree_set<Tvalue, Tcompare>::iterator lookup(const Tkey& key);
+        static node_t* child(node_t* node, unsigned int index);
+        static void set_child(node_t* node, unsigned int index, node_t* child);
+        void split_child(node_t* parent, unsigned int index);
+        static node_t* leftmost(node_t* node);
+        static node_t* rightmost(node_t* node);
+        static void destroy_subtree(node_t* node);
+        static node_t* clone_subtree(const node_t* source, node_t* parent);
+
+    private:
+        node_t* __root = nullptr;
+        unsigned int __size = 0;
+        Tcompare __compare;
+    };
+
+} // namespace sg
+
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::btree_set<Tvalue, Tcompare>::btree_set()
+{
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::btree_set<Tvalue, Tcompare>::btree_set(const Tcompare& compare) :
+    __compare{compare}
+{
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Titerator>
+inline
+sg::btree_set<Tvalue, Tcompare>::btree_set(Titerator first, Titerator last)
+{
+    for(; first != last; ++first)
+    {
+        insert(*first);
+    }
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::btree_set<Tvalue, Tcompare>::btree_set(const sg::btree_set<Tvalue, Tcompare>& obj) :
+    __compare{obj.__compare}
+{
+    if(obj.__root != nullptr)
+        __root = clone_subtree(obj.__root, nullptr);
+    __size = obj.__size;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::btree_set<Tvalue, Tcompare>::btree_set(sg::btree_set<Tvalue, Tcompare>&& obj) :
+    __root{obj.__root}, __size{obj.__size}, __compare{obj.__compare}
+{
+    obj.__root = nullptr;
+    obj.__size = 0;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::btree_set<Tvalue, Tcompare>::~btree_set()
+{
+    clear();
+}
+
+template <typename Tvalue, typename Tcompare>
+inline sg::btree_set<Tvalue, Tcompare>&
+sg::btree_set<Tvalue, Tcompare>::operator=(const sg::btree_set<Tvalue, Tcompare>& obj)
+{
+    if(this != &obj)
+    {
+        // The copy is made first, so that the set stays intact if it throws.
+        node_t* root = obj.__root != nullptr ? clone_subtree(obj.__root, nullptr) : nullptr;
+        clear();
+        __root = root;
+        __size = obj.__size;
+        __compare = obj.__compare;
+    }
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline sg::btree_set<Tvalue, Tcompare>&
+sg::btree_set<Tvalue, Tcompare>::operator=(sg::btree_set<Tvalue, Tcompare>&& obj)
+{
+    if(this != &obj)
+    {
+        clear();
+        __root = obj.__root;
+        __size = obj.__size;
+        __compare = obj.__compare;
+        obj.__root = nullptr;
+        obj.__size = 0;
+    }
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::btree_set<Tvalue, Tcompare>::iterator
+sg::btree_set<Tvalue, Tcompare>::search(const Tvalue& value)
+{
+    return lookup(value);
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Tkey, typename Tc, typename>
+inline typename sg::btree_set<Tvalue, Tcompare>::iterator
+sg::btree_set<Tvalue, Tcompare>::search(const Tkey& key)
+{
+    return lookup(key);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::pair<typename sg::btree_set<Tvalue, Tcompare>::iterator, bool>
+sg::btree_set<Tvalue, Tcompare>::insert(const Tvalue& value)
+{
+    // Returns the iterator to the value and whether it's just been
+    // inserted, the same as sg::set does.
+    if(__root == nullptr)
+        __root = new node_t;
+
+    // Full nodes are split on the way down, so that there's always room
+    // for the value that a split of a child pushes up; a full root is split
+    // into a new root with two children, which is how the tree grows.
+    if(__root->__count == node_t::capacity)
+    {
+        inner_t* root = new inner_t;
+        root->__leaf = false;
+        set_child(root, 0, __root);
+        __root = root;
+        split_child(__root, 0);
+    }
+
+    node_t* node = __root;
+    while(true)
+    {
+        unsigned int index = lower_index(node, value);
+        if(index < node->__count && !less(value, node->__values[index]))
+            return {sg::btree_set<Tvalue, Tcompare>::iterator{node, index, this}, false};
+
+        if(node->__leaf)
+        {
+            std::move_backward(node->__values + index, node->__values + node->__count, node->__values + node->__count + 1);
+            node->__values[index] = value;
+            ++node->__count;
+            ++__size;
+            return {sg::btree_set<Tvalue, Tcompare>::iterator{node, index, this}, true};
+        }
+
+        if(child(node, index)->__count == node_t::capacity)
+        {
+            split_child(node, index);
+
+            // The middle value of the child now sits at the index and may be
+            // the value itself, or the value may belong to the right half.
+            if(!less(value, node->__values[index]))
+            {
+                if(!less(node->__values[index], value))
+                    return {sg::btree_set<Tvalue, Tcompare>::iterator{node, index, this}, false};
+                ++index;
+            }
+        }
+        node = child(node, index);
+    }
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::btree_set<Tvalue, Tcompare>::iterator
+sg::btree_set<Tvalue, Tcompare>::begin()
+{
+    if(__root == nullptr || __size == 0)
+        return end();
+    return sg::btree_set<Tvalue, Tcompare>::iterator{leftmost(__root), 0, this};
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::btree_set<Tvalue, Tcompare>::iterator
+sg::btree_set<Tvalue, Tcompare>::end()
+{
+    return sg::btree_set<Tvalue, Tcompare>::iterator{nullptr, 0, this};
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::btree_set<Tvalue, Tcompare>::clear()
+{
+    if(__root != nullptr)
+        destroy_subtree(__root);
+    __root = nullptr;
+    __size = 0;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline unsigned int
+sg::btree_set<Tvalue, Tcompare>::size()
+{
+    return __size;
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Ta, typename Tb>
+inline bool
+sg::btree_set<Tvalue, Tcompare>::less(const Ta& a, const Tb& b) const
+{
+    if constexpr(sg::is_three_way<Tcompare>::value)
+        return __compare(a, b) < 0;
+    else
+        return __compare(a, b);
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Tkey>
+inline unsigned int
+sg::btree_set<Tvalue, Tcompare>::lower_index(const node_t* node, const Tkey& key) const
+{
+    // Index of the first value of the node that isn't less than the key.
+    // For arithmetic values it's the number of values less than the key:
+    // the loop has no branches and no dependencies between its steps,
+    // so the compiler turns it into vector comparisons, which for a node
+    // of a few cache lines are faster than a binary search.
+    if constexpr(std::is_arithmetic<Tvalue>::value)
+    {
+        unsigned int index = 0;
+        for(unsigned int i = 0; i < node->__count; ++i)
+        {
+            index += less(node->__values[i], key);
+        }
+        return index;
+    }
+    else
+    {
+        const Tvalue* found = std::lower_bound(node->__values, node->__values + node->__count, key,
+                                               [this](const Tvalue& value, const Tkey& searched) { return less(value, searched); });
+        return found - node->__values;
+    }
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Tkey>
+inline typename sg::btree_set<Tvalue, Tcompare>::iterator
+sg::btree_set<Tvalue, Tcompare>::lookup(const Tkey& key)
+{
+    node_t* node = __root;
+    while(node != nullptr)
+    {
+        unsigned int index = lower_index(node, key);
+        if(index < node->__count && !less(key, node->__values[index]))
+            return sg::btree_set<Tvalue, Tcompare>::iterator{node, index, this};
+        node = node->__leaf ? nullptr : child(node, index);
+    }
+    return end();
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::btree_set<Tvalue, Tcompare>::node_t*
+sg::btree_set<Tvalue, Tcompare>::child(node_t* node, unsigned int index)
+{
+    return static_cast<inner_t*>(node)->__children[index];
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::btree_set<Tvalue, Tcompare>::set_child(node_t* node, unsigned int index, node_t* child)
+{
+    static_cast<inner_t*>(node)->__children[index] = child;
+    child->__parent = node;
+    child->__position = index;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::btree_set<Tvalue, Tcompare>::split_child(node_t* parent, unsigned int index)
+{
+    // Splits the full child at the index into two halves; the middle value
+    // goes up to the parent, between the halves. The parent isn't full.
+    constexpr unsigned int half = node_t::capacity / 2;
+
+    node_t* left = child(parent, index);
+    node_t* right = nullptr;
+    if(left->__leaf)
+    {
+        right = new node_t;
+    }
+    else
+    {
+        right = new inner_t;
+        right->__leaf = false;
+        for(unsigned int i = 0; i <= half; ++i)
+        {
+            set_child(right, i, child(left, half + 1 + i));
+        }
+    }
+    std::move(left->__values + half + 1, left->__values + node_t::capacity, right->__values);
+    right->__count = half;
+    left->__count = half;
+
+    for(unsigned int i = parent->__count; i > index; --i)
+    {
+        set_child(parent, i + 1, child(parent, i));
+    }
+    set_child(parent, index + 1, right);
+    std::move_backward(parent->__values + index, parent->__values + parent->__count, parent->__values + parent->__count + 1);
+    parent->__values[index] = std::move(left->__values[half]);
+    ++parent->__count;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::btree_set<Tvalue, Tcompare>::node_t*
+sg::btree_set<Tvalue, Tcompare>::leftmost(node_t* node)
+{
+    while(!node->__leaf)
+    {
+        node = child(node, 0);
+    }
+    return node;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::btree_set<Tvalue, Tcompare>::node_t*
+sg::btree_set<Tvalue, Tcompare>::rightmost(node_t* node)
+{
+    while(!node->__leaf)
+    {
+        node = child(node, node->__count);
+    }
+    return node;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::btree_set<Tvalue, Tcompare>::destroy_subtree(node_t* node)
+{
+    // The recursion is as deep as the tree, which is only a few levels.
+    if(node->__leaf)
+    {
+        delete node;
+    }
+    else
+    {
+        for(unsigned int i = 0; i <= node->__count; ++i)
+        {
+            destroy_subtree(child(node, i));
+        }
+        delete static_cast<inner_t*>(node);
+    }
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::btree_set<Tvalue, Tcompare>::node_t*
+sg::btree_set<Tvalue, Tcompare>::clone_subtree(const node_t* source, node_t* parent)
+{
+    node_t* node = nullptr;
+    if(source->__leaf)
+    {
+        node = new node_t;
+    }
+    else
+    {
+        node = new inner_t;
+        node->__leaf = false;
+    }
+    node->__parent = parent;
+    node->__position = source->__position;
+    node->__count = source->__count;
+    std::copy(source->__values, source->__values + source->__count, node->__values);
+
+    if(!source->__leaf)
+    {
+        unsigned int cloned = 0;
+        try
+        {
+            for(; cloned <= source->__count; ++cloned)
+            {
+                set_child(node, cloned, clone_subtree(child(const_cast<node_t*>(source), cloned), node));
+            }
+        }
+        catch(...)
+        {
+            for(unsigned int i = 0; i < cloned; ++i)
+            {
+                destroy_subtree(child(node, i));
+            }
+            delete static_cast<inner_t*>(node);
+            throw;
+        }
+    }
+    return node;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::btree_set<Tvalue, Tcompare>::iterator::iterator(sg::btree_node_t<Tvalue>* node, unsigned int index,
+                                                    const sg::btree_set<Tvalue, Tcompare>* set) :
+    __node(node), __index(index), __set(set)
+{
+}
+
+template <typename Tvalue, typename Tcompare>
+inline const Tvalue&
+sg::btree_set<Tvalue, Tcompare>::iterator::operator->()
+{
+    return operator*();
+}
+
+template <typename Tvalue, typename Tcompare>
+inline const Tvalue&
+sg::btree_set<Tvalue, Tcompare>::iterator::operator*()
+{
+    if(__node == nullptr)
+        throw std::runtime_error{"sg::btree_set::iterator out of range"};
+    return __node->__values[__index];
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::btree_set<Tvalue, Tcompare>::iterator
+sg::btree_set<Tvalue, Tcompare>::iterator::operator++()
+{
+    if(__node == nullptr)
+        throw std::runtime_error{"sg::btree_set::iterator out of range"};
+
+    // The next value is the first one of the subtree to the right of
+    // the current one, or, if there's no such subtree, the next value in
+    // the node; past the last value of a node, it's the value of
+    // the closest ancestor the node is to the left of.
+    if(!__node->__leaf)
+    {
+        __node = sg::btree_set<Tvalue, Tcompare>::leftmost(sg::btree_set<Tvalue, Tcompare>::child(__node, __index + 1));
+        __index = 0;
+        return *this;
+    }
+
+    ++__index;
+    while(__node != nullptr && __index == __node->__count)
+    {
+        __index = __node->__position;
+        __node = __node->__parent;
+    }
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::btree_set<Tvalue, Tcompare>::iterator
+sg::btree_set<Tvalue, Tcompare>::iterator::operator++(int)
+{
+    sg::btree_set<Tvalue, Tcompare>::iterator old = *this;
+    operator++();
+    return old;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::btree_set<Tvalue, Tcompare>::iterator
+sg::btree_set<Tvalue, Tcompare>::iterator::operator--()
+{
+    sg::btree_node_t<Tvalue>* node = __node;
+    unsigned int index = __index;
+
+    if(node == nullptr)
+    {
+        if(__set->__root == nullptr || __set->__size == 0)
+            throw std::runtime_error{"sg::btree_set::iterator out of range"};
+        node = sg::btree_set<Tvalue, Tcompare>::rightmost(__set->__root);
+        index = node->__count;
+    }
+    else if(!node->__leaf)
+    {
+        node = sg::btree_set<Tvalue, Tcompare>::rightmost(sg::btree_set<Tvalue, Tcompare>::child(node, index));
+        index = node->__count;
+    }
+
+    while(index == 0)
+    {
+        if(node->__parent == nullptr)
+            throw std::runtime_error{"sg::btree_set::iterator out of range"};
+        index = node->__position;
+        node = node->__parent;
+    }
+
+    __node = node;
+    __index = index - 1;
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::btree_set<Tvalue, Tcompare>::iterator
+sg::btree_set<Tvalue, Tcompare>::iterator::operator--(int)
+{
+    sg::btree_set<Tvalue, Tcompare>::iterator old = *this;
+    operator--();
+    return old;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline bool
+sg::btree_set<Tvalue, Tcompare>::iterator::operator==(sg::btree_set<Tvalue, Tcompare>::iterator iter)
+{
+    return __node == iter.__node && __index == iter.__index && __set == iter.__set;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline bool
+sg::btree_set<Tvalue, Tcompare>::iterator::operator!=(sg::btree_set<Tvalue, Tcompare>::iterator iter)
+{
+    return !operator==(iter);
+}
+
+#endif // __BTREE_HPP__
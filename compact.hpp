@@ -0,0 +1,595 @@
+#ifndef __COMPACT_HPP__
+#define __COMPACT_HPP__
+
+#include "compare.hpp"
+#include "rbt.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace sg
+{
+    // Node of a compact tree: the links are 32-bit indices into the array
+    // of nodes of the tree instead of pointers, and the color takes
+    // the lowest bit of the link to the parent, so that a node of int
+    // takes 16 bytes instead of 32. Index 0 stands for a NIL; the node
+    // with index i is stored at position i - 1 of the array.
+    template <typename Tvalue>
+    struct compact_node_t
+    {
+        Tvalue __value;
+        std::uint32_t __parent_color = static_cast<std::uint32_t>(sg::color_t::red);
+        std::uint32_t __left = 0;
+        std::uint32_t __right = 0;
+    };
+
+    // Red-black tree set with compact nodes, for sets that are big
+    // and rarely shrink: the same search, insert and iterator semantics
+    // as sg::set, but all nodes live in one growing array, which halves
+    // the memory taken by a set of small values. Iterators stay valid
+    // when the array is reallocated. Up to 2^31 - 1 values can be stored.
+    template <typename Tvalue, typename Tcompare = std::less<Tvalue>>
+    class compact_set
+    {
+    public:
+        compact_set() = default;
+        explicit compact_set(const Tcompare& compare);
+        template <typename Titerator> compact_set(Titerator first, Titerator last);
+        compact_set(const sg::compact_set<Tvalue, Tcompare>& obj) = default;
+        compact_set(sg::compact_set<Tvalue, Tcompare>&& obj);
+
+        sg::compact_set<Tvalue, Tcompare>& operator=(const sg::compact_set<Tvalue, Tcompare>& obj) = default;
+        sg::compact_set<Tvalue, Tcompare>& operator=(sg::compact_set<Tvalue, Tcompare>&& obj);
+
+        class iterator
+        {
+        public:
+            iterator() = delete;
+
+            const Tvalue& operator->();
+            const Tvalue& operator*();
+            sg::compact_set<Tvalue, Tcompare>::iterator operator++();
+            sg::compact_set<Tvalue, Tcompare>::iterator operator++(int);
+            sg::compact_set<Tvalue, Tcompare>::iterator operator--();
+            sg::compact_set<Tvalue, Tcompare>::iterator operator--(int);
+            bool operator==(sg::compact_set<Tvalue, Tcompare>::iterator iter);
+            bool operator!=(sg::compact_set<Tvalue, Tcompare>::iterator iter);
+
+        private:
+            iterator(std::uint32_t node, const sg::compact_set<Tvalue, Tcompare>* set);
+            std::uint32_t __node = 0; // 0 for the end
+            const sg::compact_set<Tvalue, Tcompare>* __set = nullptr;
+            friend class sg::compact_set<Tvalue, Tcompare>;
+        };
+
+        sg::compact_set<Tvalue, Tcompare>::iterator search(const Tvalue& value);
+        template <typename Tkey, typename Tc = Tcompare, typename = typename Tc::is_transparent>
+        sg::compact_set<Tvalue, Tcompare>::iterator search(const Tkey& key);
+        std::pair<sg::compact_set<Tvalue, Tcompare>::iterator, bool> insert(const Tvalue& value);
+        sg::compact_set<Tvalue, Tcompare>::iterator begin();
+        sg::compact_set<Tvalue, Tcompare>::iterator end();
+        void reserve(unsigned int count);
+        void clear();
+
+        unsigned int size();
+        std::size_t memory_usage();
+
+    protected:
+        using node_t = sg::compact_node_t<Tvalue>;
+
+        // Largest index that still leaves the lowest bit of a link free.
+        static constexpr std::uint32_t max_index = UINT32_MAX >> 1;
+
+        node_t& node(std::uint32_t index);
+        const node_t& node(std::uint32_t index) const;
+        std::uint32_t parent(std::uint32_t index) const;
+        sg::color_t color(std::uint32_t index) const;
+        void set_parent(std::uint32_t index, std::uint32_t parent);
+        void set_color(std::uint32_t index, sg::color_t color);
+
+        template <typename Ta, typename Tb> bool less(const Ta& a, const Tb& b) const;
+        template <typename Tkey> std::uint32_t lookup(const Tkey& key) const;
+        std::uint32_t minimal(std::uint32_t index) const;
+        std::uint32_t maximal(std::uint32_t index) const;
+        std::uint32_t successor(std::uint32_t index) const;
+        std::uint32_t predecessor(std::uint32_t index) const;
+        void left_rotate(std::uint32_t upper);
+        void right_rotate(std::uint32_t upper);
+        void insert_rebalance(std::uint32_t inserted);
+
+    private:
+        std::vector<node_t> __nodes;
+        std::uint32_t __root = 0;
+        Tcompare __compare;
+    };
+
+} // namespace sg
+
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::compact_set<Tvalue, Tcompare>::compact_set(const Tcompare& compare) :
+    __compare{compare}
+{
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Titerator>
+inline
+sg::compact_set<Tvalue, Tcompare>::compact_set(Titerator first, Titerator last)
+{
+    for(; first != last; ++first)
+    {
+        insert(*first);
+    }
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::compact_set<Tvalue, Tcompare>::compact_set(sg::compact_set<Tvalue, Tcompare>&& obj) :
+    __nodes{std::move(obj.__nodes)}, __root{obj.__root}, __compare{obj.__compare}
+{
+    // Links are indices, so they stay valid in the moved array;
+    // only the moved-from set needs a reset.
+    obj.clear();
+}
+
+template <typename Tvalue, typename Tcompare>
+inline sg::compact_set<Tvalue, Tcompare>&
+sg::compact_set<Tvalue, Tcompare>::operator=(sg::compact_set<Tvalue, Tcompare>&& obj)
+{
+    if(this != &obj)
+    {
+        __nodes = std::move(obj.__nodes);
+        __root = obj.__root;
+        __compare = obj.__compare;
+        obj.clear();
+    }
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::compact_set<Tvalue, Tcompare>::iterator
+sg::compact_set<Tvalue, Tcompare>::search(const Tvalue& value)
+{
+    return sg::compact_set<Tvalue, Tcompare>::iterator{lookup(value), this};
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Tkey, typename Tc, typename>
+inline typename sg::compact_set<Tvalue, Tcompare>::iterator
+sg::compact_set<Tvalue, Tcompare>::search(const Tkey& key)
+{
+    return sg::compact_set<Tvalue, Tcompare>::iterator{lookup(key), this};
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::pair<typename sg::compact_set<Tvalue, Tcompare>::iterator, bool>
+sg::compact_set<Tvalue, Tcompare>::insert(const Tvalue& value)
+{
+    // Returns the iterator to the value and whether it's just been
+    // inserted, the same as sg::set does.
+    // One comparison per level, as in lookup.
+    std::uint32_t parent = 0;
+    std::uint32_t candidate = 0;
+    bool to_left = false;
+    for(std::uint32_t current = __root; current != 0;)
+    {
+        parent = current;
+        to_left = less(value, node(current).__value);
+        if(to_left)
+        {
+            current = node(current).__left;
+        }
+        else
+        {
+            candidate = current;
+            current = node(current).__right;
+        }
+    }
+
+    if(candidate != 0 && !less(node(candidate).__value, value))
+        return {sg::compact_set<Tvalue, Tcompare>::iterator{candidate, this}, false};
+
+    if(__nodes.size() == max_index)
+        throw std::length_error{"sg::compact_set is full"};
+
+    __nodes.push_back(node_t{value});
+    std::uint32_t inserted = __nodes.size();
+    set_parent(inserted, parent);
+
+    if(parent == 0)
+        __root = inserted;
+    else if(to_left)
+        node(parent).__left = inserted;
+    else
+        node(parent).__right = inserted;
+
+    insert_rebalance(inserted);
+    return {sg::compact_set<Tvalue, Tcompare>::iterator{inserted, this}, true};
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::compact_set<Tvalue, Tcompare>::iterator
+sg::compact_set<Tvalue, Tcompare>::begin()
+{
+    return sg::compact_set<Tvalue, Tcompare>::iterator{minimal(__root), this};
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::compact_set<Tvalue, Tcompare>::iterator
+sg::compact_set<Tvalue, Tcompare>::end()
+{
+    return sg::compact_set<Tvalue, Tcompare>::iterator{0, this};
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::compact_set<Tvalue, Tcompare>::reserve(unsigned int count)
+{
+    // A set of known size is filled without reallocations, and without
+    // the spare capacity that the growth of the array leaves.
+    __nodes.reserve(count);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::compact_set<Tvalue, Tcompare>::clear()
+{
+    __nodes.clear();
+    __root = 0;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline unsigned int
+sg::compact_set<Tvalue, Tcompare>::size()
+{
+    return __nodes.size();
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::size_t
+sg::compact_set<Tvalue, Tcompare>::memory_usage()
+{
+    return sizeof(*this) + __nodes.capacity() * sizeof(node_t);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::compact_set<Tvalue, Tcompare>::node_t&
+sg::compact_set<Tvalue, Tcompare>::node(std::uint32_t index)
+{
+    return __nodes[index - 1];
+}
+
+template <typename Tvalue, typename Tcompare>
+inline const typename sg::compact_set<Tvalue, Tcompare>::node_t&
+sg::compact_set<Tvalue, Tcompare>::node(std::uint32_t index) const
+{
+    return __nodes[index - 1];
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::uint32_t
+sg::compact_set<Tvalue, Tcompare>::parent(std::uint32_t index) const
+{
+    return node(index).__parent_color >> 1;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline sg::color_t
+sg::compact_set<Tvalue, Tcompare>::color(std::uint32_t index) const
+{
+    // NILs are black.
+    if(index == 0)
+        return sg::color_t::black;
+    return static_cast<sg::color_t>(node(index).__parent_color & 1);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::compact_set<Tvalue, Tcompare>::set_parent(std::uint32_t index, std::uint32_t parent)
+{
+    node(index).__parent_color = (parent << 1) | (node(index).__parent_color & 1);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::compact_set<Tvalue, Tcompare>::set_color(std::uint32_t index, sg::color_t color)
+{
+    node(index).__parent_color = (node(index).__parent_color & ~std::uint32_t{1}) | static_cast<std::uint32_t>(color);
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Ta, typename Tb>
+inline bool
+sg::compact_set<Tvalue, Tcompare>::less(const Ta& a, const Tb& b) const
+{
+    if constexpr(sg::is_three_way<Tcompare>::value)
+        return __compare(a, b) < 0;
+    else
+        return __compare(a, b);
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Tkey>
+inline std::uint32_t
+sg::compact_set<Tvalue, Tcompare>::lookup(const Tkey& key) const
+{
+    // One comparison per level, as in rbt_t: the last node whose value
+    // isn't greater than the key is the only candidate for equality.
+    std::uint32_t candidate = 0;
+    for(std::uint32_t current = __root; current != 0;)
+    {
+        if(less(key, node(current).__value))
+        {
+            current = node(current).__left;
+        }
+        else
+        {
+            candidate = current;
+            current = node(current).__right;
+        }
+    }
+
+    if(candidate != 0 && less(node(candidate).__value, key))
+        candidate = 0;
+    return candidate;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::uint32_t
+sg::compact_set<Tvalue, Tcompare>::minimal(std::uint32_t index) const
+{
+    if(index != 0)
+    {
+        while(node(index).__left != 0)
+            index = node(index).__left;
+    }
+    return index;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::uint32_t
+sg::compact_set<Tvalue, Tcompare>::maximal(std::uint32_t index) const
+{
+    if(index != 0)
+    {
+        while(node(index).__right != 0)
+            index = node(index).__right;
+    }
+    return index;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::uint32_t
+sg::compact_set<Tvalue, Tcompare>::successor(std::uint32_t index) const
+{
+    if(node(index).__right != 0)
+        return minimal(node(index).__right);
+
+    std::uint32_t upper = parent(index);
+    while(upper != 0 && index == node(upper).__right)
+    {
+        index = upper;
+        upper = parent(upper);
+    }
+    return upper;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::uint32_t
+sg::compact_set<Tvalue, Tcompare>::predecessor(std::uint32_t index) const
+{
+    if(node(index).__left != 0)
+        return maximal(node(index).__left);
+
+    std::uint32_t upper = parent(index);
+    while(upper != 0 && index == node(upper).__left)
+    {
+        index = upper;
+        upper = parent(upper);
+    }
+    return upper;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::compact_set<Tvalue, Tcompare>::left_rotate(std::uint32_t upper)
+{
+    // Same as rbt_t::left_rotate, with indices for links.
+    std::uint32_t lower = node(upper).__right;
+    std::uint32_t parent = this->parent(upper);
+    std::uint32_t middle = node(lower).__left;
+
+    if(parent != 0)
+    {
+        if(node(parent).__left == upper)
+            node(parent).__left = lower;
+        else
+            node(parent).__right = lower;
+    }
+    else
+    {
+        __root = lower;
+    }
+
+    set_parent(lower, parent);
+    node(lower).__left = upper;
+
+    set_parent(upper, lower);
+    node(upper).__right = middle;
+
+    if(middle != 0)
+        set_parent(middle, upper);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::compact_set<Tvalue, Tcompare>::right_rotate(std::uint32_t upper)
+{
+    // Same as rbt_t::right_rotate, with indices for links.
+    std::uint32_t lower = node(upper).__left;
+    std::uint32_t parent = this->parent(upper);
+    std::uint32_t middle = node(lower).__right;
+
+    if(parent != 0)
+    {
+        if(node(parent).__left == upper)
+            node(parent).__left = lower;
+        else
+            node(parent).__right = lower;
+    }
+    else
+    {
+        __root = lower;
+    }
+
+    set_parent(lower, parent);
+    node(lower).__right = upper;
+
+    set_parent(upper, lower);
+    node(upper).__left = middle;
+
+    if(middle != 0)
+        set_parent(middle, upper);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::compact_set<Tvalue, Tcompare>::insert_rebalance(std::uint32_t inserted)
+{
+    // Same as rbt_t::insert_rebalance, with indices for links.
+    std::uint32_t current = inserted;
+    while(color(parent(current)) == sg::color_t::red)
+    {
+        std::uint32_t upper = parent(current);
+        std::uint32_t grand = parent(upper);
+        if(upper == node(grand).__left)
+        {
+            std::uint32_t uncle = node(grand).__right;
+            if(color(uncle) == sg::color_t::red)
+            {
+                set_color(upper, sg::color_t::black);
+                set_color(uncle, sg::color_t::black);
+                set_color(grand, sg::color_t::red);
+                current = grand;
+            }
+            else
+            {
+                if(current == node(upper).__right)
+                {
+                    left_rotate(upper);
+                    std::swap(current, upper);
+                }
+                set_color(upper, sg::color_t::black);
+                set_color(grand, sg::color_t::red);
+                right_rotate(grand);
+            }
+        }
+        else // upper == node(grand).__right
+        {
+            std::uint32_t uncle = node(grand).__left;
+            if(color(uncle) == sg::color_t::red)
+            {
+                set_color(upper, sg::color_t::black);
+                set_color(uncle, sg::color_t::black);
+                set_color(grand, sg::color_t::red);
+                current = grand;
+            }
+            else
+            {
+                if(current == node(upper).__left)
+                {
+                    right_rotate(upper);
+                    std::swap(current, upper);
+                }
+                set_color(upper, sg::color_t::black);
+                set_color(grand, sg::color_t::red);
+                left_rotate(grand);
+            }
+        }
+    }
+    set_color(__root, sg::color_t::black);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::compact_set<Tvalue, Tcompare>::iterator::iterator(std::uint32_t node, const sg::compact_set<Tvalue, Tcompare>* set) :
+    __node(node), __set(set)
+{
+}
+
+template <typename Tvalue, typename Tcompare>
+inline const Tvalue&
+sg::compact_set<Tvalue, Tcompare>::iterator::operator->()
+{
+    return operator*();
+}
+
+template <typename Tvalue, typename Tcompare>
+inline const Tvalue&
+sg::compact_set<Tvalue, Tcompare>::iterator::operator*()
+{
+    if(__node == 0)
+        throw std::runtime_error{"sg::compact_set::iterator out of range"};
+    return __set->node(__node).__value;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::compact_set<Tvalue, Tcompare>::iterator
+sg::compact_set<Tvalue, Tcompare>::iterator::operator++()
+{
+    if(__node == 0)
+        throw std::runtime_error{"sg::compact_set::iterator out of range"};
+    __node = __set->successor(__node);
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::compact_set<Tvalue, Tcompare>::iterator
+sg::compact_set<Tvalue, Tcompare>::iterator::operator++(int)
+{
+    sg::compact_set<Tvalue, Tcompare>::iterator old = *this;
+    operator++();
+    return old;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::compact_set<Tvalue, Tcompare>::iterator
+sg::compact_set<Tvalue, Tcompare>::iterator::operator--()
+{
+    std::uint32_t node = __node == 0 ? __set->maximal(__set->__root) : __set->predecessor(__node);
+    if(node == 0)
+        throw std::runtime_error{"sg::compact_set::iterator out of range"};
+    __node = node;
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::compact_set<Tvalue, Tcompare>::iterator
+sg::compact_set<Tvalue, Tcompare>::iterator::operator--(int)
+{
+    sg::compact_set<Tvalue, Tcompare>::iterator old = *this;
+    operator--();
+    return old;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline bool
+sg::compact_set<Tvalue, Tcompare>::iterator::operator==(sg::compact_set<Tvalue, Tcompare>::iterator iter)
+{
+    return __node == iter.__node && __set == iter.__set;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline bool
+sg::compact_set<Tvalue, Tcompare>::iterator::operator!=(sg::compact_set<Tvalue, Tcompare>::iterator iter)
+{
+    return !operator==(iter);
+}
+
+#endif // __COMPACT_HPP__
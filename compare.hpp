@@ -0,0 +1,81 @@
+#ifndef __COMPARE_HPP__
+#define __COMPARE_HPP__
+
+#include <type_traits>
+#include <utility>
+
+namespace sg
+{
+    // A comparator is three-way if instead of answering whether a < b,
+    // it returns a negative number, zero or a positive number when a is
+    // less than, equal to or greater than b respectively; it's marked as such
+    // by the is_three_way member type. A tree with a three-way comparator
+    // can stop its descent as soon as an equal value is met.
+    template <typename Tcompare, typename = void>
+    struct is_three_way : std::false_type
+    {
+    };
+
+    template <typename Tcompare>
+    struct is_three_way<Tcompare, std::void_t<typename Tcompare::is_three_way>> : std::true_type
+    {
+    };
+
+    // A comparator is transparent if it can compare values of different
+    // types, which allows to search a tree without converting the key to
+    // the type of its values (e.g. std::string_view in a set of std::string).
+    template <typename Tcompare, typename = void>
+    struct is_transparent : std::false_type
+    {
+    };
+
+    template <typename Tcompare>
+    struct is_transparent<Tcompare, std::void_t<typename Tcompare::is_transparent>> : std::true_type
+    {
+    };
+
+    // Transparent three-way comparator. It uses the compare() member
+    // of the left operand when there's one (as std::string and
+    // std::string_view have), so that strings are walked only once per
+    // comparison; otherwise it falls back to operator<.
+    class compare_three_way_t
+    {
+    public:
+        using is_transparent = void;
+        using is_three_way = void;
+
+        template <typename Ta, typename Tb>
+        constexpr int operator()(const Ta& a, const Tb& b) const;
+
+    private:
+        template <typename Ta, typename Tb, typename = void>
+        struct has_compare : std::false_type
+        {
+        };
+
+        template <typename Ta, typename Tb>
+        struct has_compare<Ta, Tb, std::void_t<decltype(std::declval<const Ta&>().compare(std::declval<const Tb&>()))>> :
+            std::true_type
+        {
+        };
+    };
+
+} // namespace sg
+
+
+template <typename Ta, typename Tb>
+constexpr int
+sg::compare_three_way_t::operator()(const Ta& a, const Tb& b) const
+{
+    if constexpr(has_compare<Ta, Tb>::value)
+    {
+        auto result = a.compare(b);
+        return (result > 0) - (result < 0);
+    }
+    else
+    {
+        return (b < a) - (a < b);
+    }
+}
+
+#endif // __COMPARE_HPP__
@@ -0,0 +1,202 @@
+#ifndef __CONCURRENT_HPP__
+#define __CONCURRENT_HPP__
+
+#include "compare.hpp"
+#include "rbt.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace sg
+{
+    // Sorted set that many threads can use at once. The values are split
+    // by ranges into shards, each one a tree of its own guarded by its own
+    // reader/writer lock, so that operations on different shards never
+    // wait for each other and searches in the same shard run in parallel.
+    //
+    // The ranges are set once by the boundaries given to the constructor:
+    // with boundaries b1 < b2 < ... < bn, the first shard holds the values
+    // less than b1, the next one the values in [b1, b2), and so on, up to
+    // the last shard with the values not less than bn. Since every value
+    // has a single shard, a point operation locks one shard only; since
+    // the shards are ordered, iteration visits them one after another.
+    template <typename Tvalue, typename Tcompare = std::less<Tvalue>, template <typename> class Tallocator = sg::pool_t>
+    class concurrent_set
+    {
+    public:
+        explicit concurrent_set(std::vector<Tvalue> boundaries, const Tcompare& compare = Tcompare{});
+        concurrent_set(const sg::concurrent_set<Tvalue, Tcompare, Tallocator>& obj) = delete;
+        ~concurrent_set() = default;
+
+        sg::concurrent_set<Tvalue, Tcompare, Tallocator>& operator=(const sg::concurrent_set<Tvalue, Tcompare, Tallocator>& obj) = delete;
+
+        bool contains(const Tvalue& value);
+        bool insert(const Tvalue& value);
+        bool erase(const Tvalue& value);
+        template <typename Tfunction> void for_each(Tfunction function);
+        void clear();
+
+        unsigned int size();
+        unsigned int shard_count();
+
+    protected:
+        // Shards are aligned to cache lines, so that the lock of one shard
+        // doesn't share a line with the lock of another.
+        struct alignas(64) shard_t
+        {
+            std::shared_mutex mutex;
+            sg::rbt_t<Tvalue, Tcompare, Tallocator> tree;
+
+            explicit shard_t(const Tcompare& compare);
+        };
+
+        template <typename Ta, typename Tb> bool less(const Ta& a, const Tb& b) const;
+        shard_t& shard(const Tvalue& value);
+
+    private:
+        std::vector<Tvalue> __boundaries;
+        std::vector<std::unique_ptr<shard_t>> __shards;
+        Tcompare __compare;
+    };
+
+} // namespace sg
+
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline
+sg::concurrent_set<Tvalue, Tcompare, Tallocator>::shard_t::shard_t(const Tcompare& compare) :
+    tree{compare}
+{
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline
+sg::concurrent_set<Tvalue, Tcompare, Tallocator>::concurrent_set(std::vector<Tvalue> boundaries, const Tcompare& compare) :
+    __boundaries{std::move(boundaries)}, __compare{compare}
+{
+    for(std::size_t i = 1; i < __boundaries.size(); ++i)
+    {
+        if(!less(__boundaries[i - 1], __boundaries[i]))
+            throw std::invalid_argument{"sg::concurrent_set boundaries must be sorted and unique"};
+    }
+
+    for(std::size_t i = 0; i <= __boundaries.size(); ++i)
+    {
+        __shards.push_back(std::make_unique<shard_t>(__compare));
+    }
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline bool
+sg::concurrent_set<Tvalue, Tcompare, Tallocator>::contains(const Tvalue& value)
+{
+    shard_t& found = shard(value);
+    std::shared_lock<std::shared_mutex> lock{found.mutex};
+    return found.tree.search(value) != nullptr;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline bool
+sg::concurrent_set<Tvalue, Tcompare, Tallocator>::insert(const Tvalue& value)
+{
+    // Returns whether the value was added, i.e. it wasn't in the set.
+    shard_t& found = shard(value);
+    std::unique_lock<std::shared_mutex> lock{found.mutex};
+    return found.tree.insert(value).second;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline bool
+sg::concurrent_set<Tvalue, Tcompare, Tallocator>::erase(const Tvalue& value)
+{
+    // Returns whether the value was removed, i.e. it was in the set.
+    shard_t& found = shard(value);
+    std::unique_lock<std::shared_mutex> lock{found.mutex};
+    sg::node_t<Tvalue>* node = found.tree.search(value);
+    if(node == nullptr)
+        return false;
+
+    found.tree.remove(node);
+    return true;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+template <typename Tfunction>
+inline void
+sg::concurrent_set<Tvalue, Tcompare, Tallocator>::for_each(Tfunction function)
+{
+    // Calls the function for every value in order. Each shard is read
+    // under its own lock, one after another, so the values of a shard are
+    // a consistent view of it, but changes to a shard that's already been
+    // visited (or not yet visited) may go unseen (or be seen).
+    for(std::unique_ptr<shard_t>& current : __shards)
+    {
+        std::shared_lock<std::shared_mutex> lock{current->mutex};
+        for(sg::node_t<Tvalue>* node = current->tree.minimal(); node != nullptr; node = current->tree.successor(node))
+        {
+            function(node->value());
+        }
+    }
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline void
+sg::concurrent_set<Tvalue, Tcompare, Tallocator>::clear()
+{
+    for(std::unique_ptr<shard_t>& current : __shards)
+    {
+        std::unique_lock<std::shared_mutex> lock{current->mutex};
+        current->tree.clear();
+    }
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline unsigned int
+sg::concurrent_set<Tvalue, Tcompare, Tallocator>::size()
+{
+    // As with for_each, shards are counted one after another.
+    unsigned int total = 0;
+    for(std::unique_ptr<shard_t>& current : __shards)
+    {
+        std::shared_lock<std::shared_mutex> lock{current->mutex};
+        total += current->tree.size();
+    }
+    return total;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline unsigned int
+sg::concurrent_set<Tvalue, Tcompare, Tallocator>::shard_count()
+{
+    return __shards.size();
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+template <typename Ta, typename Tb>
+inline bool
+sg::concurrent_set<Tvalue, Tcompare, Tallocator>::less(const Ta& a, const Tb& b) const
+{
+    if constexpr(sg::is_three_way<Tcompare>::value)
+        return __compare(a, b) < 0;
+    else
+        return __compare(a, b);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline typename sg::concurrent_set<Tvalue, Tcompare, Tallocator>::shard_t&
+sg::concurrent_set<Tvalue, Tcompare, Tallocator>::shard(const Tvalue& value)
+{
+    // The boundaries never change, so they're searched without a lock;
+    // the shard of a value is the number of boundaries not greater than it.
+    auto found = std::upper_bound(__boundaries.begin(), __boundaries.end(), value,
+                                  [this](const Tvalue& a, const Tvalue& b) { return less(a, b); });
+    return *__shards[found - __boundaries.begin()];
+}
+
+#endif // __CONCURRENT_HPP__
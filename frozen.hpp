@@ -0,0 +1,419 @@
+#ifndef __FROZEN_HPP__
+#define __FROZEN_HPP__
+
+#include "compare.hpp"
+#include "rbt.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace sg
+{
+    // Header of a snapshot file of a frozen set, one cache line long;
+    // the Eytzinger array follows it byte for byte as it is in memory
+    // (index 0 included), so that the file can be searched in place once
+    // it's mapped (see sg::mapped_set). The magic number also tells apart
+    // files written on a machine with the other byte order.
+    struct snapshot_header_t
+    {
+        static constexpr std::uint64_t magic_number = 0x31504e5347534753; // "SGSGSNP1"
+        static constexpr std::uint32_t current_version = 1;
+
+        std::uint64_t __magic = magic_number;
+        std::uint32_t __version = current_version;
+        std::uint32_t __value_size = 0;
+        std::uint64_t __size = 0;
+        unsigned char __reserved[40] = {};
+    };
+    static_assert(sizeof(sg::snapshot_header_t) == 64, "sg::snapshot_header_t must take a cache line");
+
+    // Read-only sorted set for values that are built once and then only
+    // searched. The values are kept in a single array in the Eytzinger
+    // order: the root at index 1 and the children of the value at index k
+    // at 2k and 2k + 1, so a search needs neither pointers nor branches,
+    // and the top levels of the implicit tree share a few cache lines.
+    //
+    // Values must be default-constructible, index 0 of the array is unused.
+    template <typename Tvalue, typename Tcompare = std::less<Tvalue>>
+    class frozen_set
+    {
+    public:
+        frozen_set();
+        explicit frozen_set(const Tcompare& compare);
+        template <typename Titerator> frozen_set(Titerator first, Titerator last, const Tcompare& compare = Tcompare{});
+
+        class iterator
+        {
+        public:
+            iterator() = delete;
+
+            const Tvalue& operator->();
+            const Tvalue& operator*();
+            sg::frozen_set<Tvalue, Tcompare>::iterator operator++();
+            sg::frozen_set<Tvalue, Tcompare>::iterator operator++(int);
+            sg::frozen_set<Tvalue, Tcompare>::iterator operator--();
+            sg::frozen_set<Tvalue, Tcompare>::iterator operator--(int);
+            bool operator==(sg::frozen_set<Tvalue, Tcompare>::iterator iter);
+            bool operator!=(sg::frozen_set<Tvalue, Tcompare>::iterator iter);
+
+        private:
+            iterator(std::size_t index, const sg::frozen_set<Tvalue, Tcompare>* set);
+            std::size_t __index = 0; // Index in the Eytzinger array, 0 is the end
+            const sg::frozen_set<Tvalue, Tcompare>* __set = nullptr;
+            friend class sg::frozen_set<Tvalue, Tcompare>;
+        };
+
+        sg::frozen_set<Tvalue, Tcompare>::iterator search(const Tvalue& value) const;
+        template <typename Tkey, typename Tc = Tcompare, typename = typename Tc::is_transparent>
+        sg::frozen_set<Tvalue, Tcompare>::iterator search(const Tkey& key) const;
+        sg::frozen_set<Tvalue, Tcompare>::iterator lower_bound(const Tvalue& value) const;
+        template <typename Tkey, typename Tc = Tcompare, typename = typename Tc::is_transparent>
+        sg::frozen_set<Tvalue, Tcompare>::iterator lower_bound(const Tkey& key) const;
+        sg::frozen_set<Tvalue, Tcompare>::iterator begin() const;
+        sg::frozen_set<Tvalue, Tcompare>::iterator end() const;
+
+        unsigned int size() const;
+        void save(const std::string& path) const;
+
+    protected:
+        void view(const Tvalue* values, std::size_t size, std::shared_ptr<const void> owner);
+        const Tvalue* values() const;
+
+        template <typename Ta, typename Tb> bool less(const Ta& a, const Tb& b) const;
+        template <typename Tkey> std::size_t lower_index(const Tkey& key) const;
+        std::size_t first_index() const;
+        std::size_t last_index() const;
+        std::size_t next_index(std::size_t index) const;
+        std::size_t previous_index(std::size_t index) const;
+
+    private:
+        std::vector<Tvalue> __values; // Eytzinger array, the root at index 1; empty for a view
+        const Tvalue* __view = nullptr; // Eytzinger array kept elsewhere, e.g. in a mapped file
+        std::shared_ptr<const void> __owner; // Keeps the viewed array alive, shared by the copies
+        std::size_t __size = 0;
+        Tcompare __compare;
+    };
+
+} // namespace sg
+
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::frozen_set<Tvalue, Tcompare>::frozen_set() :
+    __values(1)
+{
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::frozen_set<Tvalue, Tcompare>::frozen_set(const Tcompare& compare) :
+    __values(1), __compare(compare)
+{
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Titerator>
+inline
+sg::frozen_set<Tvalue, Tcompare>::frozen_set(Titerator first, Titerator last, const Tcompare& compare) :
+    __compare(compare)
+{
+    // The range must be sorted by the comparator and have no duplicates,
+    // as the range of a set has. It's walked twice: once to count the
+    // values, and once more while the slots of the array are visited
+    // in order, which puts every value at its place.
+    for(Titerator iter = first; iter != last; ++iter)
+    {
+        ++__size;
+    }
+    __values.resize(__size + 1);
+    for(std::size_t index = first_index(); index != 0; index = next_index(index), ++first)
+    {
+        __values[index] = *first;
+    }
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::frozen_set<Tvalue, Tcompare>::iterator
+sg::frozen_set<Tvalue, Tcompare>::search(const Tvalue& value) const
+{
+    std::size_t index = lower_index(value);
+    if(index != 0 && less(value, values()[index]))
+        index = 0;
+    return sg::frozen_set<Tvalue, Tcompare>::iterator{index, this};
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Tkey, typename Tc, typename>
+inline typename sg::frozen_set<Tvalue, Tcompare>::iterator
+sg::frozen_set<Tvalue, Tcompare>::search(const Tkey& key) const
+{
+    std::size_t index = lower_index(key);
+    if(index != 0 && less(key, values()[index]))
+        index = 0;
+    return sg::frozen_set<Tvalue, Tcompare>::iterator{index, this};
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::frozen_set<Tvalue, Tcompare>::iterator
+sg::frozen_set<Tvalue, Tcompare>::lower_bound(const Tvalue& value) const
+{
+    return sg::frozen_set<Tvalue, Tcompare>::iterator{lower_index(value), this};
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Tkey, typename Tc, typename>
+inline typename sg::frozen_set<Tvalue, Tcompare>::iterator
+sg::frozen_set<Tvalue, Tcompare>::lower_bound(const Tkey& key) const
+{
+    return sg::frozen_set<Tvalue, Tcompare>::iterator{lower_index(key), this};
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::frozen_set<Tvalue, Tcompare>::iterator
+sg::frozen_set<Tvalue, Tcompare>::begin() const
+{
+    return sg::frozen_set<Tvalue, Tcompare>::iterator{first_index(), this};
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::frozen_set<Tvalue, Tcompare>::iterator
+sg::frozen_set<Tvalue, Tcompare>::end() const
+{
+    return sg::frozen_set<Tvalue, Tcompare>::iterator{0, this};
+}
+
+template <typename Tvalue, typename Tcompare>
+inline unsigned int
+sg::frozen_set<Tvalue, Tcompare>::size() const
+{
+    return __size;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::frozen_set<Tvalue, Tcompare>::save(const std::string& path) const
+{
+    // Writes the set as a snapshot file, which sg::mapped_set serves
+    // without reading it all in; the values are written as raw bytes, so
+    // they must be trivially copyable and hold no pointers.
+    static_assert(std::is_trivially_copyable<Tvalue>::value, "sg::frozen_set::save requires trivially copyable values");
+
+    sg::snapshot_header_t header;
+    header.__value_size = sizeof(Tvalue);
+    header.__size = __size;
+
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(values()), (__size + 1) * sizeof(Tvalue));
+    file.close();
+    if(!file)
+        throw std::runtime_error{"sg::frozen_set can't write the snapshot file"};
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::frozen_set<Tvalue, Tcompare>::view(const Tvalue* values, std::size_t size, std::shared_ptr<const void> owner)
+{
+    // Makes the set search an Eytzinger array it doesn't own (index 0
+    // included); the owner keeps the array alive as long as the set or
+    // any of its copies, sliced ones included, still views it.
+    __values.clear();
+    __values.shrink_to_fit();
+    __view = values;
+    __owner = std::move(owner);
+    __size = size;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline const Tvalue*
+sg::frozen_set<Tvalue, Tcompare>::values() const
+{
+    return __values.empty() ? __view : __values.data();
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Ta, typename Tb>
+inline bool
+sg::frozen_set<Tvalue, Tcompare>::less(const Ta& a, const Tb& b) const
+{
+    if constexpr(sg::is_three_way<Tcompare>::value)
+        return __compare(a, b) < 0;
+    else
+        return __compare(a, b);
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Tkey>
+inline std::size_t
+sg::frozen_set<Tvalue, Tcompare>::lower_index(const Tkey& key) const
+{
+    // Every step goes to the left child when the value isn't less than
+    // the key, and to the right one otherwise; the step is computed from
+    // the result of the comparison, so for plain values like integers
+    // there's no branch to mispredict. Descendants four levels down share
+    // a cache line when values are small, and are prefetched in advance.
+    constexpr std::size_t prefetch_distance = std::max<std::size_t>(1, 64 / sizeof(Tvalue));
+
+    const Tvalue* values = this->values();
+    std::size_t index = 1;
+    while(index <= __size)
+    {
+        sg::prefetch(values + std::min(index * prefetch_distance, __size));
+        index = 2 * index + less(values[index], key);
+    }
+
+    // The path ends with a run of right steps after the last left one,
+    // whose node is the first value not less than the key; dropping the run
+    // and that step gives its index (0 if all values are less than the key).
+    while(index & 1)
+        index >>= 1;
+    return index >> 1;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::size_t
+sg::frozen_set<Tvalue, Tcompare>::first_index() const
+{
+    if(__size == 0)
+        return 0;
+
+    std::size_t index = 1;
+    while(2 * index <= __size)
+        index *= 2;
+    return index;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::size_t
+sg::frozen_set<Tvalue, Tcompare>::last_index() const
+{
+    if(__size == 0)
+        return 0;
+
+    std::size_t index = 1;
+    while(2 * index + 1 <= __size)
+        index = 2 * index + 1;
+    return index;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::size_t
+sg::frozen_set<Tvalue, Tcompare>::next_index(std::size_t index) const
+{
+    // Same as the successor in a tree with links: the leftmost value of
+    // the right subtree, or the closest ancestor this value is left of.
+    if(2 * index + 1 <= __size)
+    {
+        index = 2 * index + 1;
+        while(2 * index <= __size)
+            index *= 2;
+        return index;
+    }
+
+    while(index & 1)
+        index >>= 1;
+    return index >> 1;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::size_t
+sg::frozen_set<Tvalue, Tcompare>::previous_index(std::size_t index) const
+{
+    if(2 * index <= __size)
+    {
+        index = 2 * index;
+        while(2 * index + 1 <= __size)
+            index = 2 * index + 1;
+        return index;
+    }
+
+    while(index > 1 && !(index & 1))
+        index >>= 1;
+    return index >> 1;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::frozen_set<Tvalue, Tcompare>::iterator::iterator(std::size_t index, const sg::frozen_set<Tvalue, Tcompare>* set) :
+    __index(index), __set(set)
+{
+}
+
+template <typename Tvalue, typename Tcompare>
+inline const Tvalue&
+sg::frozen_set<Tvalue, Tcompare>::iterator::operator->()
+{
+    return operator*();
+}
+
+template <typename Tvalue, typename Tcompare>
+inline const Tvalue&
+sg::frozen_set<Tvalue, Tcompare>::iterator::operator*()
+{
+    if(__index == 0)
+        throw std::runtime_error{"sg::frozen_set::iterator out of range"};
+    return __set->values()[__index];
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::frozen_set<Tvalue, Tcompare>::iterator
+sg::frozen_set<Tvalue, Tcompare>::iterator::operator++()
+{
+    if(__index == 0)
+        throw std::runtime_error{"sg::frozen_set::iterator out of range"};
+    __index = __set->next_index(__index);
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::frozen_set<Tvalue, Tcompare>::iterator
+sg::frozen_set<Tvalue, Tcompare>::iterator::operator++(int)
+{
+    sg::frozen_set<Tvalue, Tcompare>::iterator old = *this;
+    operator++();
+    return old;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::frozen_set<Tvalue, Tcompare>::iterator
+sg::frozen_set<Tvalue, Tcompare>::iterator::operator--()
+{
+    std::size_t index = __index == 0 ? __set->last_index() : __set->previous_index(__index);
+    if(index == 0)
+        throw std::runtime_error{"sg::frozen_set::iterator out of range"};
+    __index = index;
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::frozen_set<Tvalue, Tcompare>::iterator
+sg::frozen_set<Tvalue, Tcompare>::iterator::operator--(int)
+{
+    sg::frozen_set<Tvalue, Tcompare>::iterator old = *this;
+    operator--();
+    return old;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline bool
+sg::frozen_set<Tvalue, Tcompare>::iterator::operator==(sg::frozen_set<Tvalue, Tcompare>::iterator iter)
+{
+    return __index == iter.__index && __set == iter.__set;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline bool
+sg::frozen_set<Tvalue, Tcompare>::iterator::operator!=(sg::frozen_set<Tvalue, Tcompare>::iterator iter)
+{
+    return !operator==(iter);
+}
+
+#endif // __FROZEN_HPP__
@@ -0,0 +1,757 @@
+#ifndef __LEAN_HPP__
+#define __LEAN_HPP__
+
+#include "compare.hpp"
+#include "pool.hpp"
+#include "rbt.hpp"
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace sg
+{
+    // Node of a lean tree: no link to the parent at all, and the color
+    // takes the lowest bit of the link to the left child, so that a node
+    // of int takes 24 bytes instead of 32.
+    template <typename Tvalue>
+    struct lean_node_t
+    {
+        Tvalue __value;
+        std::uintptr_t __left_color = static_cast<std::uintptr_t>(sg::color_t::red);
+        sg::lean_node_t<Tvalue>* __right = nullptr;
+    };
+
+    // Red-black tree set without parent links, for sets that are mostly
+    // searched and scanned: the same search, insert and iterator semantics
+    // as sg::set, with smaller nodes and rotations that write one link less.
+    // What the parent links are otherwise needed for, the path from the root
+    // does instead: an insertion keeps the path it descends along on
+    // a stack and rebalances up that stack, and an iterator carries
+    // the turns of the path to its node and the last few nodes of it.
+    //
+    // Unlike with sg::set, an insertion invalidates the iterators, since
+    // the rotations may change the paths they carry.
+    template <typename Tvalue, typename Tcompare = std::less<Tvalue>, template <typename> class Tallocator = sg::pool_t>
+    class lean_set
+    {
+    protected:
+        using node_t = sg::lean_node_t<Tvalue>;
+
+        // The height of a red-black tree of n nodes is at most
+        // 2 * log2(n + 1), and the size of a set fits unsigned int.
+        static constexpr unsigned int max_height = 2 * sizeof(unsigned int) * CHAR_BIT;
+        // How many of the nodes at the end of its path an iterator keeps;
+        // a step in order goes further up than that once in 2^window_size
+        // steps on average.
+        static constexpr unsigned int window_size = 8;
+        static_assert(max_height <= 64 + 1, "sg::lean_set keeps the turns of a path in 64 bits");
+
+    public:
+        lean_set() = default;
+        explicit lean_set(const Tcompare& compare);
+        template <typename Titerator> lean_set(Titerator first, Titerator last);
+        lean_set(const sg::lean_set<Tvalue, Tcompare, Tallocator>& obj);
+        lean_set(sg::lean_set<Tvalue, Tcompare, Tallocator>&& obj);
+        ~lean_set();
+
+        sg::lean_set<Tvalue, Tcompare, Tallocator>& operator=(const sg::lean_set<Tvalue, Tcompare, Tallocator>& obj);
+        sg::lean_set<Tvalue, Tcompare, Tallocator>& operator=(sg::lean_set<Tvalue, Tcompare, Tallocator>&& obj);
+
+        class iterator
+        {
+        public:
+            iterator() = delete;
+
+            const Tvalue& operator->();
+            const Tvalue& operator*();
+            sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator& operator++();
+            sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator operator++(int);
+            sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator& operator--();
+            sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator operator--(int);
+            bool operator==(const sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator& iter) const;
+            bool operator!=(const sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator& iter) const;
+
+        private:
+            explicit iterator(const sg::lean_set<Tvalue, Tcompare, Tallocator>* set);
+            node_t* node() const;
+            void push(node_t* node, bool to_right);
+            void descend(node_t* node, bool to_left);
+            void follow(node_t** path, unsigned int depth);
+            void climb(unsigned int depth);
+
+            // The path from the root down to the node of the iterator, of
+            // __depth nodes, none for the end: bit i of __turns is set if
+            // it goes right below level i, and the last __valid nodes of it
+            // are kept in __window at their levels modulo window_size.
+            // The nodes above those are found again from the root.
+            node_t* __window[window_size] = {};
+            std::uint64_t __turns = 0;
+            unsigned int __depth = 0;
+            unsigned int __valid = 0;
+            const sg::lean_set<Tvalue, Tcompare, Tallocator>* __set = nullptr;
+            friend class sg::lean_set<Tvalue, Tcompare, Tallocator>;
+        };
+
+        sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator search(const Tvalue& value);
+        template <typename Tkey, typename Tc = Tcompare, typename = typename Tc::is_transparent>
+        sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator search(const Tkey& key);
+        std::pair<sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator, bool> insert(const Tvalue& value);
+        sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator begin();
+        sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator end();
+        void clear();
+
+        unsigned int size();
+        std::size_t memory_usage();
+
+    protected:
+        static node_t* left(node_t* node);
+        static void set_left(node_t* node, node_t* left);
+        static sg::color_t color(node_t* node);
+        static void set_color(node_t* node, sg::color_t color);
+
+        template <typename Ta, typename Tb> bool less(const Ta& a, const Tb& b) const;
+        template <typename Tkey> unsigned int lookup(const Tkey& key, node_t** path, unsigned int& length) const;
+        void replace_child(node_t* parent, node_t* child, node_t* replacement);
+        void left_rotate(node_t* upper, node_t* parent);
+        void right_rotate(node_t* upper, node_t* parent);
+        unsigned int insert_rebalance(node_t** path, unsigned int depth);
+
+        Tallocator<node_t>& allocator();
+        node_t* clone_subtree(node_t* source);
+        void destroy_subtree(node_t* node);
+        void release();
+
+    private:
+        node_t* __root = nullptr;
+        unsigned int __size = 0;
+        Tcompare __compare;
+        // Created on the first allocation.
+        std::unique_ptr<Tallocator<node_t>> __allocator;
+    };
+
+} // namespace sg
+
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline
+sg::lean_set<Tvalue, Tcompare, Tallocator>::lean_set(const Tcompare& compare) :
+    __compare{compare}
+{
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+template <typename Titerator>
+inline
+sg::lean_set<Tvalue, Tcompare, Tallocator>::lean_set(Titerator first, Titerator last)
+{
+    for(; first != last; ++first)
+    {
+        insert(*first);
+    }
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline
+sg::lean_set<Tvalue, Tcompare, Tallocator>::lean_set(const sg::lean_set<Tvalue, Tcompare, Tallocator>& obj) :
+    __compare{obj.__compare}
+{
+    // The copy repeats the shape and the colors of the original tree.
+    __root = clone_subtree(obj.__root);
+    __size = obj.__size;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline
+sg::lean_set<Tvalue, Tcompare, Tallocator>::lean_set(sg::lean_set<Tvalue, Tcompare, Tallocator>&& obj) :
+    __root{obj.__root}, __size{obj.__size}, __compare{obj.__compare}, __allocator{std::move(obj.__allocator)}
+{
+    obj.__root = nullptr;
+    obj.__size = 0;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline
+sg::lean_set<Tvalue, Tcompare, Tallocator>::~lean_set()
+{
+    release();
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline sg::lean_set<Tvalue, Tcompare, Tallocator>&
+sg::lean_set<Tvalue, Tcompare, Tallocator>::operator=(const sg::lean_set<Tvalue, Tcompare, Tallocator>& obj)
+{
+    if(this != &obj)
+    {
+        // Build the copy aside first, so that the set stays intact
+        // if copying of some value throws.
+        sg::lean_set<Tvalue, Tcompare, Tallocator> copy{obj};
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline sg::lean_set<Tvalue, Tcompare, Tallocator>&
+sg::lean_set<Tvalue, Tcompare, Tallocator>::operator=(sg::lean_set<Tvalue, Tcompare, Tallocator>&& obj)
+{
+    if(this != &obj)
+    {
+        release();
+        __root = obj.__root;
+        __size = obj.__size;
+        __compare = obj.__compare;
+        __allocator = std::move(obj.__allocator);
+        obj.__root = nullptr;
+        obj.__size = 0;
+    }
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline const Tvalue&
+sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator::operator->()
+{
+    if(__depth == 0)
+        throw std::runtime_error{"sg::lean_set::iterator out of range"};
+    return node()->__value;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline const Tvalue&
+sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator::operator*()
+{
+    if(__depth == 0)
+        throw std::runtime_error{"sg::lean_set::iterator out of range"};
+    return node()->__value;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline typename sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator&
+sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator::operator++()
+{
+    // The successor is the leftmost node of the right subtree if there's
+    // one; otherwise it's the nearest ancestor the node is to the left of,
+    // the last node at which the path turns left.
+    if(__depth == 0)
+        throw std::runtime_error{"sg::lean_set::iterator out of range"};
+    node_t* current = node();
+    if(current->__right != nullptr)
+    {
+        descend(current->__right, true);
+        return *this;
+    }
+    unsigned int depth = __depth - 1;
+    while(depth != 0 && (__turns >> (depth - 1) & 1) != 0)
+        --depth;
+    climb(depth);
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline typename sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator
+sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator::operator++(int)
+{
+    sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator old = *this;
+    operator++();
+    return old;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline typename sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator&
+sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator::operator--()
+{
+    // Mirror of the above; decrementing the end iterator gives
+    // the maximal element.
+    if(__depth == 0)
+    {
+        if(__set->__root != nullptr)
+            descend(__set->__root, false);
+        return *this;
+    }
+    node_t* current = node();
+    if(lean_set::left(current) != nullptr)
+    {
+        descend(lean_set::left(current), false);
+        return *this;
+    }
+    unsigned int depth = __depth - 1;
+    while(depth != 0 && (__turns >> (depth - 1) & 1) == 0)
+        --depth;
+    climb(depth);
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline typename sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator
+sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator::operator--(int)
+{
+    sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator old = *this;
+    operator--();
+    return old;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline bool
+sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator::operator==(const sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator& iter) const
+{
+    return node() == iter.node();
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline bool
+sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator::operator!=(const sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator& iter) const
+{
+    return node() != iter.node();
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline
+sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator::iterator(const sg::lean_set<Tvalue, Tcompare, Tallocator>* set) :
+    __set{set}
+{
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline typename sg::lean_set<Tvalue, Tcompare, Tallocator>::node_t*
+sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator::node() const
+{
+    return __depth == 0 ? nullptr : __window[(__depth - 1) % window_size];
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline void
+sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator::push(node_t* node, bool to_right)
+{
+    // Extends the path with a child of its last node, or with the root.
+    if(__depth != 0)
+    {
+        unsigned int level = __depth - 1;
+        __turns = (__turns & ~(std::uint64_t{1} << level)) | (std::uint64_t{to_right} << level);
+    }
+    __window[__depth % window_size] = node;
+    ++__depth;
+    __valid += __valid < window_size;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline void
+sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator::descend(node_t* node, bool to_left)
+{
+    // Extends the path with the node and then with its leftmost
+    // (or rightmost) descendants; the node itself is the right (or left)
+    // child of the last node of the path, or the root.
+    for(bool to_right = to_left; node != nullptr; node = to_left ? lean_set::left(node) : node->__right, to_right = !to_left)
+    {
+        push(node, to_right);
+    }
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline void
+sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator::follow(node_t** path, unsigned int depth)
+{
+    // Takes the path of a descent from the root; only its last nodes
+    // are kept, and the turns are read off the links between the nodes.
+    std::uint64_t turns = 0;
+    for(unsigned int level = 1; level < depth; ++level)
+    {
+        turns |= std::uint64_t{path[level] == path[level - 1]->__right} << (level - 1);
+    }
+    __valid = depth < window_size ? depth : window_size;
+    for(unsigned int level = depth - __valid; level < depth; ++level)
+    {
+        __window[level % window_size] = path[level];
+    }
+    __turns = turns;
+    __depth = depth;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline void
+sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator::climb(unsigned int depth)
+{
+    // Cuts the path back to the given number of nodes. If the new last node
+    // is no longer in the window, the path is walked again from the root
+    // along the turns, which happens rarely in a scan.
+    if(depth == 0 || __depth - depth < __valid)
+    {
+        __valid = depth == 0 ? 0 : __valid - (__depth - depth);
+        __depth = depth;
+        return;
+    }
+    node_t* node = __set->__root;
+    for(unsigned int level = 0; ; ++level)
+    {
+        __window[level % window_size] = node;
+        if(level + 1 == depth)
+            break;
+        node = (__turns >> level & 1) != 0 ? node->__right : lean_set::left(node);
+    }
+    __depth = depth;
+    __valid = depth < window_size ? depth : window_size;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline typename sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator
+sg::lean_set<Tvalue, Tcompare, Tallocator>::search(const Tvalue& value)
+{
+    sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator iter{this};
+    node_t* path[max_height];
+    unsigned int length;
+    iter.follow(path, lookup(value, path, length));
+    return iter;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+template <typename Tkey, typename Tc, typename>
+inline typename sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator
+sg::lean_set<Tvalue, Tcompare, Tallocator>::search(const Tkey& key)
+{
+    sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator iter{this};
+    node_t* path[max_height];
+    unsigned int length;
+    iter.follow(path, lookup(key, path, length));
+    return iter;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline std::pair<typename sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator, bool>
+sg::lean_set<Tvalue, Tcompare, Tallocator>::insert(const Tvalue& value)
+{
+    // Returns the iterator to the value and whether it's just been
+    // inserted, the same as sg::set does. The iterator takes the path
+    // of the descent once the tree is rebalanced.
+    sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator iter{this};
+    node_t* path[max_height];
+    unsigned int depth;
+    unsigned int found = lookup(value, path, depth);
+    if(found != 0)
+    {
+        iter.follow(path, found);
+        return {iter, false};
+    }
+
+    if(__size == UINT_MAX)
+        throw std::length_error{"sg::lean_set is full"};
+
+    // The descent went on down to a NIL, so the path ends with
+    // the parent of the new node.
+    node_t* inserted = allocator().allocate();
+    try
+    {
+        new (inserted) node_t{value};
+    }
+    catch(...)
+    {
+        __allocator->deallocate(inserted);
+        throw;
+    }
+
+    if(depth == 0)
+        __root = inserted;
+    else if(less(value, path[depth - 1]->__value))
+        set_left(path[depth - 1], inserted);
+    else
+        path[depth - 1]->__right = inserted;
+    path[depth++] = inserted;
+    ++__size;
+
+    // A rotation breaks the path below the top of the rotated subtree;
+    // it's restored by descending from there, which takes a couple of
+    // steps on average, as rotations happen near the bottom.
+    unsigned int kept = insert_rebalance(path, depth);
+    for(depth = kept; path[depth - 1] != inserted; ++depth)
+    {
+        node_t* current = path[depth - 1];
+        path[depth] = less(value, current->__value) ? left(current) : current->__right;
+    }
+    iter.follow(path, depth);
+    return {iter, true};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline typename sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator
+sg::lean_set<Tvalue, Tcompare, Tallocator>::begin()
+{
+    sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator iter{this};
+    iter.descend(__root, true);
+    return iter;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline typename sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator
+sg::lean_set<Tvalue, Tcompare, Tallocator>::end()
+{
+    return sg::lean_set<Tvalue, Tcompare, Tallocator>::iterator{this};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline void
+sg::lean_set<Tvalue, Tcompare, Tallocator>::clear()
+{
+    release();
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline unsigned int
+sg::lean_set<Tvalue, Tcompare, Tallocator>::size()
+{
+    return __size;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline std::size_t
+sg::lean_set<Tvalue, Tcompare, Tallocator>::memory_usage()
+{
+    return sizeof(*this) + (__allocator ? __allocator->memory_usage() : 0);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline typename sg::lean_set<Tvalue, Tcompare, Tallocator>::node_t*
+sg::lean_set<Tvalue, Tcompare, Tallocator>::left(node_t* node)
+{
+    return reinterpret_cast<node_t*>(node->__left_color & ~std::uintptr_t{1});
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline void
+sg::lean_set<Tvalue, Tcompare, Tallocator>::set_left(node_t* node, node_t* left)
+{
+    node->__left_color = reinterpret_cast<std::uintptr_t>(left) | (node->__left_color & 1);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline sg::color_t
+sg::lean_set<Tvalue, Tcompare, Tallocator>::color(node_t* node)
+{
+    // NILs are black.
+    if(node == nullptr)
+        return sg::color_t::black;
+    return static_cast<sg::color_t>(node->__left_color & 1);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline void
+sg::lean_set<Tvalue, Tcompare, Tallocator>::set_color(node_t* node, sg::color_t color)
+{
+    node->__left_color = (node->__left_color & ~std::uintptr_t{1}) | static_cast<std::uintptr_t>(color);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+template <typename Ta, typename Tb>
+inline bool
+sg::lean_set<Tvalue, Tcompare, Tallocator>::less(const Ta& a, const Tb& b) const
+{
+    if constexpr(sg::is_three_way<Tcompare>::value)
+        return __compare(a, b) < 0;
+    else
+        return __compare(a, b);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+template <typename Tkey>
+inline unsigned int
+sg::lean_set<Tvalue, Tcompare, Tallocator>::lookup(const Tkey& key, node_t** path, unsigned int& length) const
+{
+    // One comparison per level, as in rbt_t: the last node whose value
+    // isn't greater than the key is the only candidate for equality.
+    // The nodes passed are written to the path, and their number
+    // to the length; returns the length of the path to the node found,
+    // zero if there's none.
+    unsigned int depth = 0;
+    unsigned int candidate = 0;
+    for(node_t* current = __root; current != nullptr; ++depth)
+    {
+        path[depth] = current;
+        if(less(key, current->__value))
+        {
+            current = left(current);
+        }
+        else
+        {
+            candidate = depth + 1;
+            current = current->__right;
+        }
+    }
+
+    length = depth;
+    if(candidate != 0 && less(path[candidate - 1]->__value, key))
+        candidate = 0;
+    return candidate;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline void
+sg::lean_set<Tvalue, Tcompare, Tallocator>::replace_child(node_t* parent, node_t* child, node_t* replacement)
+{
+    // The parent has to be given, as the child has no link to it;
+    // nullptr stands for the root.
+    if(parent == nullptr)
+        __root = replacement;
+    else if(left(parent) == child)
+        set_left(parent, replacement);
+    else
+        parent->__right = replacement;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline void
+sg::lean_set<Tvalue, Tcompare, Tallocator>::left_rotate(node_t* upper, node_t* parent)
+{
+    // Same as rbt_t::left_rotate, less the links to the parents.
+    node_t* lower = upper->__right;
+    replace_child(parent, upper, lower);
+    upper->__right = left(lower);
+    set_left(lower, upper);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline void
+sg::lean_set<Tvalue, Tcompare, Tallocator>::right_rotate(node_t* upper, node_t* parent)
+{
+    node_t* lower = left(upper);
+    replace_child(parent, upper, lower);
+    set_left(upper, lower->__right);
+    lower->__right = upper;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline unsigned int
+sg::lean_set<Tvalue, Tcompare, Tallocator>::insert_rebalance(node_t** path, unsigned int depth)
+{
+    // Same as rbt_t::insert_rebalance, with the parent and the grandparent
+    // of a node taken from the path. Returns how many nodes at the start
+    // of the path are still right: all of them, unless there were
+    // rotations, which put a new node at the place of the grandparent.
+    unsigned int index = depth - 1;
+    unsigned int kept = depth;
+    while(index != 0 && color(path[index - 1]) == sg::color_t::red)
+    {
+        // A red parent isn't the root, so there's a grandparent.
+        node_t* node = path[index];
+        node_t* parent = path[index - 1];
+        node_t* grand = path[index - 2];
+        node_t* above = index > 2 ? path[index - 3] : nullptr;
+        if(parent == left(grand))
+        {
+            node_t* uncle = grand->__right;
+            if(color(uncle) == sg::color_t::red)
+            {
+                set_color(parent, sg::color_t::black);
+                set_color(uncle, sg::color_t::black);
+                set_color(grand, sg::color_t::red);
+                index -= 2;
+                continue;
+            }
+            if(node == parent->__right)
+            {
+                left_rotate(parent, grand);
+                parent = node;
+            }
+            set_color(parent, sg::color_t::black);
+            set_color(grand, sg::color_t::red);
+            right_rotate(grand, above);
+        }
+        else // parent == grand->__right
+        {
+            node_t* uncle = left(grand);
+            if(color(uncle) == sg::color_t::red)
+            {
+                set_color(parent, sg::color_t::black);
+                set_color(uncle, sg::color_t::black);
+                set_color(grand, sg::color_t::red);
+                index -= 2;
+                continue;
+            }
+            if(node == left(parent))
+            {
+                right_rotate(parent, grand);
+                parent = node;
+            }
+            set_color(parent, sg::color_t::black);
+            set_color(grand, sg::color_t::red);
+            left_rotate(grand, above);
+        }
+        path[index - 2] = parent;
+        kept = index - 1;
+        break;
+    }
+    set_color(__root, sg::color_t::black);
+    return kept;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline Tallocator<typename sg::lean_set<Tvalue, Tcompare, Tallocator>::node_t>&
+sg::lean_set<Tvalue, Tcompare, Tallocator>::allocator()
+{
+    if(!__allocator)
+        __allocator = std::make_unique<Tallocator<node_t>>();
+    return *__allocator;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline typename sg::lean_set<Tvalue, Tcompare, Tallocator>::node_t*
+sg::lean_set<Tvalue, Tcompare, Tallocator>::clone_subtree(node_t* source)
+{
+    // The height of a red-black tree is logarithmic in the number of its
+    // nodes, so the recursion depth stays small even for huge trees.
+    if(source == nullptr)
+        return nullptr;
+
+    node_t* node = allocator().allocate();
+    try
+    {
+        new (node) node_t{source->__value};
+    }
+    catch(...)
+    {
+        __allocator->deallocate(node);
+        throw;
+    }
+    set_color(node, color(source));
+    try
+    {
+        set_left(node, clone_subtree(left(source)));
+        node->__right = clone_subtree(source->__right);
+    }
+    catch(...)
+    {
+        destroy_subtree(node);
+        throw;
+    }
+    return node;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline void
+sg::lean_set<Tvalue, Tcompare, Tallocator>::destroy_subtree(node_t* node)
+{
+    if(node == nullptr)
+        return;
+    destroy_subtree(left(node));
+    destroy_subtree(node->__right);
+    node->~node_t();
+    __allocator->deallocate(node);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator>
+inline void
+sg::lean_set<Tvalue, Tcompare, Tallocator>::release()
+{
+    // A pool that gives back its whole storage at once needn't be visited
+    // node by node, unless the values have something to clean up.
+    if(!Tallocator<node_t>::bulk_release || !std::is_trivially_destructible<Tvalue>::value)
+        destroy_subtree(__root);
+    __allocator = nullptr;
+    __root = nullptr;
+    __size = 0;
+}
+
+#endif // __LEAN_HPP__
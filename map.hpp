@@ -0,0 +1,613 @@
+#ifndef __MAP_HPP__
+#define __MAP_HPP__
+
+#include "rbt.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace sg
+{
+    template <typename Tkey, typename Tmapped, typename Tcompare = std::less<Tkey>, template <typename> class Tallocator = sg::pool_t,
+              bool Vsplit = false> class map;
+
+    // Value of the tree of a map: a key and the value mapped to it. The key
+    // orders the tree and never changes, while the mapped value can be
+    // changed in place, hence mutable.
+    //
+    // With the split layout the mapped value is kept out of line, in a pool
+    // of its own, and the entry only points to it; the nodes of the tree
+    // then hold just the keys, and a search doesn't pull the mapped values
+    // it passes by into cache. Big mapped values are worth that extra
+    // pointer per entry, and the extra cache miss when one is read.
+    template <typename Tkey, typename Tmapped, bool Vsplit>
+    class map_entry_t
+    {
+    public:
+        // The entry being built from the key and the arguments of its mapped
+        // value, it mustn't be taken for a copy of another entry.
+        template <typename Tk, typename... Targs,
+                  typename = std::enable_if_t<!std::is_same<std::decay_t<Tk>, sg::map_entry_t<Tkey, Tmapped, Vsplit>>::value>>
+        explicit map_entry_t(Tk&& key, Targs&&... args);
+
+        const Tkey& key() const;
+        Tmapped& mapped() const;
+
+    private:
+        Tkey __key;
+        mutable Tmapped __mapped;
+    };
+
+    template <typename Tkey, typename Tmapped>
+    class map_entry_t<Tkey, Tmapped, true>
+    {
+    public:
+        template <typename Tk, template <typename> class Tallocator, typename... Targs>
+        explicit map_entry_t(Tk&& key, Tallocator<Tmapped>& values, Targs&&... args);
+
+        const Tkey& key() const;
+        Tmapped& mapped() const;
+
+    private:
+        Tkey __key;
+        // Owned by the map, which destroys the mapped values before their
+        // entries, as the entries may be copied and moved by the tree.
+        mutable Tmapped* __mapped = nullptr;
+
+        template <typename, typename, typename, template <typename> class, bool> friend class sg::map;
+    };
+
+    // Transparent three-way comparators stay three-way when wrapped.
+    template <bool Vthree_way>
+    struct map_order_t
+    {
+    };
+
+    template <>
+    struct map_order_t<true>
+    {
+        using is_three_way = void;
+    };
+
+    // Orders the entries of a map by their keys with the comparator
+    // of the keys; it's transparent, so that the tree can be searched
+    // by a key alone.
+    template <typename Tkey, typename Tmapped, bool Vsplit, typename Tcompare>
+    class map_compare_t : public sg::map_order_t<sg::is_three_way<Tcompare>::value>
+    {
+    public:
+        using is_transparent = void;
+        using result_t = decltype(std::declval<const Tcompare&>()(std::declval<const Tkey&>(), std::declval<const Tkey&>()));
+
+        map_compare_t() = default;
+        explicit map_compare_t(const Tcompare& compare);
+
+        result_t operator()(const sg::map_entry_t<Tkey, Tmapped, Vsplit>& a, const sg::map_entry_t<Tkey, Tmapped, Vsplit>& b) const;
+        result_t operator()(const Tkey& a, const sg::map_entry_t<Tkey, Tmapped, Vsplit>& b) const;
+        result_t operator()(const sg::map_entry_t<Tkey, Tmapped, Vsplit>& a, const Tkey& b) const;
+
+    private:
+        Tcompare __compare;
+    };
+
+    // Sorted map of unique keys, built on the red-black tree. The layout
+    // is either inline, with the mapped values in the nodes next to their
+    // keys, or split (Vsplit), with the mapped values in a separate pool.
+    template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+    class map
+    {
+    public:
+        using entry_type = sg::map_entry_t<Tkey, Tmapped, Vsplit>;
+        using tree_type = sg::rbt_t<entry_type, sg::map_compare_t<Tkey, Tmapped, Vsplit, Tcompare>, Tallocator>;
+        using node_type = sg::node_t<entry_type, false, false>;
+
+        map() = default;
+        explicit map(const Tcompare& compare);
+        map(const sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>& obj);
+        map(sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>&& obj) = default;
+        ~map();
+
+        sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>& operator=(const sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>& obj);
+        sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>& operator=(sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>&& obj);
+
+        class iterator
+        {
+        public:
+            // Dereferencing gives references to the key and to the mapped
+            // value, which may not lie side by side.
+            using reference = std::pair<const Tkey&, Tmapped&>;
+
+            class pointer
+            {
+            public:
+                reference* operator->();
+
+            private:
+                pointer(reference pair);
+                reference __pair;
+                friend class sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator;
+            };
+
+            iterator() = delete;
+
+            reference operator*();
+            pointer operator->();
+            sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator operator++();
+            sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator operator++(int);
+            bool operator==(sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator iter);
+            bool operator!=(sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator iter);
+
+        private:
+            iterator(node_type* node, tree_type* tree);
+            node_type* __node = nullptr;
+            tree_type* __tree = nullptr;
+            friend class sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>;
+        };
+
+        sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator find(const Tkey& key);
+        Tmapped& operator[](const Tkey& key);
+        Tmapped& operator[](Tkey&& key);
+        template <typename... Targs> std::pair<sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator, bool> try_emplace(const Tkey& key, Targs&&... args);
+        template <typename... Targs> std::pair<sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator, bool> try_emplace(Tkey&& key, Targs&&... args);
+        template <typename Tm> std::pair<sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator, bool> insert_or_assign(const Tkey& key, Tm&& mapped);
+        template <typename Tm> std::pair<sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator, bool> insert_or_assign(Tkey&& key, Tm&& mapped);
+        sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator erase(sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator position);
+        unsigned int erase(const Tkey& key);
+        sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator begin();
+        sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator end();
+
+        void clear();
+        unsigned int size();
+        std::size_t memory_usage();
+
+    private:
+        template <typename Tk, typename... Targs> std::pair<sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator, bool> emplace_key(Tk&& key, Targs&&... args);
+        template <typename Tk, typename Tm> std::pair<sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator, bool> assign_key(Tk&& key, Tm&& mapped);
+        Tallocator<Tmapped>& values();
+        void destroy_value(const entry_type& entry);
+        void destroy_values();
+
+        tree_type __tree;
+        // The pool of the mapped values of the split layout; created
+        // on the first insertion.
+        std::unique_ptr<Tallocator<Tmapped>> __values;
+    };
+
+} // namespace sg
+
+
+template <typename Tkey, typename Tmapped, bool Vsplit>
+template <typename Tk, typename... Targs, typename>
+inline
+sg::map_entry_t<Tkey, Tmapped, Vsplit>::map_entry_t(Tk&& key, Targs&&... args) :
+    __key(std::forward<Tk>(key)),
+    __mapped(std::forward<Targs>(args)...)
+{
+}
+
+template <typename Tkey, typename Tmapped, bool Vsplit>
+inline const Tkey&
+sg::map_entry_t<Tkey, Tmapped, Vsplit>::key() const
+{
+    return __key;
+}
+
+template <typename Tkey, typename Tmapped, bool Vsplit>
+inline Tmapped&
+sg::map_entry_t<Tkey, Tmapped, Vsplit>::mapped() const
+{
+    return __mapped;
+}
+
+template <typename Tkey, typename Tmapped>
+template <typename Tk, template <typename> class Tallocator, typename... Targs>
+inline
+sg::map_entry_t<Tkey, Tmapped, true>::map_entry_t(Tk&& key, Tallocator<Tmapped>& values, Targs&&... args) :
+    __key(std::forward<Tk>(key))
+{
+    Tmapped* mapped = values.allocate();
+    try
+    {
+        new (mapped) Tmapped(std::forward<Targs>(args)...);
+    }
+    catch(...)
+    {
+        values.deallocate(mapped);
+        throw;
+    }
+    __mapped = mapped;
+}
+
+template <typename Tkey, typename Tmapped>
+inline const Tkey&
+sg::map_entry_t<Tkey, Tmapped, true>::key() const
+{
+    return __key;
+}
+
+template <typename Tkey, typename Tmapped>
+inline Tmapped&
+sg::map_entry_t<Tkey, Tmapped, true>::mapped() const
+{
+    return *__mapped;
+}
+
+template <typename Tkey, typename Tmapped, bool Vsplit, typename Tcompare>
+inline
+sg::map_compare_t<Tkey, Tmapped, Vsplit, Tcompare>::map_compare_t(const Tcompare& compare) :
+    __compare{compare}
+{
+}
+
+template <typename Tkey, typename Tmapped, bool Vsplit, typename Tcompare>
+inline typename sg::map_compare_t<Tkey, Tmapped, Vsplit, Tcompare>::result_t
+sg::map_compare_t<Tkey, Tmapped, Vsplit, Tcompare>::operator()(const sg::map_entry_t<Tkey, Tmapped, Vsplit>& a, const sg::map_entry_t<Tkey, Tmapped, Vsplit>& b) const
+{
+    return __compare(a.key(), b.key());
+}
+
+template <typename Tkey, typename Tmapped, bool Vsplit, typename Tcompare>
+inline typename sg::map_compare_t<Tkey, Tmapped, Vsplit, Tcompare>::result_t
+sg::map_compare_t<Tkey, Tmapped, Vsplit, Tcompare>::operator()(const Tkey& a, const sg::map_entry_t<Tkey, Tmapped, Vsplit>& b) const
+{
+    return __compare(a, b.key());
+}
+
+template <typename Tkey, typename Tmapped, bool Vsplit, typename Tcompare>
+inline typename sg::map_compare_t<Tkey, Tmapped, Vsplit, Tcompare>::result_t
+sg::map_compare_t<Tkey, Tmapped, Vsplit, Tcompare>::operator()(const sg::map_entry_t<Tkey, Tmapped, Vsplit>& a, const Tkey& b) const
+{
+    return __compare(a.key(), b);
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::map(const Tcompare& compare) :
+    __tree{sg::map_compare_t<Tkey, Tmapped, Vsplit, Tcompare>{compare}}
+{
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::map(const sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>& obj) :
+    __tree{obj.__tree}
+{
+    if constexpr(Vsplit)
+    {
+        // The copied entries still point to the mapped values of the other
+        // map; every one of them gets a copy of its own. Should a copy
+        // throw, the entries not copied yet are let go before the tree
+        // is destroyed, as they don't belong to this map.
+        node_type* node = __tree.minimal();
+        try
+        {
+            for(; node != nullptr; node = __tree.successor(node))
+            {
+                Tmapped* mapped = values().allocate();
+                try
+                {
+                    new (mapped) Tmapped(*node->value().__mapped);
+                }
+                catch(...)
+                {
+                    values().deallocate(mapped);
+                    throw;
+                }
+                node->value().__mapped = mapped;
+            }
+        }
+        catch(...)
+        {
+            for(; node != nullptr; node = __tree.successor(node))
+            {
+                node->value().__mapped = nullptr;
+            }
+            destroy_values();
+            throw;
+        }
+    }
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::~map()
+{
+    destroy_values();
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>&
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::operator=(const sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>& obj)
+{
+    if(this != &obj)
+    {
+        // Build the copy aside first, so that the map stays intact
+        // if copying of some value throws.
+        sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit> copy{obj};
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>&
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::operator=(sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>&& obj)
+{
+    if(this != &obj)
+    {
+        destroy_values();
+        __tree = std::move(obj.__tree);
+        __values = std::move(obj.__values);
+    }
+    return *this;
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator::pointer::pointer(reference pair) :
+    __pair{pair}
+{
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator::reference*
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator::pointer::operator->()
+{
+    return &__pair;
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator::reference
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator::operator*()
+{
+    if(__node == nullptr)
+        throw std::runtime_error{"sg::map::iterator out of range"};
+    return {__node->value().key(), __node->value().mapped()};
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator::pointer
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator::operator->()
+{
+    return pointer{**this};
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator::operator++() // Prefix
+{
+    if(__node == nullptr)
+        throw std::runtime_error{"sg::map::iterator out of range"};
+    __node = __tree->successor(__node);
+    return *this;
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator::operator++(int) // Postfix
+{
+    if(__node == nullptr)
+        throw std::runtime_error{"sg::map::iterator out of range"};
+    typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator old = *this;
+    __node = __tree->successor(__node);
+    return old;
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline bool
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator::operator==(sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator iter)
+{
+    return __node == iter.__node;
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline bool
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator::operator!=(sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator iter)
+{
+    return __node != iter.__node;
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator::iterator(node_type* node, tree_type* tree) :
+    __node{node},
+    __tree{tree}
+{
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::find(const Tkey& key)
+{
+    return sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator{__tree.search(key), &__tree};
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline Tmapped&
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::operator[](const Tkey& key)
+{
+    return emplace_key(key).first.__node->value().mapped();
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline Tmapped&
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::operator[](Tkey&& key)
+{
+    return emplace_key(std::move(key)).first.__node->value().mapped();
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+template <typename... Targs>
+inline std::pair<typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator, bool>
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::try_emplace(const Tkey& key, Targs&&... args)
+{
+    return emplace_key(key, std::forward<Targs>(args)...);
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+template <typename... Targs>
+inline std::pair<typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator, bool>
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::try_emplace(Tkey&& key, Targs&&... args)
+{
+    return emplace_key(std::move(key), std::forward<Targs>(args)...);
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+template <typename Tm>
+inline std::pair<typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator, bool>
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::insert_or_assign(const Tkey& key, Tm&& mapped)
+{
+    return assign_key(key, std::forward<Tm>(mapped));
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+template <typename Tm>
+inline std::pair<typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator, bool>
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::insert_or_assign(Tkey&& key, Tm&& mapped)
+{
+    return assign_key(std::move(key), std::forward<Tm>(mapped));
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::erase(sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator position)
+{
+    if(position.__node == nullptr)
+        throw std::runtime_error{"sg::map::iterator out of range"};
+    node_type* next = __tree.successor(position.__node);
+    destroy_value(position.__node->value());
+    __tree.remove(position.__node);
+    return sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator{next, &__tree};
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline unsigned int
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::erase(const Tkey& key)
+{
+    node_type* node = __tree.search(key);
+    if(node == nullptr)
+        return 0;
+    destroy_value(node->value());
+    __tree.remove(node);
+    return 1;
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::begin()
+{
+    return sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator{__tree.minimal(), &__tree};
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::end()
+{
+    return sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator{nullptr, &__tree};
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline void
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::clear()
+{
+    destroy_values();
+    __tree.clear();
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline unsigned int
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::size()
+{
+    return __tree.size();
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline std::size_t
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::memory_usage()
+{
+    // The tree counts itself in, and it's a part of the map.
+    return sizeof(*this) - sizeof(__tree) + __tree.memory_usage() + (__values ? __values->memory_usage() : 0);
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+template <typename Tk, typename... Targs>
+inline std::pair<typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator, bool>
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::emplace_key(Tk&& key, Targs&&... args)
+{
+    // A single descent finds either the key or the place for it; the entry
+    // is built right in its node, and its mapped value (in the pool, with
+    // the split layout) only when the key is new.
+    std::pair<node_type*, bool> result;
+    if constexpr(Vsplit)
+        result = __tree.try_emplace(key, std::forward<Tk>(key), values(), std::forward<Targs>(args)...);
+    else
+        result = __tree.try_emplace(key, std::forward<Tk>(key), std::forward<Targs>(args)...);
+    return {sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator{result.first, &__tree}, result.second};
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+template <typename Tk, typename Tm>
+inline std::pair<typename sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator, bool>
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::assign_key(Tk&& key, Tm&& mapped)
+{
+    // The mapped value is either built from the given one along with a new
+    // entry, or assigned to the mapped value of the existing entry.
+    std::pair<sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::iterator, bool> result = emplace_key(std::forward<Tk>(key), std::forward<Tm>(mapped));
+    if(!result.second)
+        result.first.__node->value().mapped() = std::forward<Tm>(mapped);
+    return result;
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline Tallocator<Tmapped>&
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::values()
+{
+    if(!__values)
+        __values = std::make_unique<Tallocator<Tmapped>>();
+    return *__values;
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline void
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::destroy_value(const entry_type& entry)
+{
+    // The mapped value of the inline layout goes away with its node.
+    if constexpr(Vsplit)
+    {
+        if(entry.__mapped != nullptr)
+        {
+            entry.__mapped->~Tmapped();
+            __values->deallocate(entry.__mapped);
+            entry.__mapped = nullptr;
+        }
+    }
+}
+
+template <typename Tkey, typename Tmapped, typename Tcompare, template <typename> class Tallocator, bool Vsplit>
+inline void
+sg::map<Tkey, Tmapped, Tcompare, Tallocator, Vsplit>::destroy_values()
+{
+    // A pool that gives back its whole storage at once needn't be visited
+    // value by value, unless the values have something to clean up.
+    if constexpr(Vsplit)
+    {
+        if(!__values)
+            return;
+        if(Tallocator<Tmapped>::bulk_release && std::is_trivially_destructible<Tmapped>::value)
+        {
+            __values = nullptr;
+            return;
+        }
+        for(node_type* node = __tree.minimal(); node != nullptr; node = __tree.successor(node))
+        {
+            destroy_value(node->value());
+        }
+    }
+}
+
+#endif // __MAP_HPP__
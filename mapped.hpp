@@ -0,0 +1,77 @@
+#ifndef __MAPPED_HPP__
+#define __MAPPED_HPP__
+
+#include "frozen.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sg
+{
+    // Read-only sorted set served straight from a snapshot file written
+    // by frozen_set::save (or set::save). The file is mapped into memory
+    // and its Eytzinger array is searched and iterated in place, so opening
+    // a set takes no time whatever its size, and only the pages the queries
+    // touch are ever read from the disk. The comparator must order values
+    // the same way as the one the set was saved with.
+    //
+    // Copies share the mapping, which goes away with the last of them;
+    // it's held by frozen_set, so copies to a plain frozen_set share it too.
+    template <typename Tvalue, typename Tcompare = std::less<Tvalue>>
+    class mapped_set : public sg::frozen_set<Tvalue, Tcompare>
+    {
+    public:
+        explicit mapped_set(const std::string& path, const Tcompare& compare = Tcompare{});
+    };
+
+} // namespace sg
+
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::mapped_set<Tvalue, Tcompare>::mapped_set(const std::string& path, const Tcompare& compare) :
+    sg::frozen_set<Tvalue, Tcompare>{compare}
+{
+    static_assert(std::is_trivially_copyable<Tvalue>::value, "sg::mapped_set requires trivially copyable values");
+
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    if(descriptor == -1)
+        throw std::runtime_error{"sg::mapped_set can't open the snapshot file"};
+    struct stat status;
+    if(::fstat(descriptor, &status) == -1 || static_cast<std::size_t>(status.st_size) < sizeof(sg::snapshot_header_t))
+    {
+        ::close(descriptor);
+        throw std::runtime_error{"sg::mapped_set file is not a snapshot"};
+    }
+
+    // The mapping outlives the descriptor, which isn't needed past this point.
+    std::size_t length = status.st_size;
+    void* address = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, descriptor, 0);
+    ::close(descriptor);
+    if(address == MAP_FAILED)
+        throw std::runtime_error{"sg::mapped_set can't map the snapshot file"};
+    std::shared_ptr<const void> mapping{address, [length](const void* mapped) { ::munmap(const_cast<void*>(mapped), length); }};
+
+    // The header tells whether the file was written for values of this type
+    // and is whole; the values start right after it, aligned as mmap gives
+    // page-aligned addresses and the header takes a cache line.
+    const sg::snapshot_header_t* header = static_cast<const sg::snapshot_header_t*>(address);
+    if(header->__magic != sg::snapshot_header_t::magic_number || header->__version != sg::snapshot_header_t::current_version ||
+       header->__value_size != sizeof(Tvalue) || header->__size >= length / sizeof(Tvalue) ||
+       length != sizeof(sg::snapshot_header_t) + (header->__size + 1) * sizeof(Tvalue))
+        throw std::runtime_error{"sg::mapped_set file is not a snapshot"};
+
+    const Tvalue* values = reinterpret_cast<const Tvalue*>(static_cast<const char*>(address) + sizeof(sg::snapshot_header_t));
+    this->view(values, header->__size, std::move(mapping));
+}
+
+#endif // __MAPPED_HPP__
@@ -1,11 +1,32 @@
+#include "btree.hpp"
+#include "compact.hpp"
+#include "concurrent.hpp"
+#include "lean.hpp"
+#include "map.hpp"
+#include "mapped.hpp"
 #include "set.hpp"
+#include "static_set.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
 #include <ctime>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace
 {
@@ -34,22 +55,506 @@ sg::set<int> generate_set(unsigned int sample_size, unsigned int range)
 }
 
 // Evaluates how much on average it takes to search items of a set
-// from a range [0, range].
-double average_search_time(sg::set<int>& set, unsigned int range)
+// (either live or frozen) from a range [0, range].
+template <typename Tset>
+double average_search_time(Tset& set, unsigned int range)
 {
+    unsigned int found_count = 0;
+
     auto start = std::chrono::high_resolution_clock::now();
     for(int number = 0; number < range; ++number)
     {
-        [[maybe_unused]] auto iter = set.search(number);
+        found_count += set.search(number) != set.end();
     }
     auto end = std::chrono::high_resolution_clock::now();
 
+    // The count is checked only to keep the searches from being optimized out.
+    if(found_count > set.size())
+        std::cout << found_count << std::endl;
+
     // Total time of all search operations summated
-    double total_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    double total_time = std::chrono::duration<double, std::milli>(end - start).count();
 
     return total_time / range;
 }
 
+// Evaluates how much on average it takes to search for a random key
+// from the range [0, range] in a set (either live or frozen); unlike
+// a sweep of the range, the path of every search is unpredictable.
+template <typename Tset>
+double average_random_search_time(Tset& set, unsigned int range)
+{
+    constexpr unsigned int key_count = 1000000;
+
+    // The same keys are searched for in every set of the same size.
+    std::srand(set.size());
+    std::vector<int> keys(key_count);
+    for(int& key : keys)
+    {
+        key = get_random_int(range);
+    }
+    unsigned int found_count = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int key : keys)
+    {
+        found_count += set.search(key) != set.end();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    if(found_count > set.size())
+        std::cout << found_count << std::endl;
+
+    double total_time = std::chrono::duration<double, std::milli>(end - start).count();
+
+    return total_time / key_count;
+}
+
+// Evaluates how much on average it takes to search a map for random keys
+// from the range [0, range], reading the mapped value of the keys found.
+template <typename Tmap>
+double average_map_search_time(Tmap& map, unsigned int range)
+{
+    constexpr unsigned int key_count = 1000000;
+
+    std::srand(map.size());
+    std::vector<int> keys(key_count);
+    for(int& key : keys)
+    {
+        key = get_random_int(range);
+    }
+    long long sum = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int key : keys)
+    {
+        auto found = map.find(key);
+        if(found != map.end())
+            sum += found->second.front();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    // The sum is printed only to keep the searches from being optimized out.
+    if(sum == 42)
+        std::cout << sum << std::endl;
+
+    double total_time = std::chrono::duration<double, std::milli>(end - start).count();
+
+    return total_time / key_count;
+}
+
+// Measures how much on average it takes to insert an item into a set
+// using the given node allocator, and then to destroy the filled set;
+// both times are given per item.
+template <template <typename> class Tallocator>
+std::pair<double, double> average_insert_teardown_time(unsigned int sample_size, unsigned int range)
+{
+    // The same sequence of items is generated for every allocator.
+    std::srand(sample_size);
+    sg::set<int, std::less<int>, Tallocator>* set = new sg::set<int, std::less<int>, Tallocator>;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int i = 0; i < sample_size; ++i)
+    {
+        set->insert(get_random_int(range));
+    }
+    auto middle = std::chrono::high_resolution_clock::now();
+    delete set;
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double insert_time = std::chrono::duration<double, std::milli>(middle - start).count();
+    double teardown_time = std::chrono::duration<double, std::milli>(end - middle).count();
+
+    return {insert_time / sample_size, teardown_time / sample_size};
+}
+
+// Evaluates how much on average it takes to step an iterator over a set
+// of sample_size random items from the range [0, range], scanning
+// the whole set from the beginning to the end.
+template <typename Tset>
+double average_scan_time(unsigned int sample_size, unsigned int range)
+{
+    std::srand(sample_size);
+    Tset set;
+    for(int i = 0; i < sample_size; ++i)
+    {
+        set.insert(get_random_int(range));
+    }
+
+    // Small sets are scanned several times, so that the total time
+    // can be measured at all.
+    unsigned int pass_count = 1 + 10000000 / sample_size;
+    long long sum = 0;
+    unsigned int step_count = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int pass = 0; pass < pass_count; ++pass)
+    {
+        for(auto iter = set.begin(); iter != set.end(); ++iter)
+        {
+            sum += *iter;
+            ++step_count;
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    // The sum is printed only to keep the loop from being optimized out.
+    if(sum == 42)
+        std::cout << sum << std::endl;
+
+    double total_time = std::chrono::duration<double, std::milli>(end - start).count();
+    return total_time / step_count;
+}
+
+// Measures how much on average it takes to insert an item into a set
+// of the given type; also gives the bytes the filled set takes
+// per element.
+template <typename Tset>
+std::pair<double, double> average_insert_time(unsigned int sample_size, unsigned int range)
+{
+    // The same sequence of items is generated for every type of set.
+    std::srand(sample_size);
+    Tset set;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int i = 0; i < sample_size; ++i)
+    {
+        set.insert(get_random_int(range));
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double insert_time = std::chrono::duration<double, std::milli>(end - start).count();
+    return {insert_time / sample_size, static_cast<double>(set.memory_usage()) / set.size()};
+}
+
+// Measures how much on average it takes to insert an item into a set,
+// either one by one or in bulk mode, into a set already holding
+// as many items as are inserted, or an empty one if filled is false.
+std::pair<double, double> average_bulk_insert_time(unsigned int sample_size, unsigned int range, bool filled)
+{
+    // The same sequence of items is generated for both ways.
+    std::vector<int> keys(sample_size);
+    std::srand(sample_size);
+    for(int& key : keys)
+    {
+        key = get_random_int(range);
+    }
+    sg::set<int> initial;
+    initial.begin_bulk();
+    for(int i = 0; filled && i < sample_size; ++i)
+    {
+        initial.bulk_insert(get_random_int(range));
+    }
+    initial.end_bulk();
+
+    sg::set<int> single{initial};
+    auto single_start = std::chrono::high_resolution_clock::now();
+    for(int key : keys)
+    {
+        single.insert(key);
+    }
+    auto single_end = std::chrono::high_resolution_clock::now();
+
+    sg::set<int> bulk{initial};
+    auto bulk_start = std::chrono::high_resolution_clock::now();
+    bulk.begin_bulk();
+    for(int key : keys)
+    {
+        bulk.bulk_insert(key);
+    }
+    bulk.end_bulk();
+    auto bulk_end = std::chrono::high_resolution_clock::now();
+
+    if(bulk.size() != single.size())
+        std::cout << "Bulk and single insertions disagree" << std::endl;
+
+    double single_time = std::chrono::duration<double, std::milli>(single_end - single_start).count();
+    double bulk_time = std::chrono::duration<double, std::milli>(bulk_end - bulk_start).count();
+    return {single_time / sample_size, bulk_time / sample_size};
+}
+
+// Keys of a static set of the given size from the range [0, range],
+// made up at compile time by a linear congruential generator.
+template <std::size_t Vsize>
+struct static_keys_t
+{
+    int values[Vsize] = {};
+};
+
+template <std::size_t Vsize>
+constexpr static_keys_t<Vsize> make_static_keys(unsigned int range)
+{
+    static_keys_t<Vsize> keys;
+    unsigned int state = Vsize;
+    for(int& value : keys.values)
+    {
+        state = state * 1664525 + 1013904223;
+        value = state % (range + 1);
+    }
+    return keys;
+}
+
+// Compares a table of keys known at compile time kept in a static set,
+// in a frozen set and in a set: the time of building the latter two
+// at startup, which the static set doesn't take at all, and the time
+// of searching all three for every key of the range the table's keys
+// come from.
+template <std::size_t Vsize, unsigned int range>
+void static_table_times()
+{
+    static constexpr static_keys_t<Vsize> keys = make_static_keys<Vsize>(range);
+    static constexpr sg::static_set<int, Vsize> static_set{keys.values};
+
+    auto start = std::chrono::high_resolution_clock::now();
+    sg::set<int> set;
+    for(int key : keys.values)
+    {
+        set.insert(key);
+    }
+    auto middle = std::chrono::high_resolution_clock::now();
+    sg::frozen_set<int> frozen = set.freeze();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double set_build_time = std::chrono::duration<double, std::milli>(middle - start).count();
+    double frozen_build_time = std::chrono::duration<double, std::milli>(end - start).count();
+    double static_time = average_search_time(static_set, range);
+    double frozen_time = average_search_time(frozen, range);
+    double set_time = average_search_time(set, range);
+
+    std::cout << "Number of keys: " << static_set.size() << "; ";
+    std::cout << "Build time (set/frozen): " << set_build_time << " / " << frozen_build_time << " ms; ";
+    std::cout << "Average search time (static/frozen/set): ";
+    std::cout << static_time << " / " << frozen_time << " / " << set_time << " ms" << std::endl;
+}
+
+// Evaluates how much on average it takes to search for a random key
+// from the range [0, range] in a set, when a batch of keys is searched for
+// either in a loop of single searches or by a single call of search_many;
+// returns both times.
+std::pair<double, double> average_batch_search_time(sg::set<int>& set, unsigned int range)
+{
+    constexpr unsigned int key_count = 1000000;
+    constexpr unsigned int batch_size = 512;
+
+    std::vector<int> keys(key_count);
+    for(int& key : keys)
+    {
+        key = get_random_int(range);
+    }
+    std::vector<sg::set<int>::iterator> found(batch_size, set.end());
+    unsigned int found_count = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int first = 0; first < key_count; first += batch_size)
+    {
+        for(int i = 0; i < batch_size; ++i)
+        {
+            found[i] = set.search(keys[first + i]);
+        }
+        found_count += found[0] != set.end();
+    }
+    auto middle = std::chrono::high_resolution_clock::now();
+    for(int first = 0; first < key_count; first += batch_size)
+    {
+        set.search_many(keys.begin() + first, keys.begin() + first + batch_size, found.begin());
+        found_count += found[0] != set.end();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    // The count is printed only to keep the searches from being optimized out.
+    if(found_count == 42)
+        std::cout << found_count << std::endl;
+
+    double single_time = std::chrono::duration<double, std::milli>(middle - start).count();
+    double batch_time = std::chrono::duration<double, std::milli>(end - middle).count();
+
+    return {single_time / key_count, batch_time / key_count};
+}
+
+// Measures how long it takes to unite a set of first_size random values
+// with a set of second_size ones: with std::set_union over two std::sets,
+// with sg::set_union given the sets as lvalues (which it copies itself),
+// and with sg::set_union given the sets as rvalues to reuse; returns
+// the three times, and the time the copies alone take.
+std::tuple<double, double, double, double> set_union_times(unsigned int first_size, unsigned int second_size, unsigned int range)
+{
+    sg::set<int> sg_first = generate_set(first_size, range);
+    sg::set<int> sg_second = generate_set(second_size, range);
+    std::set<int> stl_first;
+    std::set<int> stl_second;
+    for(int value : sg_first)
+    {
+        stl_first.insert(stl_first.end(), value);
+    }
+    for(int value : sg_second)
+    {
+        stl_second.insert(stl_second.end(), value);
+    }
+    auto copy_start = std::chrono::high_resolution_clock::now();
+    sg::set<int> sg_first_copy{sg_first};
+    sg::set<int> sg_second_copy{sg_second};
+    auto copy_end = std::chrono::high_resolution_clock::now();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::set<int> stl_union;
+    std::set_union(stl_first.begin(), stl_first.end(), stl_second.begin(), stl_second.end(),
+                   std::inserter(stl_union, stl_union.end()));
+    auto stl_end = std::chrono::high_resolution_clock::now();
+    sg::set<int> sg_union = sg::set_union(sg_first, sg_second);
+    auto copied_end = std::chrono::high_resolution_clock::now();
+    sg::set<int> sg_moved_union = sg::set_union(std::move(sg_first_copy), std::move(sg_second_copy));
+    auto moved_end = std::chrono::high_resolution_clock::now();
+
+    // The sizes are printed only to keep the unions from being optimized out.
+    if(stl_union.size() + sg_union.size() + sg_moved_union.size() == 42)
+        std::cout << sg_union.size() << std::endl;
+
+    return {std::chrono::duration<double, std::milli>(stl_end - start).count(),
+            std::chrono::duration<double, std::milli>(copied_end - stl_end).count(),
+            std::chrono::duration<double, std::milli>(moved_end - copied_end).count(),
+            std::chrono::duration<double, std::milli>(copy_end - copy_start).count()};
+}
+
+// Evaluates how much on average it takes to insert the given keys, in
+// their order, into an empty set: with sg::set::insert (which starts at
+// the last inserted node), with insertions that always start at the root,
+// and into a std::set; returns the three times.
+std::tuple<double, double, double> average_ordered_insert_time(const std::vector<int>& keys)
+{
+    sg::set<int> set;
+    sg::rbt_t<int> tree;
+    std::set<int> stl_set;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int key : keys)
+    {
+        set.insert(key);
+    }
+    auto hinted_end = std::chrono::high_resolution_clock::now();
+    for(int key : keys)
+    {
+        tree.insert(key);
+    }
+    auto rooted_end = std::chrono::high_resolution_clock::now();
+    for(int key : keys)
+    {
+        stl_set.insert(key);
+    }
+    auto stl_end = std::chrono::high_resolution_clock::now();
+
+    // The sizes are printed only to keep the insertions from being optimized out.
+    if(set.size() + tree.size() + stl_set.size() == 42)
+        std::cout << set.size() << std::endl;
+
+    return {std::chrono::duration<double, std::milli>(hinted_end - start).count() / keys.size(),
+            std::chrono::duration<double, std::milli>(rooted_end - hinted_end).count() / keys.size(),
+            std::chrono::duration<double, std::milli>(stl_end - rooted_end).count() / keys.size()};
+}
+
+// Evaluates how much on average it takes to read a value of a random
+// range [low, low + width) of a set of sample_size random items from
+// the range [0, range]: by stepping an iterator from lower_bound and,
+// unless the set is a std::set, by buffered scans; returns both times.
+template <typename Tset>
+std::pair<double, double> average_range_scan_time(unsigned int sample_size, unsigned int width, unsigned int range)
+{
+    constexpr unsigned int range_count = 1000;
+    constexpr unsigned int buffer_size = 256;
+
+    std::srand(sample_size);
+    Tset set;
+    for(int i = 0; i < sample_size; ++i)
+    {
+        set.insert(get_random_int(range));
+    }
+    std::vector<int> lows(range_count);
+    for(int& low : lows)
+    {
+        low = get_random_int(range - width);
+    }
+
+    long long sum = 0;
+    unsigned int value_count = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int low : lows)
+    {
+        auto last = set.lower_bound(low + width);
+        for(auto iter = set.lower_bound(low); iter != last; ++iter)
+        {
+            sum += *iter;
+            ++value_count;
+        }
+    }
+    auto middle = std::chrono::high_resolution_clock::now();
+    if constexpr(!std::is_same_v<Tset, std::set<int>>)
+    {
+        int buffer[buffer_size];
+        for(int low : lows)
+        {
+            auto first = set.lower_bound(low);
+            auto last = set.lower_bound(low + width);
+            unsigned int count = 0;
+            while((count = set.scan(first, last, buffer, buffer_size)) != 0)
+            {
+                for(unsigned int i = 0; i < count; ++i)
+                {
+                    sum += buffer[i];
+                }
+            }
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    // The sum is printed only to keep the loops from being optimized out.
+    if(sum == 42)
+        std::cout << sum << std::endl;
+
+    double step_time = std::chrono::duration<double, std::milli>(middle - start).count();
+    double scan_time = std::chrono::duration<double, std::milli>(end - middle).count();
+    value_count = std::max(value_count, 1u);
+    return {step_time / value_count, scan_time / value_count};
+}
+
+// Measures how long it takes a set of sample_size random items from
+// the range [0, range] to answer its first query: when it's rebuilt by
+// inserting the items one by one, and when its snapshot file is mapped;
+// returns both times. The snapshot is written right before it's mapped,
+// so its pages are still in the page cache.
+std::pair<double, double> first_query_times(unsigned int sample_size, unsigned int range)
+{
+    const std::string path = "sg_snapshot_perf.bin";
+    std::vector<int> keys(sample_size);
+    for(int& key : keys)
+    {
+        key = get_random_int(range);
+    }
+    int query = get_random_int(range);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    sg::set<int> rebuilt;
+    for(int key : keys)
+    {
+        rebuilt.insert(key);
+    }
+    bool rebuilt_found = rebuilt.search(query) != rebuilt.end();
+    auto rebuilt_end = std::chrono::high_resolution_clock::now();
+
+    rebuilt.save(path);
+
+    auto mapped_start = std::chrono::high_resolution_clock::now();
+    sg::mapped_set<int> mapped{path};
+    bool mapped_found = mapped.search(query) != mapped.end();
+    auto mapped_end = std::chrono::high_resolution_clock::now();
+    std::remove(path.c_str());
+
+    // The results are compared only to keep the searches from being optimized out.
+    if(rebuilt_found != mapped_found)
+        std::cout << "The mapped set differs from the rebuilt one" << std::endl;
+
+    return {std::chrono::duration<double, std::milli>(rebuilt_end - start).count(),
+            std::chrono::duration<double, std::milli>(mapped_end - mapped_start).count()};
+}
+
 void main_perf()
 {
     constexpr unsigned int point_count = 6;
@@ -68,16 +573,542 @@ void main_perf()
     {
         unsigned int sample_size = sample_sizes[point];
         sg::set<int> set = generate_set(sample_size, random_range);
+        sg::frozen_set<int> frozen = set.freeze();
+        sg::btree_set<int> btree{set.begin(), set.end()};
         double time = average_search_time(set, random_range);
+        double frozen_time = average_search_time(frozen, random_range);
+        double btree_time = average_search_time(btree, random_range);
+        double random_time = average_random_search_time(set, random_range);
+        double frozen_random_time = average_random_search_time(frozen, random_range);
+        double btree_random_time = average_random_search_time(btree, random_range);
+
+        std::cout << "Number of elements: " << set.size() << "; ";
+        std::cout << "Average search time (live/frozen/btree): ";
+        std::cout << time << " / " << frozen_time << " / " << btree_time << " ms; ";
+        std::cout << "random keys: " << random_time << " / " << frozen_random_time << " / " << btree_random_time << " ms" << std::endl;
+    }
+}
+
+// Compares the slab pool of nodes with plain per-node heap allocations.
+void main_perf_allocation()
+{
+    constexpr unsigned int point_count = 6;
+    constexpr unsigned int random_range = 1e8;
+    std::array<int, point_count> sample_sizes
+    {
+        100,       // 10^2
+        1000,      // 10^3
+        10000,     // 10^4
+        100000,    // 10^5
+        1000000,   // 10^6
+        10000000,  // 10^7
+    };
+
+    for(int point = 0; point < point_count; ++point)
+    {
+        unsigned int sample_size = sample_sizes[point];
+        auto [pool_insert, pool_teardown] = average_insert_teardown_time<sg::pool_t>(sample_size, random_range);
+        auto [heap_insert, heap_teardown] = average_insert_teardown_time<sg::heap_t>(sample_size, random_range);
+
+        std::cout << "Number of insertions: " << sample_size << "; ";
+        std::cout << "Average insert time (pool/heap): " << pool_insert << " / " << heap_insert << " ms; ";
+        std::cout << "Average teardown time (pool/heap): " << pool_teardown << " / " << heap_teardown << " ms" << std::endl;
+    }
+}
+
+// Compares full scans of threaded sets, ordinary sets, B-tree sets and std::set.
+void main_perf_scan()
+{
+    constexpr unsigned int point_count = 6;
+    constexpr unsigned int random_range = 1e8;
+    std::array<int, point_count> sample_sizes
+    {
+        100,       // 10^2
+        1000,      // 10^3
+        10000,     // 10^4
+        100000,    // 10^5
+        1000000,   // 10^6
+        10000000,  // 10^7
+    };
+
+    for(int point = 0; point < point_count; ++point)
+    {
+        unsigned int sample_size = sample_sizes[point];
+        double threaded_time = average_scan_time<sg::set<int, std::less<int>, sg::pool_t, false, true>>(sample_size, random_range);
+        double plain_time = average_scan_time<sg::set<int>>(sample_size, random_range);
+        double btree_time = average_scan_time<sg::btree_set<int>>(sample_size, random_range);
+        double stl_time = average_scan_time<std::set<int>>(sample_size, random_range);
+
+        std::cout << "Number of insertions: " << sample_size << "; ";
+        std::cout << "Average step time (threaded/plain/btree/std::set): ";
+        std::cout << threaded_time << " / " << plain_time << " / " << btree_time << " / " << stl_time << " ms" << std::endl;
+    }
+}
+
+// Compares the memory taken by sets with pointer links and by compact
+// sets with 32-bit index links, and the time of searching them.
+void main_perf_memory()
+{
+    constexpr unsigned int point_count = 6;
+    constexpr unsigned int random_range = 1e8;
+    std::array<int, point_count> sample_sizes
+    {
+        100,       // 10^2
+        1000,      // 10^3
+        10000,     // 10^4
+        100000,    // 10^5
+        1000000,   // 10^6
+        10000000,  // 10^7
+    };
+
+    for(int point = 0; point < point_count; ++point)
+    {
+        unsigned int sample_size = sample_sizes[point];
+        sg::set<int> set = generate_set(sample_size, random_range);
+        sg::compact_set<int> compact;
+        compact.reserve(set.size());
+        for(auto iter = set.begin(); iter != set.end(); ++iter)
+        {
+            compact.insert(*iter);
+        }
+        double time = average_random_search_time(set, random_range);
+        double compact_time = average_random_search_time(compact, random_range);
+
+        std::cout << "Number of elements: " << set.size() << "; ";
+        std::cout << "Bytes per element (set/compact): ";
+        std::cout << static_cast<double>(set.memory_usage()) / set.size() << " / ";
+        std::cout << static_cast<double>(compact.memory_usage()) / compact.size() << "; ";
+        std::cout << "Average search time (set/compact): " << time << " / " << compact_time << " ms" << std::endl;
+    }
+}
+
+// Yields keys from the range [0, range] for every thread: either uniformly
+// distributed, or skewed, so that most keys fall into the low end of
+// the range, as hot keys do.
+std::vector<std::vector<int>> generate_thread_keys(unsigned int thread_count, unsigned int key_count,
+                                                   unsigned int range, bool skewed, unsigned int seed)
+{
+    std::vector<std::vector<int>> keys(thread_count);
+    for(int thread = 0; thread < thread_count; ++thread)
+    {
+        std::mt19937 generator{seed + thread};
+        std::uniform_real_distribution<double> distribution{0.0, 1.0};
+        for(int i = 0; i < key_count / thread_count; ++i)
+        {
+            double position = distribution(generator);
+            if(skewed)
+                position = position * position * position;
+            keys[thread].push_back(static_cast<int>(position * range));
+        }
+    }
+    return keys;
+}
+
+// Runs the operation for every key of every thread at once and returns
+// how many operations per second all the threads did together;
+// the operation returns whether it succeeded.
+template <typename Toperation>
+double parallel_throughput(const std::vector<std::vector<int>>& keys, Toperation operation)
+{
+    // Threads wait for each other to start, and then for the clock to be
+    // read, so that the time isn't spent on starting threads and no work
+    // is done before it runs.
+    // The results of the operations are summed up only to keep them from
+    // being optimized out.
+    std::atomic<unsigned int> ready_count{0};
+    std::atomic<bool> go{false};
+    std::atomic<unsigned int> result_count{0};
+    std::vector<std::thread> threads;
+    unsigned int operation_count = 0;
+    for(const std::vector<int>& thread_keys : keys)
+    {
+        operation_count += thread_keys.size();
+        threads.emplace_back([&]()
+        {
+            ++ready_count;
+            while(!go)
+                std::this_thread::yield();
+
+            unsigned int thread_result_count = 0;
+            for(int key : thread_keys)
+            {
+                thread_result_count += operation(key);
+            }
+            result_count += thread_result_count;
+        });
+    }
+
+    while(ready_count < keys.size())
+        std::this_thread::yield();
+    auto start = std::chrono::high_resolution_clock::now();
+    go = true;
+    for(std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    return operation_count / std::chrono::duration<double>(end - start).count();
+}
+
+// Compares a set sharded by ranges with per-shard reader/writer locks to
+// a single set behind a global mutex, with 1 to 64 threads inserting and
+// then searching for uniformly distributed and for skewed keys.
+void main_perf_concurrent()
+{
+    constexpr unsigned int point_count = 7;
+    constexpr unsigned int random_range = 1e8;
+    constexpr unsigned int key_count = 2000000;
+    constexpr unsigned int shard_count = 64;
+    std::array<int, point_count> thread_counts
+    {
+        1, 2, 4, 8, 16, 32, 64
+    };
+
+    std::vector<int> boundaries;
+    for(int shard = 1; shard < shard_count; ++shard)
+    {
+        boundaries.push_back(static_cast<int>(static_cast<double>(random_range) * shard / shard_count));
+    }
+
+    for(bool skewed : {false, true})
+    {
+        for(int point = 0; point < point_count; ++point)
+        {
+            unsigned int thread_count = thread_counts[point];
+            std::vector<std::vector<int>> inserted = generate_thread_keys(thread_count, key_count, random_range, skewed, 1);
+            std::vector<std::vector<int>> searched = generate_thread_keys(thread_count, key_count, random_range, skewed, 1000);
+
+            sg::concurrent_set<int> sharded{boundaries};
+            double sharded_insert = parallel_throughput(inserted, [&](int key) { return sharded.insert(key); });
+            double sharded_search = parallel_throughput(searched, [&](int key) { return sharded.contains(key); });
+
+            std::mutex mutex;
+            sg::set<int> locked;
+            double locked_insert = parallel_throughput(inserted, [&](int key)
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                return locked.insert(key).second;
+            });
+            double locked_search = parallel_throughput(searched, [&](int key)
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                return locked.search(key) != locked.end();
+            });
+
+            std::cout << (skewed ? "Skewed" : "Uniform") << " keys; threads: " << std::setw(2) << thread_count << "; ";
+            std::cout << "Inserts per second (sharded/locked): " << sharded_insert << " / " << locked_insert << "; ";
+            std::cout << "Searches per second (sharded/locked): " << sharded_search << " / " << locked_search << std::endl;
+        }
+    }
+}
+
+// Compares batched searches with prefetching to loops of single searches.
+void main_perf_batch_search()
+{
+    constexpr unsigned int point_count = 6;
+    constexpr unsigned int random_range = 1e8;
+    std::array<int, point_count> sample_sizes
+    {
+        100,       // 10^2
+        1000,      // 10^3
+        10000,     // 10^4
+        100000,    // 10^5
+        1000000,   // 10^6
+        10000000,  // 10^7
+    };
+
+    for(int point = 0; point < point_count; ++point)
+    {
+        unsigned int sample_size = sample_sizes[point];
+        sg::set<int> set = generate_set(sample_size, random_range);
+        auto [single_time, batch_time] = average_batch_search_time(set, random_range);
 
         std::cout << "Number of elements: " << set.size() << "; ";
+        std::cout << "Average search time (single/batched): " << single_time << " / " << batch_time << " ms" << std::endl;
+    }
+}
+
+// Compares unions of a big set with sets of different sizes; the work
+// of sg::set_union on given up sets grows with the smaller set only,
+// while sets passed as lvalues are copied in full first.
+void main_perf_set_operations()
+{
+    constexpr unsigned int first_size = 1000000;
+    constexpr unsigned int random_range = 1e8;
+    std::array<unsigned int, 4> second_sizes
+    {
+        100,       // 10^2
+        10000,     // 10^4
+        100000,    // 10^5
+        1000000,   // 10^6
+    };
+
+    for(unsigned int second_size : second_sizes)
+    {
+        auto [stl_time, copied_time, moved_time, copy_time] = set_union_times(first_size, second_size, random_range);
+
+        std::cout << "Number of elements: " << first_size << " and " << second_size << "; ";
+        std::cout << "Union time (std::set_union/lvalues/rvalues): " << stl_time << " / " << copied_time << " / " << moved_time << " ms; ";
+        std::cout << "of which copying the lvalues: " << copy_time << " ms" << std::endl;
+    }
+}
+
+// Compares insertions of keys that come in increasing order, nearly in
+// increasing order (as timestamps of events do) and in random order.
+void main_perf_insert_order()
+{
+    constexpr unsigned int key_count = 1000000;
+    constexpr unsigned int random_range = 1e8;
+
+    std::vector<int> random_keys(key_count);
+    for(int& key : random_keys)
+    {
+        key = get_random_int(random_range);
+    }
+    std::vector<int> increasing_keys = random_keys;
+    std::sort(increasing_keys.begin(), increasing_keys.end());
+    // Every key is moved up to 16 places away from its place in order.
+    std::vector<int> nearly_increasing_keys = increasing_keys;
+    for(int i = 0; i + 16 < key_count; ++i)
+    {
+        std::swap(nearly_increasing_keys[i], nearly_increasing_keys[i + get_random_int(16)]);
+    }
+
+    std::array<std::pair<const char*, const std::vector<int>*>, 3> orders
+    {{
+        {"Increasing", &increasing_keys},
+        {"Nearly increasing", &nearly_increasing_keys},
+        {"Random", &random_keys},
+    }};
+    for(const auto& [name, keys] : orders)
+    {
+        auto [hinted_time, rooted_time, stl_time] = average_ordered_insert_time(*keys);
+
+        std::cout << name << " keys: " << key_count << "; ";
+        std::cout << "Average insert time (from last/from root/std::set): " << hinted_time << " / " << rooted_time << " / " << stl_time << " ms" << std::endl;
+    }
+}
+
+// Compares reading ranges of a set value by value with an iterator and
+// batch by batch with buffered scans, for plain and threaded sets, with
+// std::set stepping through the same ranges as a reference.
+void main_perf_range_scan()
+{
+    constexpr unsigned int sample_size = 1000000;
+    constexpr unsigned int random_range = 1e8;
+    constexpr unsigned int point_count = 4;
+    // With 10^6 values in [0, 10^8], a range of width w holds w / 100
+    // values on average.
+    std::array<int, point_count> widths
+    {
+        1000,      // 10 values
+        10000,     // 100 values
+        100000,    // 1000 values
+        1000000,   // 10000 values
+    };
+
+    for(int point = 0; point < point_count; ++point)
+    {
+        unsigned int width = widths[point];
+        auto [plain_step, plain_scan] = average_range_scan_time<sg::set<int>>(sample_size, width, random_range);
+        auto [threaded_step, threaded_scan] = average_range_scan_time<sg::set<int, std::less<int>, sg::pool_t, false, true>>(sample_size, width, random_range);
+        double stl_step = average_range_scan_time<std::set<int>>(sample_size, width, random_range).first;
+
+        std::cout << "Range width: " << width << "; ";
+        std::cout << "Average value time (plain step/plain scan/threaded step/threaded scan/std::set): ";
+        std::cout << plain_step << " / " << plain_scan << " / " << threaded_step << " / " << threaded_scan << " / " << stl_step << " ms" << std::endl;
+    }
+}
+
+// Compares the time to the first query of a set rebuilt by insertions
+// and of a set mapped from its snapshot file.
+void main_perf_snapshot()
+{
+    constexpr unsigned int point_count = 3;
+    constexpr unsigned int random_range = 1e8;
+    std::array<int, point_count> sample_sizes
+    {
+        100000,    // 10^5
+        1000000,   // 10^6
+        10000000,  // 10^7
+    };
+
+    for(int point = 0; point < point_count; ++point)
+    {
+        unsigned int sample_size = sample_sizes[point];
+        auto [rebuild_time, mapped_time] = first_query_times(sample_size, random_range);
+
+        std::cout << "Number of insertions: " << sample_size << "; ";
+        std::cout << "Time to first query (rebuilt/mapped): " << rebuild_time << " / " << mapped_time << " ms" << std::endl;
+    }
+}
+
+// Relates the search time to the shape of the tree and the cost of
+// rebalancing, as counted by a set with the counting stats policy.
+void main_perf_tree_shape()
+{
+    constexpr unsigned int point_count = 5;
+    constexpr unsigned int random_range = 1e8;
+    std::array<int, point_count> sample_sizes
+    {
+        100,       // 10^2
+        1000,      // 10^3
+        10000,     // 10^4
+        100000,    // 10^5
+        1000000,   // 10^6
+    };
+
+    for(int point = 0; point < point_count; ++point)
+    {
+        unsigned int sample_size = sample_sizes[point];
+        sg::set<int, std::less<int>, sg::pool_t, false, false, sg::counting_stats_t> set;
+        for(int i = 0; i < sample_size; ++i)
+        {
+            set.insert(get_random_int(random_range));
+        }
+        sg::tree_stats_t inserted = set.stats();
+        double time = average_random_search_time(set, random_range);
+        sg::tree_stats_t searched = set.stats();
+
+        double insert_count = sample_size;
+        double search_comparisons = static_cast<double>(searched.comparisons - inserted.comparisons) / searched.searches;
+        std::cout << "Number of elements: " << set.size() << "; ";
+        std::cout << "Height (all/black): " << searched.height << " / " << searched.black_height << "; ";
+        std::cout << "Per insertion (comparisons/rotations/recolorings/rebalancing steps): ";
+        std::cout << inserted.comparisons / insert_count << " / " << (inserted.left_rotations + inserted.right_rotations) / insert_count << " / ";
+        std::cout << inserted.recolorings / insert_count << " / " << inserted.rebalance_iterations / insert_count << "; ";
+        std::cout << "Comparisons per search: " << search_comparisons << "; ";
         std::cout << "Average search time: " << time << " ms" << std::endl;
     }
 }
 
+// Compares searches in maps with big mapped values kept inline, in
+// the nodes, and split off into a pool of their own, with std::map
+// as a reference.
+void main_perf_map()
+{
+    constexpr unsigned int point_count = 4;
+    constexpr unsigned int random_range = 1e8;
+    std::array<int, point_count> sample_sizes
+    {
+        1000,      // 10^3
+        10000,     // 10^4
+        100000,    // 10^5
+        1000000,   // 10^6
+    };
+    using payload_t = std::array<long long, 16>;
+
+    for(int point = 0; point < point_count; ++point)
+    {
+        unsigned int sample_size = sample_sizes[point];
+        sg::map<int, payload_t> inline_map;
+        sg::map<int, payload_t, std::less<int>, sg::pool_t, true> split_map;
+        std::map<int, payload_t> stl_map;
+        std::srand(sample_size);
+        for(int i = 0; i < sample_size; ++i)
+        {
+            int key = get_random_int(random_range);
+            inline_map[key].front() = i;
+            split_map[key].front() = i;
+            stl_map[key].front() = i;
+        }
+        double inline_time = average_map_search_time(inline_map, random_range);
+        double split_time = average_map_search_time(split_map, random_range);
+        double stl_time = average_map_search_time(stl_map, random_range);
+
+        std::cout << "Number of elements: " << inline_map.size() << "; ";
+        std::cout << "Average search time with " << sizeof(payload_t) << "-byte values (inline/split/std::map): ";
+        std::cout << inline_time << " / " << split_time << " / " << stl_time << " ms" << std::endl;
+    }
+}
+
+// Compares sets whose nodes link to their parents with lean sets, whose
+// nodes don't: the memory they take, and the time of inserting into them
+// and of scanning them.
+void main_perf_lean()
+{
+    constexpr unsigned int point_count = 5;
+    constexpr unsigned int random_range = 1e8;
+    std::array<int, point_count> sample_sizes
+    {
+        1000,      // 10^3
+        10000,     // 10^4
+        100000,    // 10^5
+        1000000,   // 10^6
+        10000000,  // 10^7
+    };
+
+    for(int point = 0; point < point_count; ++point)
+    {
+        unsigned int sample_size = sample_sizes[point];
+        std::pair<double, double> set_insert = average_insert_time<sg::set<int>>(sample_size, random_range);
+        std::pair<double, double> lean_insert = average_insert_time<sg::lean_set<int>>(sample_size, random_range);
+        double set_scan = average_scan_time<sg::set<int>>(sample_size, random_range);
+        double lean_scan = average_scan_time<sg::lean_set<int>>(sample_size, random_range);
+
+        std::cout << "Number of insertions: " << sample_size << "; ";
+        std::cout << "Bytes per element (set/lean): " << set_insert.second << " / " << lean_insert.second << "; ";
+        std::cout << "Average insert time (set/lean): " << set_insert.first << " / " << lean_insert.first << " ms; ";
+        std::cout << "Average step time (set/lean): " << set_scan << " / " << lean_scan << " ms" << std::endl;
+    }
+}
+
+// Compares loading random items into a set one by one and in bulk mode,
+// into an empty set and into one already holding as many items.
+void main_perf_bulk()
+{
+    constexpr unsigned int point_count = 5;
+    constexpr unsigned int random_range = 1e8;
+    std::array<int, point_count> sample_sizes
+    {
+        1000,      // 10^3
+        10000,     // 10^4
+        100000,    // 10^5
+        1000000,   // 10^6
+        10000000,  // 10^7
+    };
+
+    for(int point = 0; point < point_count; ++point)
+    {
+        unsigned int sample_size = sample_sizes[point];
+        std::pair<double, double> empty = average_bulk_insert_time(sample_size, random_range, false);
+        std::pair<double, double> filled = average_bulk_insert_time(sample_size, random_range, true);
+
+        std::cout << "Number of insertions: " << sample_size << "; ";
+        std::cout << "Average insert time into an empty set (single/bulk): " << empty.first << " / " << empty.second << " ms; ";
+        std::cout << "into a filled one: " << filled.first << " / " << filled.second << " ms" << std::endl;
+    }
+}
+
+// Compares sets of keys known at compile time; see static_table_times.
+void main_perf_static()
+{
+    constexpr unsigned int random_range = 1000000;
+
+    static_table_times<16, random_range>();
+    static_table_times<64, random_range>();
+    static_table_times<256, random_range>();
+    static_table_times<1024, random_range>();
+}
+
 int main()
 {
     main_perf();
+    main_perf_allocation();
+    main_perf_scan();
+    main_perf_batch_search();
+    main_perf_memory();
+    main_perf_concurrent();
+    main_perf_set_operations();
+    main_perf_insert_order();
+    main_perf_range_scan();
+    main_perf_snapshot();
+    main_perf_tree_shape();
+    main_perf_map();
+    main_perf_lean();
+    main_perf_bulk();
+    main_perf_static();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,454 @@
+#ifndef __PERSISTENT_HPP__
+#define __PERSISTENT_HPP__
+
+#include "compare.hpp"
+#include "rbt.hpp"
+
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace sg
+{
+    // Node of a persistent tree. A node never changes once made; a new
+    // version of the tree makes new nodes along the changed path and
+    // shares all the others with the older versions, each node being owned
+    // by every version (and every parent) that refers to it.
+    template <typename Tvalue>
+    struct persistent_node_t
+    {
+        Tvalue __value;
+        std::shared_ptr<const sg::persistent_node_t<Tvalue>> __left;
+        std::shared_ptr<const sg::persistent_node_t<Tvalue>> __right;
+        sg::color_t __color = sg::color_t::red;
+    };
+
+    // Immutable version of a persistent set: it can be searched and
+    // iterated as long as it's kept, whatever happens to the set it was
+    // taken from; copying it takes O(1). Its nodes are freed when the last
+    // version referring to them is gone.
+    template <typename Tvalue, typename Tcompare = std::less<Tvalue>>
+    class snapshot_t
+    {
+    public:
+        snapshot_t() = default;
+        explicit snapshot_t(const Tcompare& compare);
+
+        class iterator
+        {
+        public:
+            iterator() = delete;
+
+            const Tvalue& operator->();
+            const Tvalue& operator*();
+            sg::snapshot_t<Tvalue, Tcompare>::iterator operator++();
+            sg::snapshot_t<Tvalue, Tcompare>::iterator operator++(int);
+            sg::snapshot_t<Tvalue, Tcompare>::iterator operator--();
+            sg::snapshot_t<Tvalue, Tcompare>::iterator operator--(int);
+            bool operator==(sg::snapshot_t<Tvalue, Tcompare>::iterator iter);
+            bool operator!=(sg::snapshot_t<Tvalue, Tcompare>::iterator iter);
+
+        private:
+            using node_t = sg::persistent_node_t<Tvalue>;
+
+            explicit iterator(const std::shared_ptr<const node_t>& root);
+
+            // Nodes have no links to their parents, so the iterator keeps
+            // the path from the root to the current node (empty at the end);
+            // it also keeps the version alive.
+            std::shared_ptr<const node_t> __root;
+            std::vector<const node_t*> __path;
+            friend class sg::snapshot_t<Tvalue, Tcompare>;
+        };
+
+        sg::snapshot_t<Tvalue, Tcompare>::iterator search(const Tvalue& value) const;
+        template <typename Tkey, typename Tc = Tcompare, typename = typename Tc::is_transparent>
+        sg::snapshot_t<Tvalue, Tcompare>::iterator search(const Tkey& key) const;
+        sg::snapshot_t<Tvalue, Tcompare>::iterator begin() const;
+        sg::snapshot_t<Tvalue, Tcompare>::iterator end() const;
+
+        unsigned int size() const;
+
+    protected:
+        using node_t = sg::persistent_node_t<Tvalue>;
+
+        template <typename Ta, typename Tb> bool less(const Ta& a, const Tb& b) const;
+        template <typename Tkey> sg::snapshot_t<Tvalue, Tcompare>::iterator lookup(const Tkey& key) const;
+
+        std::shared_ptr<const node_t> __root;
+        unsigned int __size = 0;
+        Tcompare __compare;
+    };
+
+    // Persistent sorted set: every insertion makes a new version of
+    // the tree out of O(log n) new nodes (the path from the root to the new
+    // node, with the nodes that the rebalancing changes) and shares the rest
+    // with the previous version, so that snapshot() costs O(1) and
+    // the snapshots stay valid while the set keeps changing.
+    template <typename Tvalue, typename Tcompare = std::less<Tvalue>>
+    class persistent_set : public sg::snapshot_t<Tvalue, Tcompare>
+    {
+    public:
+        persistent_set() = default;
+        explicit persistent_set(const Tcompare& compare);
+
+        bool insert(const Tvalue& value);
+        sg::snapshot_t<Tvalue, Tcompare> snapshot() const;
+        void clear();
+
+    protected:
+        using node_t = sg::persistent_node_t<Tvalue>;
+
+        std::shared_ptr<const node_t> insert_path(const std::shared_ptr<const node_t>& node, const Tvalue& value);
+        static std::shared_ptr<const node_t> balance(sg::color_t node_color, std::shared_ptr<const node_t> left,
+                                                     const Tvalue& value, std::shared_ptr<const node_t> right);
+        static std::shared_ptr<const node_t> make_node(sg::color_t color, std::shared_ptr<const node_t> left,
+                                                       const Tvalue& value, std::shared_ptr<const node_t> right);
+        static sg::color_t color(const std::shared_ptr<const node_t>& node);
+    };
+
+} // namespace sg
+
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::snapshot_t<Tvalue, Tcompare>::snapshot_t(const Tcompare& compare) :
+    __compare{compare}
+{
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::snapshot_t<Tvalue, Tcompare>::iterator
+sg::snapshot_t<Tvalue, Tcompare>::search(const Tvalue& value) const
+{
+    return lookup(value);
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Tkey, typename Tc, typename>
+inline typename sg::snapshot_t<Tvalue, Tcompare>::iterator
+sg::snapshot_t<Tvalue, Tcompare>::search(const Tkey& key) const
+{
+    return lookup(key);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::snapshot_t<Tvalue, Tcompare>::iterator
+sg::snapshot_t<Tvalue, Tcompare>::begin() const
+{
+    sg::snapshot_t<Tvalue, Tcompare>::iterator result{__root};
+    for(const node_t* node = __root.get(); node != nullptr; node = node->__left.get())
+    {
+        result.__path.push_back(node);
+    }
+    return result;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::snapshot_t<Tvalue, Tcompare>::iterator
+sg::snapshot_t<Tvalue, Tcompare>::end() const
+{
+    return sg::snapshot_t<Tvalue, Tcompare>::iterator{__root};
+}
+
+template <typename Tvalue, typename Tcompare>
+inline unsigned int
+sg::snapshot_t<Tvalue, Tcompare>::size() const
+{
+    return __size;
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Ta, typename Tb>
+inline bool
+sg::snapshot_t<Tvalue, Tcompare>::less(const Ta& a, const Tb& b) const
+{
+    if constexpr(sg::is_three_way<Tcompare>::value)
+        return __compare(a, b) < 0;
+    else
+        return __compare(a, b);
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Tkey>
+inline typename sg::snapshot_t<Tvalue, Tcompare>::iterator
+sg::snapshot_t<Tvalue, Tcompare>::lookup(const Tkey& key) const
+{
+    // One comparison per level, as in rbt_t; the path is recorded up to
+    // the candidate, the last node the search turned right at.
+    sg::snapshot_t<Tvalue, Tcompare>::iterator result{__root};
+    std::size_t candidate_depth = 0;
+    for(const node_t* node = __root.get(); node != nullptr;)
+    {
+        result.__path.push_back(node);
+        if(less(key, node->__value))
+        {
+            node = node->__left.get();
+        }
+        else
+        {
+            candidate_depth = result.__path.size();
+            node = node->__right.get();
+        }
+    }
+
+    result.__path.resize(candidate_depth);
+    if(candidate_depth == 0 || less(result.__path.back()->__value, key))
+        result.__path.clear();
+    return result;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::persistent_set<Tvalue, Tcompare>::persistent_set(const Tcompare& compare) :
+    sg::snapshot_t<Tvalue, Tcompare>{compare}
+{
+}
+
+template <typename Tvalue, typename Tcompare>
+inline bool
+sg::persistent_set<Tvalue, Tcompare>::insert(const Tvalue& value)
+{
+    // Returns whether the value was added, i.e. it wasn't in the set;
+    // a value that's already there doesn't make a new version.
+    if(this->lookup(value) != this->end())
+        return false;
+
+    std::shared_ptr<const node_t> root = insert_path(this->__root, value);
+    if(root->__color == sg::color_t::red)
+        root = make_node(sg::color_t::black, root->__left, root->__value, root->__right);
+    this->__root = std::move(root);
+    ++this->__size;
+    return true;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline sg::snapshot_t<Tvalue, Tcompare>
+sg::persistent_set<Tvalue, Tcompare>::snapshot() const
+{
+    // The current version is shared, not copied.
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::persistent_set<Tvalue, Tcompare>::clear()
+{
+    this->__root.reset();
+    this->__size = 0;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::shared_ptr<const typename sg::persistent_set<Tvalue, Tcompare>::node_t>
+sg::persistent_set<Tvalue, Tcompare>::insert_path(const std::shared_ptr<const node_t>& node, const Tvalue& value)
+{
+    // Makes a copy of the node with the value inserted below it. Instead
+    // of the recoloring and the rotations of insert_rebalance, which would
+    // change nodes in place, every copy on the way back up is rebalanced
+    // (Okasaki): a black node with a red child and a red grandchild is
+    // rebuilt as a red node with two black children, which is what those
+    // rotations and recolorings amount to. The recursion is as deep
+    // as the tree.
+    if(node == nullptr)
+        return make_node(sg::color_t::red, nullptr, value, nullptr);
+
+    if(this->less(value, node->__value))
+        return balance(node->__color, insert_path(node->__left, value), node->__value, node->__right);
+    else
+        return balance(node->__color, node->__left, node->__value, insert_path(node->__right, value));
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::shared_ptr<const typename sg::persistent_set<Tvalue, Tcompare>::node_t>
+sg::persistent_set<Tvalue, Tcompare>::balance(sg::color_t node_color, std::shared_ptr<const node_t> left,
+                                              const Tvalue& value, std::shared_ptr<const node_t> right)
+{
+    // The four shapes of a red node under a red node under a black one,
+    // all rebuilt as lower (x), middle (y) and upper (z) values with
+    // subtrees a, b, c and d in order.
+    if(node_color == sg::color_t::black)
+    {
+        if(color(left) == sg::color_t::red && color(left->__left) == sg::color_t::red)
+        {
+            const node_t& x = *left->__left;
+            return make_node(sg::color_t::red,
+                             make_node(sg::color_t::black, x.__left, x.__value, x.__right),
+                             left->__value,
+                             make_node(sg::color_t::black, left->__right, value, right));
+        }
+        if(color(left) == sg::color_t::red && color(left->__right) == sg::color_t::red)
+        {
+            const node_t& y = *left->__right;
+            return make_node(sg::color_t::red,
+                             make_node(sg::color_t::black, left->__left, left->__value, y.__left),
+                             y.__value,
+                             make_node(sg::color_t::black, y.__right, value, right));
+        }
+        if(color(right) == sg::color_t::red && color(right->__left) == sg::color_t::red)
+        {
+            const node_t& y = *right->__left;
+            return make_node(sg::color_t::red,
+                             make_node(sg::color_t::black, left, value, y.__left),
+                             y.__value,
+                             make_node(sg::color_t::black, y.__right, right->__value, right->__right));
+        }
+        if(color(right) == sg::color_t::red && color(right->__right) == sg::color_t::red)
+        {
+            const node_t& z = *right->__right;
+            return make_node(sg::color_t::red,
+                             make_node(sg::color_t::black, left, value, right->__left),
+                             right->__value,
+                             make_node(sg::color_t::black, z.__left, z.__value, z.__right));
+        }
+    }
+    return make_node(node_color, std::move(left), value, std::move(right));
+}
+
+template <typename Tvalue, typename Tcompare>
+inline std::shared_ptr<const typename sg::persistent_set<Tvalue, Tcompare>::node_t>
+sg::persistent_set<Tvalue, Tcompare>::make_node(sg::color_t color, std::shared_ptr<const node_t> left,
+                                                const Tvalue& value, std::shared_ptr<const node_t> right)
+{
+    // The node and its reference counts take a single allocation.
+    return std::make_shared<const node_t>(node_t{value, std::move(left), std::move(right), color});
+}
+
+template <typename Tvalue, typename Tcompare>
+inline sg::color_t
+sg::persistent_set<Tvalue, Tcompare>::color(const std::shared_ptr<const node_t>& node)
+{
+    // NILs are black.
+    if(node == nullptr)
+        return sg::color_t::black;
+    return node->__color;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::snapshot_t<Tvalue, Tcompare>::iterator::iterator(const std::shared_ptr<const node_t>& root) :
+    __root(root)
+{
+}
+
+template <typename Tvalue, typename Tcompare>
+inline const Tvalue&
+sg::snapshot_t<Tvalue, Tcompare>::iterator::operator->()
+{
+    return operator*();
+}
+
+template <typename Tvalue, typename Tcompare>
+inline const Tvalue&
+sg::snapshot_t<Tvalue, Tcompare>::iterator::operator*()
+{
+    if(__path.empty())
+        throw std::runtime_error{"sg::snapshot_t::iterator out of range"};
+    return __path.back()->__value;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::snapshot_t<Tvalue, Tcompare>::iterator
+sg::snapshot_t<Tvalue, Tcompare>::iterator::operator++()
+{
+    if(__path.empty())
+        throw std::runtime_error{"sg::snapshot_t::iterator out of range"};
+
+    // The leftmost node of the right subtree, or else the closest ancestor
+    // the node is to the left of.
+    const node_t* node = __path.back();
+    if(node->__right != nullptr)
+    {
+        for(node = node->__right.get(); node != nullptr; node = node->__left.get())
+        {
+            __path.push_back(node);
+        }
+        return *this;
+    }
+
+    __path.pop_back();
+    while(!__path.empty() && __path.back()->__right.get() == node)
+    {
+        node = __path.back();
+        __path.pop_back();
+    }
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::snapshot_t<Tvalue, Tcompare>::iterator
+sg::snapshot_t<Tvalue, Tcompare>::iterator::operator++(int)
+{
+    sg::snapshot_t<Tvalue, Tcompare>::iterator old = *this;
+    operator++();
+    return old;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::snapshot_t<Tvalue, Tcompare>::iterator
+sg::snapshot_t<Tvalue, Tcompare>::iterator::operator--()
+{
+    // Mirror of operator++; stepping back from the end goes to
+    // the rightmost node.
+    if(__path.empty())
+    {
+        for(const node_t* node = __root.get(); node != nullptr; node = node->__right.get())
+        {
+            __path.push_back(node);
+        }
+        if(__path.empty())
+            throw std::runtime_error{"sg::snapshot_t::iterator out of range"};
+        return *this;
+    }
+
+    const node_t* node = __path.back();
+    if(node->__left != nullptr)
+    {
+        for(node = node->__left.get(); node != nullptr; node = node->__right.get())
+        {
+            __path.push_back(node);
+        }
+        return *this;
+    }
+
+    std::vector<const node_t*> path = __path;
+    path.pop_back();
+    while(!path.empty() && path.back()->__left.get() == node)
+    {
+        node = path.back();
+        path.pop_back();
+    }
+    if(path.empty())
+        throw std::runtime_error{"sg::snapshot_t::iterator out of range"};
+    __path = std::move(path);
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::snapshot_t<Tvalue, Tcompare>::iterator
+sg::snapshot_t<Tvalue, Tcompare>::iterator::operator--(int)
+{
+    sg::snapshot_t<Tvalue, Tcompare>::iterator old = *this;
+    operator--();
+    return old;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline bool
+sg::snapshot_t<Tvalue, Tcompare>::iterator::operator==(sg::snapshot_t<Tvalue, Tcompare>::iterator iter)
+{
+    // Iterators of the same version at the same node have the same path.
+    const node_t* node = __path.empty() ? nullptr : __path.back();
+    const node_t* other = iter.__path.empty() ? nullptr : iter.__path.back();
+    return node == other && __root == iter.__root;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline bool
+sg::snapshot_t<Tvalue, Tcompare>::iterator::operator!=(sg::snapshot_t<Tvalue, Tcompare>::iterator iter)
+{
+    return !operator==(iter);
+}
+
+#endif // __PERSISTENT_HPP__
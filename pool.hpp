@@ -0,0 +1,220 @@
+#ifndef __POOL_HPP__
+#define __POOL_HPP__
+
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <new>
+
+namespace sg
+{
+    // Node allocator that hands out storage from large contiguous slabs.
+    // Freed slots are kept in an intrusive free list and reused before a new
+    // slab is requested; destroying the pool releases every slab at once,
+    // so the cost of a teardown is proportional to the number of slabs,
+    // not to the number of nodes.
+    //
+    // Slabs are reference counted: when a node is moved from one tree to
+    // another, the receiving pool adopts the slab the node lives in, which
+    // keeps the node valid after the tree it came from is destroyed.
+    template <typename Tnode>
+    class pool_t
+    {
+    public:
+        // The whole storage is given back when the pool is destroyed, so
+        // a tree doesn't have to visit its nodes one by one to free them.
+        static constexpr bool bulk_release = true;
+
+        pool_t() = default;
+        pool_t(const sg::pool_t<Tnode>& obj) = delete;
+        ~pool_t() = default;
+
+        sg::pool_t<Tnode>& operator=(const sg::pool_t<Tnode>& obj) = delete;
+
+        Tnode* allocate();
+        void deallocate(Tnode* node);
+        void adopt(sg::pool_t<Tnode>& origin, Tnode* node);
+        void adopt_storage(sg::pool_t<Tnode>& origin, std::size_t count);
+        std::size_t memory_usage();
+
+    private:
+        union slot_t
+        {
+            slot_t* next;
+            alignas(Tnode) unsigned char storage[sizeof(Tnode)];
+        };
+
+        struct slab_t
+        {
+            std::shared_ptr<slot_t[]> slots;
+            std::size_t size;
+        };
+
+        // Slabs grow geometrically from the first size up to the last one,
+        // so that small trees stay small and big trees need few slabs.
+        static constexpr std::size_t first_slab_size = 64;
+        static constexpr std::size_t last_slab_size = 65536;
+
+        std::map<slot_t*, slab_t> __slabs; // Both own and adopted slabs, by their first slot
+        slot_t* __free = nullptr;          // Head of the list of freed slots
+        slot_t* __cursor = nullptr;        // Next never used slot of the last slab
+        slot_t* __limit = nullptr;         // End of the last slab
+        std::size_t __slab_size = first_slab_size;
+    };
+
+    // Node allocator that requests every node from the general-purpose heap;
+    // kept as a reference point for the pool.
+    template <typename Tnode>
+    class heap_t
+    {
+    public:
+        static constexpr bool bulk_release = false;
+
+        Tnode* allocate();
+        void deallocate(Tnode* node);
+        void adopt(sg::heap_t<Tnode>& origin, Tnode* node);
+        void adopt_storage(sg::heap_t<Tnode>& origin, std::size_t count);
+        std::size_t memory_usage();
+
+    private:
+        std::size_t __count = 0; // Number of nodes allocated and not yet freed
+    };
+
+} // namespace sg
+
+
+template <typename Tnode>
+inline Tnode*
+sg::pool_t<Tnode>::allocate()
+{
+    slot_t* slot = nullptr;
+    if(__free != nullptr)
+    {
+        // Reuse a slot freed earlier; it's likely still in cache.
+        slot = __free;
+        __free = slot->next;
+    }
+    else
+    {
+        if(__cursor == __limit)
+        {
+            std::shared_ptr<slot_t[]> slots{new slot_t[__slab_size]};
+            __cursor = slots.get();
+            __limit = __cursor + __slab_size;
+            __slabs.emplace(__cursor, slab_t{std::move(slots), __slab_size});
+            if(__slab_size < last_slab_size)
+                __slab_size *= 2;
+        }
+        slot = __cursor++;
+    }
+    return reinterpret_cast<Tnode*>(slot->storage);
+}
+
+template <typename Tnode>
+inline void
+sg::pool_t<Tnode>::deallocate(Tnode* node)
+{
+    // The node must already be destroyed; its storage now holds the link
+    // to the next free slot.
+    slot_t* slot = reinterpret_cast<slot_t*>(node);
+    slot->next = __free;
+    __free = slot;
+}
+
+template <typename Tnode>
+inline void
+sg::pool_t<Tnode>::adopt(sg::pool_t<Tnode>& origin, Tnode* node)
+{
+    // Makes this pool a co-owner of the slab where the node was allocated
+    // by the origin pool; once the node is freed here, its slot simply
+    // joins the free list of this pool.
+    if(&origin == this)
+        return;
+
+    slot_t* slot = reinterpret_cast<slot_t*>(node);
+    auto found = origin.__slabs.upper_bound(slot);
+    const slab_t& slab = std::prev(found)->second;
+    __slabs.emplace(slab.slots.get(), slab);
+}
+
+template <typename Tnode>
+inline void
+sg::pool_t<Tnode>::adopt_storage(sg::pool_t<Tnode>& origin, std::size_t /* count */)
+{
+    // Same as adopt, but for count nodes at once, wherever they are in
+    // the origin pool; it's cheaper to co-own every slab of the origin
+    // than to look up the slab of each node.
+    if(&origin == this)
+        return;
+
+    for(const auto& [first, slab] : origin.__slabs)
+    {
+        __slabs.emplace(first, slab);
+    }
+}
+
+template <typename Tnode>
+inline std::size_t
+sg::pool_t<Tnode>::memory_usage()
+{
+    // Every slab counts in full, used or not, and so do the slabs shared
+    // with other pools.
+    std::size_t total = sizeof(*this);
+    for(const auto& [first, slab] : __slabs)
+    {
+        total += slab.size * sizeof(slot_t);
+    }
+    return total;
+}
+
+template <typename Tnode>
+inline Tnode*
+sg::heap_t<Tnode>::allocate()
+{
+    Tnode* node = static_cast<Tnode*>(::operator new(sizeof(Tnode)));
+    ++__count;
+    return node;
+}
+
+template <typename Tnode>
+inline void
+sg::heap_t<Tnode>::deallocate(Tnode* node)
+{
+    ::operator delete(node);
+    --__count;
+}
+
+template <typename Tnode>
+inline void
+sg::heap_t<Tnode>::adopt(sg::heap_t<Tnode>& origin, Tnode* node)
+{
+    // Every node is owned by the heap itself; only the count of nodes
+    // moves over.
+    if(&origin == this)
+        return;
+
+    --origin.__count;
+    ++__count;
+}
+
+template <typename Tnode>
+inline void
+sg::heap_t<Tnode>::adopt_storage(sg::heap_t<Tnode>& origin, std::size_t count)
+{
+    if(&origin == this)
+        return;
+
+    origin.__count -= count;
+    __count += count;
+}
+
+template <typename Tnode>
+inline std::size_t
+sg::heap_t<Tnode>::memory_usage()
+{
+    // The bookkeeping of the heap itself isn't known, and isn't counted.
+    return sizeof(*this) + __count * sizeof(Tnode);
+}
+
+#endif // __POOL_HPP__
@@ -1,10 +1,31 @@
 #ifndef __RBT_HPP__
 #define __RBT_HPP__
 
+#include "compare.hpp"
+#include "pool.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 namespace sg
 {
-    template <typename Tvalue> class node_t;
-    template <typename Tvalue> class rbt_t;
+    template <typename Tvalue, bool Vranked = false, bool Vthreaded = false> class node_t;
+    template <typename Tvalue, typename Tcompare = std::less<Tvalue>, template <typename> class Tallocator = sg::pool_t,
+              bool Vranked = false, bool Vthreaded = false, typename Tstats = sg::no_stats_t> class rbt_t;
+    template <typename Tvalue, template <typename> class Tallocator = sg::pool_t, bool Vranked = false,
+              bool Vthreaded = false> class node_handle_t;
 
     enum class color_t
     {
@@ -12,171 +33,748 @@ namespace sg
         black
     };
 
-    template <typename Tvalue>
-    class node_t
+    // Hints the processor to start loading the memory at the given address
+    // into cache, without waiting for it.
+    inline void prefetch(const void* address)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address);
+#endif
+    }
+
+    // Augmentation of a node of a ranked tree: the number of nodes in its
+    // subtree, including the node itself. Trees that aren't ranked get
+    // an empty base instead, which takes no memory.
+    template <bool Vranked>
+    class node_rank_t
+    {
+    };
+
+    template <>
+    class node_rank_t<true>
+    {
+    public:
+        unsigned int count();
+
+    protected:
+        unsigned int __count = 1;
+    };
+
+    // Augmentation of a node of a threaded tree: links to the previous and
+    // to the next nodes in order, so that iteration doesn't have to climb
+    // the tree. As with the rank, other trees get an empty base.
+    template <typename Tnode, bool Vthreaded>
+    class node_thread_t
+    {
+    };
+
+    template <typename Tnode>
+    class node_thread_t<Tnode, true>
+    {
+    public:
+        Tnode* previous();
+        Tnode* next();
+
+    protected:
+        Tnode* __previous = nullptr;
+        Tnode* __next = nullptr;
+    };
+
+    template <typename Tvalue, bool Vranked, bool Vthreaded>
+    class node_t : public sg::node_rank_t<Vranked>,
+                   public sg::node_thread_t<sg::node_t<Tvalue, Vranked, Vthreaded>, Vthreaded>
     {
     public:
         node_t(const Tvalue& val);
-        ~node_t();
+        node_t(Tvalue&& val);
+        template <typename... Targs> node_t(std::in_place_t, Targs&&... args);
 
         const Tvalue& value();
-        sg::node_t<Tvalue>* parent();
-        sg::node_t<Tvalue>* left();
-        sg::node_t<Tvalue>* right();
+        sg::node_t<Tvalue, Vranked, Vthreaded>* parent();
+        sg::node_t<Tvalue, Vranked, Vthreaded>* left();
+        sg::node_t<Tvalue, Vranked, Vthreaded>* right();
         sg::color_t color();
 
     private:
+        void set_parent(sg::node_t<Tvalue, Vranked, Vthreaded>* parent);
+        void set_color(sg::color_t color);
+
         Tvalue __value;
-        sg::node_t<Tvalue>* __parent = nullptr;
-        sg::node_t<Tvalue>* __left = nullptr;
-        sg::node_t<Tvalue>* __right = nullptr;
-        sg::color_t __color = sg::color_t::red; // Nodes in a RB-tree when added are first colored red.
+        // The link to the parent with the color packed into its lowest bit,
+        // which is always zero in the address of a node; this saves
+        // a whole padded word per node. Nodes in a RB-tree when added
+        // are first colored red.
+        std::uintptr_t __parent_color = static_cast<std::uintptr_t>(sg::color_t::red);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* __left = nullptr;
+        sg::node_t<Tvalue, Vranked, Vthreaded>* __right = nullptr;
+
+        template <typename, typename, template <typename> class, bool, bool, typename> friend class sg::rbt_t;
+    };
+
+    // Owns a node extracted from a tree, so that it can be inserted into
+    // another tree (or back into the same one) without reallocation.
+    // If the handle still owns a node when destroyed, the node is freed.
+    template <typename Tvalue, template <typename> class Tallocator, bool Vranked, bool Vthreaded>
+    class node_handle_t
+    {
+    public:
+        node_handle_t() = default;
+        node_handle_t(const sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>& obj) = delete;
+        node_handle_t(sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>&& obj);
+        ~node_handle_t();
+
+        sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>& operator=(const sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>& obj) = delete;
+        sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>& operator=(sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>&& obj);
+
+        const Tvalue& value();
+        bool empty();
+        explicit operator bool();
+
+    private:
+        node_handle_t(sg::node_t<Tvalue, Vranked, Vthreaded>* node, const std::shared_ptr<Tallocator<sg::node_t<Tvalue, Vranked, Vthreaded>>>& allocator);
+
+        sg::node_t<Tvalue, Vranked, Vthreaded>* __node = nullptr;
+        // The allocator the node came from; it's kept alive as long
+        // as the handle owns the node.
+        std::shared_ptr<Tallocator<sg::node_t<Tvalue, Vranked, Vthreaded>>> __allocator;
 
-        friend class sg::rbt_t<Tvalue>;
+        template <typename, typename, template <typename> class, bool, bool, typename> friend class sg::rbt_t;
     };
 
-    template <typename Tvalue>
-    class rbt_t
+    // The stats policy is a base of the tree, so that the default one,
+    // being empty, takes no memory. It counts the work done on the hot
+    // paths of the tree from its creation on; copying or moving a tree
+    // doesn't carry the counters over.
+    template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+    class rbt_t : private Tstats
     {
     public:
         rbt_t() = default;
-        rbt_t(const sg::rbt_t<Tvalue>& obj);
-        rbt_t(sg::rbt_t<Tvalue>&& obj);
+        explicit rbt_t(const Tcompare& compare);
+        rbt_t(const sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& obj);
+        rbt_t(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>&& obj);
         virtual ~rbt_t();
 
-        sg::node_t<Tvalue>* search(const Tvalue& value);
-        sg::node_t<Tvalue>* predecessor(sg::node_t<Tvalue>* node);
-        sg::node_t<Tvalue>* successor(sg::node_t<Tvalue>* node);
-        sg::node_t<Tvalue>* minimal();
-        sg::node_t<Tvalue>* maximal();
-        sg::node_t<Tvalue>* insert(const Tvalue& value);
-#ifdef SG_TODO
-        void remove(sg::node_t<Tvalue>* node);
-#endif
+        sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& operator=(const sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& obj);
+        sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& operator=(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>&& obj);
+
+        sg::node_t<Tvalue, Vranked, Vthreaded>* search(const Tvalue& value);
+        template <typename Tkey, typename Tc = Tcompare, typename = typename Tc::is_transparent>
+        sg::node_t<Tvalue, Vranked, Vthreaded>* search(const Tkey& key);
+        template <typename Titerator, typename Toutput> Toutput search_many(Titerator first, Titerator last, Toutput out);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* search(sg::node_t<Tvalue, Vranked, Vthreaded>* hint, const Tvalue& value);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* lower_bound(const Tvalue& value);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* upper_bound(const Tvalue& value);
+        std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, sg::node_t<Tvalue, Vranked, Vthreaded>*> equal_range(const Tvalue& value);
+        unsigned int scan(sg::node_t<Tvalue, Vranked, Vthreaded>*& first, sg::node_t<Tvalue, Vranked, Vthreaded>* last, Tvalue* buffer, unsigned int capacity);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* predecessor(sg::node_t<Tvalue, Vranked, Vthreaded>* node);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* successor(sg::node_t<Tvalue, Vranked, Vthreaded>* node);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* minimal();
+        sg::node_t<Tvalue, Vranked, Vthreaded>* maximal();
+        std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool> insert(const Tvalue& value);
+        std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool> insert(Tvalue&& value);
+        std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool> insert(sg::node_t<Tvalue, Vranked, Vthreaded>* hint, const Tvalue& value);
+        std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool> insert(sg::node_t<Tvalue, Vranked, Vthreaded>* hint, Tvalue&& value);
+        template <typename... Targs> std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool> emplace(Targs&&... args);
+        template <typename... Targs> std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool> emplace_hint(sg::node_t<Tvalue, Vranked, Vthreaded>* hint, Targs&&... args);
+        template <typename Tkey, typename... Targs> std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool> try_emplace(const Tkey& key, Targs&&... args);
+        unsigned int rank(const Tvalue& value);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* select(unsigned int index);
+        unsigned int count_range(const Tvalue& low, const Tvalue& high);
+        std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool> insert(sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>&& handle);
+        template <typename Titerator> void assign(Titerator first, Titerator last);
+        void insert_many(std::vector<Tvalue>& values);
+        void remove(sg::node_t<Tvalue, Vranked, Vthreaded>* node);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* remove(sg::node_t<Tvalue, Vranked, Vthreaded>* first, sg::node_t<Tvalue, Vranked, Vthreaded>* last);
+        sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded> extract(sg::node_t<Tvalue, Vranked, Vthreaded>* node);
+        void join(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& left, const Tvalue& value, sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& right);
+        bool split(const Tvalue& value, sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& left, sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& right);
+        void unite(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other);
+        void intersect(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other);
+        void subtract(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other);
 
+        void clear();
         unsigned int size();
+        Tcompare comparator();
+        std::size_t memory_usage();
+        sg::tree_stats_t stats();
 
     protected:
-        sg::color_t color(sg::node_t<Tvalue>* node);
+        template <typename Ta, typename Tb> bool less(const Ta& a, const Tb& b);
+        template <typename Tkey> sg::node_t<Tvalue, Vranked, Vthreaded>* lookup(const Tkey& key);
 
-        void left_rotate(sg::node_t<Tvalue>* upper);
-        void right_rotate(sg::node_t<Tvalue>* upper);
+        sg::color_t color(sg::node_t<Tvalue, Vranked, Vthreaded>* node);
+        unsigned int count(sg::node_t<Tvalue, Vranked, Vthreaded>* node);
+        void update_count(sg::node_t<Tvalue, Vranked, Vthreaded>* node);
+        void update_path_counts(sg::node_t<Tvalue, Vranked, Vthreaded>* node);
 
-        void insert_rebalance(sg::node_t<Tvalue>* inserted);
-#ifdef SG_TODO
-        void remove_rebalance(sg::node_t<Tvalue>* node);
-#endif
+        void left_rotate(sg::node_t<Tvalue, Vranked, Vthreaded>* upper);
+        void right_rotate(sg::node_t<Tvalue, Vranked, Vthreaded>* upper);
+
+        void insert_rebalance(sg::node_t<Tvalue, Vranked, Vthreaded>* inserted);
+        void remove_rebalance(sg::node_t<Tvalue, Vranked, Vthreaded>* node, sg::node_t<Tvalue, Vranked, Vthreaded>* parent);
 
-        sg::node_t<Tvalue>* __root = nullptr;
+        template <typename Tkey>
+        sg::node_t<Tvalue, Vranked, Vthreaded>* find_place(const Tkey& key, sg::node_t<Tvalue, Vranked, Vthreaded>* start, sg::node_t<Tvalue, Vranked, Vthreaded>*& parent, bool& to_left);
+        template <typename Tkey>
+        sg::node_t<Tvalue, Vranked, Vthreaded>* find_place_near(sg::node_t<Tvalue, Vranked, Vthreaded>* hint, const Tkey& key, sg::node_t<Tvalue, Vranked, Vthreaded>*& parent, bool& to_left);
+        template <typename Tv> std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool> insert_value(sg::node_t<Tvalue, Vranked, Vthreaded>* hint, Tv&& value);
+        void link_at(sg::node_t<Tvalue, Vranked, Vthreaded>* node, sg::node_t<Tvalue, Vranked, Vthreaded>* parent, bool to_left);
+        void transplant(sg::node_t<Tvalue, Vranked, Vthreaded>* replaced, sg::node_t<Tvalue, Vranked, Vthreaded>* node);
+        void unlink_node(sg::node_t<Tvalue, Vranked, Vthreaded>* node);
+        void thread_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>* node, sg::node_t<Tvalue, Vranked, Vthreaded>*& previous);
+        void thread_tree();
+
+        Tallocator<sg::node_t<Tvalue, Vranked, Vthreaded>>& allocator();
+        sg::node_t<Tvalue, Vranked, Vthreaded>* create_node(const Tvalue& value);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* create_node(Tvalue&& value);
+        template <typename... Targs> sg::node_t<Tvalue, Vranked, Vthreaded>* create_node(std::in_place_t, Targs&&... args);
+        void destroy_node(sg::node_t<Tvalue, Vranked, Vthreaded>* node);
+        unsigned int destroy_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>* node);
+        static unsigned int count_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>* node);
+        static unsigned int black_height(sg::node_t<Tvalue, Vranked, Vthreaded>* node);
+        static unsigned int subtree_height(sg::node_t<Tvalue, Vranked, Vthreaded>* node);
+        void take_storage(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other, std::size_t count);
+        void release();
+
+        // Operations on detached subtrees, given with their black heights;
+        // they never touch the root of the tree, so that different subtrees
+        // can be worked on by different threads at once.
+        sg::node_t<Tvalue, Vranked, Vthreaded>* join_subtrees(sg::node_t<Tvalue, Vranked, Vthreaded>* left, unsigned int left_height, sg::node_t<Tvalue, Vranked, Vthreaded>* middle,
+                         sg::node_t<Tvalue, Vranked, Vthreaded>* right, unsigned int right_height, unsigned int& height);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* join_right(sg::node_t<Tvalue, Vranked, Vthreaded>* node, unsigned int height, sg::node_t<Tvalue, Vranked, Vthreaded>* middle, sg::node_t<Tvalue, Vranked, Vthreaded>* right, unsigned int right_height);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* join_left(sg::node_t<Tvalue, Vranked, Vthreaded>* left, unsigned int left_height, sg::node_t<Tvalue, Vranked, Vthreaded>* middle, sg::node_t<Tvalue, Vranked, Vthreaded>* node, unsigned int height);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* join_pair(sg::node_t<Tvalue, Vranked, Vthreaded>* left, unsigned int left_height, sg::node_t<Tvalue, Vranked, Vthreaded>* right, unsigned int right_height, unsigned int& height);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* split_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>* node, unsigned int height, const Tvalue& value, sg::node_t<Tvalue, Vranked, Vthreaded>*& left, unsigned int& left_height,
+                         sg::node_t<Tvalue, Vranked, Vthreaded>*& right, unsigned int& right_height);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* split_last(sg::node_t<Tvalue, Vranked, Vthreaded>* node, unsigned int height, sg::node_t<Tvalue, Vranked, Vthreaded>*& rest, unsigned int& rest_height);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* left_rotate_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>* upper);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* right_rotate_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>* upper);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* unite_subtrees(sg::node_t<Tvalue, Vranked, Vthreaded>* first, unsigned int first_height, sg::node_t<Tvalue, Vranked, Vthreaded>* second, unsigned int second_height,
+                          unsigned int& height, std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*>& dropped, unsigned int workers);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* intersect_subtrees(sg::node_t<Tvalue, Vranked, Vthreaded>* first, unsigned int first_height, sg::node_t<Tvalue, Vranked, Vthreaded>* second, unsigned int second_height,
+                              unsigned int& height, std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*>& dropped, unsigned int workers);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* subtract_subtrees(sg::node_t<Tvalue, Vranked, Vthreaded>* first, unsigned int first_height, sg::node_t<Tvalue, Vranked, Vthreaded>* second, unsigned int second_height,
+                             unsigned int& height, std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*>& dropped, unsigned int workers);
+        void finish_set_operation(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other, std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*>& dropped);
+        template <typename Tleft, typename Tright>
+        static void run_both(unsigned int workers, unsigned int height, Tleft left, Tright right);
+        static unsigned int red_depth(unsigned int count);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* clone_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>* source, sg::node_t<Tvalue, Vranked, Vthreaded>* parent);
+        template <typename Titerator>
+        sg::node_t<Tvalue, Vranked, Vthreaded>* build_subtree(Titerator& current, Titerator last, unsigned int count,
+                                          unsigned int depth, unsigned int red_depth);
+        sg::node_t<Tvalue, Vranked, Vthreaded>* link_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>** nodes, unsigned int count,
+                                         unsigned int depth, unsigned int red_depth);
+
+        sg::node_t<Tvalue, Vranked, Vthreaded>* __root = nullptr;
         unsigned int __size = 0;
+        Tcompare __compare;
+        // The first and the last nodes in order, only kept by threaded trees.
+        sg::node_t<Tvalue, Vranked, Vthreaded>* __leftmost = nullptr;
+        sg::node_t<Tvalue, Vranked, Vthreaded>* __rightmost = nullptr;
+        // Shared with the handles of the nodes extracted from the tree;
+        // created on the first allocation.
+        std::shared_ptr<Tallocator<sg::node_t<Tvalue, Vranked, Vthreaded>>> __allocator;
     };
 
 } // namespace sg
 
 
-template <typename Tvalue>
+template <typename Tvalue, bool Vranked, bool Vthreaded>
 inline
-sg::node_t<Tvalue>::~node_t()
+sg::node_t<Tvalue, Vranked, Vthreaded>::node_t(const Tvalue& val) :
+    __value{val}
 {
-    if(__left)
-        delete __left;
-    if(__right)
-        delete __right;
 }
 
-template <typename Tvalue>
+template <typename Tvalue, bool Vranked, bool Vthreaded>
 inline
-sg::node_t<Tvalue>::node_t(const Tvalue& val) :
-    __value{val}
+sg::node_t<Tvalue, Vranked, Vthreaded>::node_t(Tvalue&& val) :
+    __value{std::move(val)}
+{
+}
+
+template <typename Tvalue, bool Vranked, bool Vthreaded>
+template <typename... Targs>
+inline
+sg::node_t<Tvalue, Vranked, Vthreaded>::node_t(std::in_place_t, Targs&&... args) :
+    __value(std::forward<Targs>(args)...)
 {
 }
 
-template <typename Tvalue>
+template <typename Tvalue, bool Vranked, bool Vthreaded>
 inline const Tvalue&
-sg::node_t<Tvalue>::value()
+sg::node_t<Tvalue, Vranked, Vthreaded>::value()
 {
     return __value;
 }
 
-template <typename Tvalue>
-inline sg::node_t<Tvalue>*
-sg::node_t<Tvalue>::parent()
+template <typename Tvalue, bool Vranked, bool Vthreaded>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::node_t<Tvalue, Vranked, Vthreaded>::parent()
 {
-    return __parent;
+    return reinterpret_cast<sg::node_t<Tvalue, Vranked, Vthreaded>*>(__parent_color & ~std::uintptr_t{1});
 }
 
-template <typename Tvalue>
-inline sg::node_t<Tvalue>*
-sg::node_t<Tvalue>::left()
+template <typename Tvalue, bool Vranked, bool Vthreaded>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::node_t<Tvalue, Vranked, Vthreaded>::left()
 {
     return __left;
 }
 
-template <typename Tvalue>
-inline sg::node_t<Tvalue>*
-sg::node_t<Tvalue>::right()
+template <typename Tvalue, bool Vranked, bool Vthreaded>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::node_t<Tvalue, Vranked, Vthreaded>::right()
 {
     return __right;
 }
 
-template <typename Tvalue>
+template <typename Tvalue, bool Vranked, bool Vthreaded>
 inline sg::color_t
-sg::node_t<Tvalue>::color()
+sg::node_t<Tvalue, Vranked, Vthreaded>::color()
+{
+    return static_cast<sg::color_t>(__parent_color & 1);
+}
+
+template <typename Tvalue, bool Vranked, bool Vthreaded>
+inline void
+sg::node_t<Tvalue, Vranked, Vthreaded>::set_parent(sg::node_t<Tvalue, Vranked, Vthreaded>* parent)
+{
+    __parent_color = reinterpret_cast<std::uintptr_t>(parent) | (__parent_color & 1);
+}
+
+template <typename Tvalue, bool Vranked, bool Vthreaded>
+inline void
+sg::node_t<Tvalue, Vranked, Vthreaded>::set_color(sg::color_t color)
+{
+    __parent_color = (__parent_color & ~std::uintptr_t{1}) | static_cast<std::uintptr_t>(color);
+}
+
+inline unsigned int
+sg::node_rank_t<true>::count()
+{
+    return __count;
+}
+
+template <typename Tnode>
+inline Tnode*
+sg::node_thread_t<Tnode, true>::previous()
 {
-    return __color;
+    return __previous;
 }
 
-template <typename Tvalue>
+template <typename Tnode>
+inline Tnode*
+sg::node_thread_t<Tnode, true>::next()
+{
+    return __next;
+}
+
+template <typename Tvalue, template <typename> class Tallocator, bool Vranked, bool Vthreaded>
+inline
+sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>::node_handle_t(sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>&& obj) :
+    __node{obj.__node},
+    __allocator{std::move(obj.__allocator)}
+{
+    obj.__node = nullptr;
+}
+
+template <typename Tvalue, template <typename> class Tallocator, bool Vranked, bool Vthreaded>
+inline
+sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>::node_handle_t(sg::node_t<Tvalue, Vranked, Vthreaded>* node,
+                                                     const std::shared_ptr<Tallocator<sg::node_t<Tvalue, Vranked, Vthreaded>>>& allocator) :
+    __node{node},
+    __allocator{allocator}
+{
+}
+
+template <typename Tvalue, template <typename> class Tallocator, bool Vranked, bool Vthreaded>
+inline
+sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>::~node_handle_t()
+{
+    if(__node)
+    {
+        __node->~node_t();
+        __allocator->deallocate(__node);
+    }
+}
+
+template <typename Tvalue, template <typename> class Tallocator, bool Vranked, bool Vthreaded>
+inline sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>&
+sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>::operator=(sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>&& obj)
+{
+    if(this != &obj)
+    {
+        if(__node)
+        {
+            __node->~node_t();
+            __allocator->deallocate(__node);
+        }
+        __node = obj.__node;
+        __allocator = std::move(obj.__allocator);
+        obj.__node = nullptr;
+    }
+    return *this;
+}
+
+template <typename Tvalue, template <typename> class Tallocator, bool Vranked, bool Vthreaded>
+inline const Tvalue&
+sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>::value()
+{
+    return __node->value();
+}
+
+template <typename Tvalue, template <typename> class Tallocator, bool Vranked, bool Vthreaded>
+inline bool
+sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>::empty()
+{
+    return __node == nullptr;
+}
+
+template <typename Tvalue, template <typename> class Tallocator, bool Vranked, bool Vthreaded>
+inline
+sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>::operator bool()
+{
+    return __node != nullptr;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::rbt_t(const Tcompare& compare) :
+    __compare{compare}
+{
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
 inline
-sg::rbt_t<Tvalue>::rbt_t(const sg::rbt_t<Tvalue>& obj)
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::rbt_t(const sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& obj)
 {
-    // TODO: It has to copy every single item in the tree
-    // TODO: one by one, re-creating the data structure.
+    // The copy repeats the shape and the colors of the original tree,
+    // so neither comparisons nor rebalancing are needed.
+    __compare = obj.__compare;
+    __root = clone_subtree(obj.__root, nullptr);
     __size = obj.__size;
+    thread_tree();
 }
 
-template <typename Tvalue>
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
 inline
-sg::rbt_t<Tvalue>::rbt_t(sg::rbt_t<Tvalue>&& obj)
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::rbt_t(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>&& obj)
 {
     __root = obj.__root;
     __size = obj.__size;
+    __compare = obj.__compare;
+    __leftmost = obj.__leftmost;
+    __rightmost = obj.__rightmost;
+    __allocator = std::move(obj.__allocator);
 
     obj.__root = nullptr;
     obj.__size = 0;
+    obj.__leftmost = nullptr;
+    obj.__rightmost = nullptr;
 }
 
-template <typename Tvalue>
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
 inline
-sg::rbt_t<Tvalue>::~rbt_t()
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::~rbt_t()
+{
+    clear();
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>&
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::operator=(const sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& obj)
+{
+    if(this != &obj)
+    {
+        // Build the copy aside first, so that the tree stays intact
+        // if copying of some value throws.
+        sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> copy{obj};
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>&
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::operator=(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>&& obj)
+{
+    if(this != &obj)
+    {
+        clear();
+
+        __root = obj.__root;
+        __size = obj.__size;
+        __compare = obj.__compare;
+        __leftmost = obj.__leftmost;
+        __rightmost = obj.__rightmost;
+        __allocator = std::move(obj.__allocator);
+
+        obj.__root = nullptr;
+        obj.__size = 0;
+        obj.__leftmost = nullptr;
+        obj.__rightmost = nullptr;
+    }
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::search(const Tvalue& value)
+{
+    return lookup(value);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Tkey, typename Tc, typename>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::search(const Tkey& key)
+{
+    // Only available with a transparent comparator, the key is compared
+    // with the values of the tree as it is.
+    return lookup(key);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::search(sg::node_t<Tvalue, Vranked, Vthreaded>* hint, const Tvalue& value)
+{
+    // Starts the search at the hint (a node of the tree, or nullptr
+    // for the root); the closer the value is to it, the faster.
+    sg::node_t<Tvalue, Vranked, Vthreaded>* parent = nullptr;
+    bool to_left = false;
+    return find_place_near(hint, value, parent, to_left);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Titerator, typename Toutput>
+inline Toutput
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::search_many(Titerator first, Titerator last, Toutput out)
+{
+    // Searches for every key in the range [first, last) and writes the found
+    // nodes (or nullptrs) to out in the same order. In a big tree almost
+    // every step of a search is a cache miss, which can't start before
+    // the previous one ends; so the keys are searched for in groups, one
+    // level at a time, and the next node of every key is prefetched while
+    // the other keys of the group make their steps.
+    constexpr unsigned int lane_count = 16;
+
+    Titerator keys[lane_count];
+    sg::node_t<Tvalue, Vranked, Vthreaded>* nodes[lane_count];
+    sg::node_t<Tvalue, Vranked, Vthreaded>* candidates[lane_count];
+
+    while(first != last)
+    {
+        unsigned int count = 0;
+        for(; count < lane_count && first != last; ++count, ++first)
+        {
+            keys[count] = first;
+            nodes[count] = __root;
+            candidates[count] = nullptr;
+        }
+
+        // Same steps as in lookup, interleaved across the keys of the group.
+        bool active = __root != nullptr;
+        while(active)
+        {
+            active = false;
+            for(unsigned int lane = 0; lane < count; ++lane)
+            {
+                sg::node_t<Tvalue, Vranked, Vthreaded>* node = nodes[lane];
+                if(node == nullptr)
+                    continue;
+
+                sg::node_t<Tvalue, Vranked, Vthreaded>* next = nullptr;
+                if constexpr(sg::is_three_way<Tcompare>::value)
+                {
+                    int order = __compare(*keys[lane], node->value());
+                    if(order == 0)
+                        candidates[lane] = node;
+                    else
+                        next = order < 0 ? node->left() : node->right();
+                }
+                else
+                {
+                    if(__compare(*keys[lane], node->value()))
+                    {
+                        next = node->left();
+                    }
+                    else
+                    {
+                        candidates[lane] = node;
+                        next = node->right();
+                    }
+                }
+
+                nodes[lane] = next;
+                if(next != nullptr)
+                {
+                    sg::prefetch(next);
+                    active = true;
+                }
+            }
+        }
+
+        for(unsigned int lane = 0; lane < count; ++lane)
+        {
+            sg::node_t<Tvalue, Vranked, Vthreaded>* found = candidates[lane];
+            if constexpr(!sg::is_three_way<Tcompare>::value)
+            {
+                if(found != nullptr && __compare(found->value(), *keys[lane]))
+                    found = nullptr;
+            }
+            *out = found;
+            ++out;
+        }
+    }
+    return out;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::lower_bound(const Tvalue& value)
+{
+    // The first node whose value is not less than the given one, or nullptr
+    // if there's none: the last node the descent went left from.
+    sg::node_t<Tvalue, Vranked, Vthreaded>* result = nullptr;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __root;
+    while(node != nullptr)
+    {
+        if(less(node->__value, value))
+        {
+            node = node->right();
+        }
+        else
+        {
+            result = node;
+            node = node->left();
+        }
+    }
+    return result;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::upper_bound(const Tvalue& value)
 {
-    if(__root)
-        delete __root;
+    // The first node whose value is greater than the given one, or nullptr
+    // if there's none.
+    sg::node_t<Tvalue, Vranked, Vthreaded>* result = nullptr;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __root;
+    while(node != nullptr)
+    {
+        if(less(value, node->__value))
+        {
+            result = node;
+            node = node->left();
+        }
+        else
+        {
+            node = node->right();
+        }
+    }
+    return result;
 }
 
-template <typename Tvalue>
-inline sg::node_t<Tvalue>*
-sg::rbt_t<Tvalue>::search(const Tvalue& value)
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, sg::node_t<Tvalue, Vranked, Vthreaded>*>
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::equal_range(const Tvalue& value)
 {
-    sg::node_t<Tvalue>* node = __root;
+    // Values are unique, so the range holds the equal node or nothing,
+    // and a single descent finds both of its ends: once the equal node
+    // is met, the upper bound is the leftmost node of its right subtree
+    // or, if it has none, the last node the descent went left from.
+    sg::node_t<Tvalue, Vranked, Vthreaded>* upper = nullptr;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __root;
     while(node != nullptr)
     {
-        if(node->value() == value)
-            break;
-        node = value < node->value() ? node->left() : node->right();
+        int order = 0;
+        if constexpr(sg::is_three_way<Tcompare>::value)
+            order = __compare(value, node->__value);
+        else
+            order = less(value, node->__value) ? -1 : (less(node->__value, value) ? 1 : 0);
+
+        if(order < 0)
+        {
+            upper = node;
+            node = node->left();
+        }
+        else if(order > 0)
+        {
+            node = node->right();
+        }
+        else
+        {
+            if(node->right() != nullptr)
+            {
+                upper = node->right();
+                while(upper->left() != nullptr)
+                {
+                    upper = upper->left();
+                }
+            }
+            return {node, upper};
+        }
     }
-    return node;
+    return {upper, upper};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline unsigned int
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::scan(sg::node_t<Tvalue, Vranked, Vthreaded>*& first, sg::node_t<Tvalue, Vranked, Vthreaded>* last, Tvalue* buffer, unsigned int capacity)
+{
+    // Copies the values of up to capacity consecutive nodes, from first up
+    // to (but not including) last, to the buffer and moves first past them;
+    // nullptr stands for the end of the tree. Returns the number of values
+    // copied, zero once the range is over. The caller consumes the values
+    // in a plain loop over the buffer instead of stepping an iterator.
+    // The nodes are walked in order as by successor (even in a threaded
+    // tree, where the next node is a single load away but only known once
+    // the current one arrives), and every right child passed on the way
+    // down a left spine is prefetched: it's read only after the whole left
+    // subtree below it, so its node has time to arrive.
+    unsigned int count = 0;
+    for(; count < capacity && first != last; ++count)
+    {
+        buffer[count] = first->__value;
+        if(first->right() != nullptr)
+        {
+            first = first->right();
+            while(first->left() != nullptr)
+            {
+                sg::prefetch(first->right());
+                first = first->left();
+            }
+        }
+        else
+        {
+            sg::node_t<Tvalue, Vranked, Vthreaded>* parent = first->parent();
+            while(parent != nullptr && parent->right() == first)
+            {
+                first = parent;
+                parent = first->parent();
+            }
+            first = parent;
+        }
+    }
+    return count;
 }
 
-template <typename Tvalue>
-inline sg::node_t<Tvalue>*
-sg::rbt_t<Tvalue>::predecessor(sg::node_t<Tvalue>* node)
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::predecessor(sg::node_t<Tvalue, Vranked, Vthreaded>* node)
 {
+    // A threaded tree keeps the predecessor right in the node.
+    if constexpr(Vthreaded)
+        return node->__previous;
+
     if(node->left() != nullptr)
     {
         // If the node has a left subtree, then its predecessor is the maximal
         // element of its left subtree
-        sg::node_t<Tvalue>* result = node->left();
+        sg::node_t<Tvalue, Vranked, Vthreaded>* result = node->left();
         while(result->right() != nullptr)
         {
             result = result->right();
@@ -189,8 +787,8 @@ sg::rbt_t<Tvalue>::predecessor(sg::node_t<Tvalue>* node)
         // first time the tree branches to the right on the way to the given node.
         // If there's no such place, then the given node is the leftmost tree
         // element, i.e. the element with the minimal value.
-        sg::node_t<Tvalue>* parent = node->parent();
-        sg::node_t<Tvalue>* current = node;
+        sg::node_t<Tvalue, Vranked, Vthreaded>* parent = node->parent();
+        sg::node_t<Tvalue, Vranked, Vthreaded>* current = node;
         while(parent != nullptr)
         {
             if(parent->right() == current)
@@ -202,15 +800,18 @@ sg::rbt_t<Tvalue>::predecessor(sg::node_t<Tvalue>* node)
     }
 }
 
-template <typename Tvalue>
-inline sg::node_t<Tvalue>*
-sg::rbt_t<Tvalue>::successor(sg::node_t<Tvalue>* node)
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::successor(sg::node_t<Tvalue, Vranked, Vthreaded>* node)
 {
+    if constexpr(Vthreaded)
+        return node->__next;
+
     // Same as the predecessor function, but with left and right connections
     // between the tree elements swapped.
     if(node->right() != nullptr)
     {
-        sg::node_t<Tvalue>* result = node->right();
+        sg::node_t<Tvalue, Vranked, Vthreaded>* result = node->right();
         while(result->left() != nullptr)
         {
             result = result->left();
@@ -219,8 +820,8 @@ sg::rbt_t<Tvalue>::successor(sg::node_t<Tvalue>* node)
     }
     else
     {
-        sg::node_t<Tvalue>* current = node;
-        sg::node_t<Tvalue>* parent = node->parent();
+        sg::node_t<Tvalue, Vranked, Vthreaded>* current = node;
+        sg::node_t<Tvalue, Vranked, Vthreaded>* parent = node->parent();
         while(parent != nullptr)
         {
             if(parent->left() == current)
@@ -228,74 +829,310 @@ sg::rbt_t<Tvalue>::successor(sg::node_t<Tvalue>* node)
             current = parent;
             parent = current->parent();
         }
+        return nullptr;
     }
 }
 
-template <typename Tvalue>
-inline sg::color_t
-sg::rbt_t<Tvalue>::color(sg::node_t<Tvalue>* node)
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Ta, typename Tb>
+inline bool
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::less(const Ta& a, const Tb& b)
 {
-    // In this red-black tree implementation NIL nodes are depicted by nullptrs.
-    if(node == nullptr)
-        return sg::color_t::black;
-    return node->color();
+    if constexpr(sg::is_three_way<Tcompare>::value)
+        return __compare(a, b) < 0;
+    else
+        return __compare(a, b);
 }
 
-template <typename Tvalue>
-inline void
-sg::rbt_t<Tvalue>::left_rotate(sg::node_t<Tvalue>* upper)
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Tkey>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::lookup(const Tkey& key)
 {
-    // Only works when upper has a valid (non-NIL) right child (lower).
-    sg::node_t<Tvalue>* lower = upper->right();
-    sg::node_t<Tvalue>* parent = upper->parent();
-    sg::node_t<Tvalue>* middle = lower->left();
-
-    if(parent != nullptr)
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __root;
+    if constexpr(sg::is_three_way<Tcompare>::value)
     {
-        // If not a NIL, but a valid node, then specify its new child
-        // (either left or right depending on how upper was connected to it).
-        if(parent->left() == upper)
-            parent->__left = lower;
-        else
-            parent->__right = lower;
+        // A three-way comparison tells at once whether to go left, right
+        // or to stop.
+        unsigned int depth = 0;
+        while(node != nullptr)
+        {
+            ++depth;
+            Tstats::compared();
+            int order = __compare(key, node->value());
+            if(order == 0)
+                break;
+            node = order < 0 ? node->left() : node->right();
+        }
+        Tstats::searched(depth);
+        return node;
     }
     else
     {
-        // If parent of the upper node was nullptr, then upper was the root
-        // of the tree; since after rotation lower is to replace
-        // upper, we have to also update the variable that stores
-        // the current root of the tree.
-        __root = lower;
+        // With a less-than comparator only one comparison is made per
+        // level: the descent goes left if the key is less than the node,
+        // and right otherwise, remembering the node. The last remembered
+        // node is the greatest one not greater than the key, so it's
+        // the only candidate to be equal to it.
+        sg::node_t<Tvalue, Vranked, Vthreaded>* candidate = nullptr;
+        unsigned int depth = 0;
+        while(node != nullptr)
+        {
+            ++depth;
+            Tstats::compared();
+            if(__compare(key, node->value()))
+            {
+                node = node->left();
+            }
+            else
+            {
+                candidate = node;
+                node = node->right();
+            }
+        }
+        Tstats::searched(depth);
+        if(candidate == nullptr)
+            return nullptr;
+        Tstats::compared();
+        if(!__compare(candidate->value(), key))
+            return candidate;
+        return nullptr;
     }
-
-    lower->__parent = parent;
-    lower->__left = upper;
-
-    upper->__parent = lower;
-    upper->__right = middle;
-
-    // If not a NIL, but a valid node, then also specify its new parent.
-    if(middle != nullptr)
-        middle->__parent = upper;
 }
 
-template <typename Tvalue>
-inline void
-sg::rbt_t<Tvalue>::right_rotate(sg::node_t<Tvalue>* upper)
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Tkey>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::find_place(const Tkey& key, sg::node_t<Tvalue, Vranked, Vthreaded>* start,
+                                                            sg::node_t<Tvalue, Vranked, Vthreaded>*& parent, bool& to_left)
 {
-    // Only works when upper has a valid (non-NIL) left child (lower).
-    sg::node_t<Tvalue>* lower = upper->left();
-    sg::node_t<Tvalue>* parent = upper->parent();
-    sg::node_t<Tvalue>* middle = lower->right();
-
-    if(parent != nullptr)
+    // Descends the subtree of start (the whole tree when it's the root)
+    // as lookup does; returns the node equal to the key if there's one,
+    // otherwise gives the parent of the NIL where the key belongs and
+    // whether it's the left child of that parent.
+    parent = nullptr;
+    to_left = false;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* current = start;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* candidate = nullptr;
+    while(current != nullptr)
     {
-        // If not a NIL, but a valid node, then specify its new child
-        // (either left or right depending on how upper was connected to it).
-        if(parent->left() == upper)
-            parent->__left = lower;
+        parent = current;
+        Tstats::compared();
+        if constexpr(sg::is_three_way<Tcompare>::value)
+        {
+            int order = __compare(key, current->value());
+            if(order == 0)
+                return current;
+            to_left = order < 0;
+        }
         else
-            parent->__right = lower;
+        {
+            to_left = __compare(key, current->value());
+            if(!to_left)
+                candidate = current;
+        }
+        current = to_left ? current->left() : current->right();
+    }
+
+    if constexpr(!sg::is_three_way<Tcompare>::value)
+    {
+        if(candidate == nullptr)
+            return nullptr;
+        Tstats::compared();
+        if(!__compare(candidate->value(), key))
+            return candidate;
+    }
+    return nullptr;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Tkey>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::find_place_near(sg::node_t<Tvalue, Vranked, Vthreaded>* hint, const Tkey& key, sg::node_t<Tvalue, Vranked, Vthreaded>*& parent, bool& to_left)
+{
+    // Same as find_place, but starts at the hint instead of the root:
+    // climbs from the hint to the smallest subtree that must hold the key,
+    // then descends it, which takes O(log d) steps for a key d nodes away
+    // from the hint. Say the key is greater than the hint; the climb passes
+    // over the ancestors the hint is to the right of (they're less than
+    // the hint) and compares the key only with the ones the hint is to
+    // the left of: the first of them greater than the key bounds it from
+    // above, and the last one passed less than the key (or the hint
+    // itself) from below, so the key belongs to the right subtree of
+    // the latter. A key that goes right after a hint with no right child
+    // thus takes two comparisons.
+    if(hint == nullptr)
+        return find_place(key, __root, parent, to_left);
+
+    Tstats::compared();
+    if(less(hint->value(), key))
+    {
+        sg::node_t<Tvalue, Vranked, Vthreaded>* lower = hint;
+        for(sg::node_t<Tvalue, Vranked, Vthreaded>* node = hint; node->parent() != nullptr; node = node->parent())
+        {
+            sg::node_t<Tvalue, Vranked, Vthreaded>* above = node->parent();
+            if(above->right() == node)
+                continue;
+            Tstats::compared();
+            if(less(key, above->value()))
+                break;
+            Tstats::compared();
+            if(!less(above->value(), key))
+                return above;
+            lower = above;
+        }
+
+        if(lower->right() == nullptr)
+        {
+            parent = lower;
+            to_left = false;
+            return nullptr;
+        }
+        return find_place(key, lower->right(), parent, to_left);
+    }
+
+    Tstats::compared();
+    if(less(key, hint->value()))
+    {
+        // Mirror of the above.
+        sg::node_t<Tvalue, Vranked, Vthreaded>* upper = hint;
+        for(sg::node_t<Tvalue, Vranked, Vthreaded>* node = hint; node->parent() != nullptr; node = node->parent())
+        {
+            sg::node_t<Tvalue, Vranked, Vthreaded>* above = node->parent();
+            if(above->left() == node)
+                continue;
+            Tstats::compared();
+            if(less(above->value(), key))
+                break;
+            Tstats::compared();
+            if(!less(key, above->value()))
+                return above;
+            upper = above;
+        }
+
+        if(upper->left() == nullptr)
+        {
+            parent = upper;
+            to_left = true;
+            return nullptr;
+        }
+        return find_place(key, upper->left(), parent, to_left);
+    }
+
+    return hint;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::color_t
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::color(sg::node_t<Tvalue, Vranked, Vthreaded>* node)
+{
+    // In this red-black tree implementation NIL nodes are depicted by nullptrs.
+    if(node == nullptr)
+        return sg::color_t::black;
+    return node->color();
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline unsigned int
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::count(sg::node_t<Tvalue, Vranked, Vthreaded>* node)
+{
+    // Size of the subtree of the node, NILs have none; only makes sense
+    // for ranked trees.
+    if(node == nullptr)
+        return 0;
+    return node->__count;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::update_count(sg::node_t<Tvalue, Vranked, Vthreaded>* node)
+{
+    // Recalculates the size of the subtree of the node out of the sizes
+    // of its children; a no-op unless the tree is ranked.
+    if constexpr(Vranked)
+        node->__count = 1 + count(node->__left) + count(node->__right);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::update_path_counts(sg::node_t<Tvalue, Vranked, Vthreaded>* node)
+{
+    // Recalculates the sizes of the subtrees of the node and of all its
+    // ancestors, after the tree below has changed.
+    if constexpr(Vranked)
+    {
+        while(node != nullptr)
+        {
+            update_count(node);
+            node = node->parent();
+        }
+    }
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::left_rotate(sg::node_t<Tvalue, Vranked, Vthreaded>* upper)
+{
+    // Only works when upper has a valid (non-NIL) right child (lower).
+    Tstats::rotated_left();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* lower = upper->right();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* parent = upper->parent();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* middle = lower->left();
+
+    if(parent != nullptr)
+    {
+        // If not a NIL, but a valid node, then specify its new child
+        // (either left or right depending on how upper was connected to it).
+        if(parent->left() == upper)
+            parent->__left = lower;
+        else
+            parent->__right = lower;
+    }
+    else
+    {
+        // If parent of the upper node was nullptr, then upper was the root
+        // of the tree; since after rotation lower is to replace
+        // upper, we have to also update the variable that stores
+        // the current root of the tree.
+        __root = lower;
+    }
+
+    lower->set_parent(parent);
+    lower->__left = upper;
+
+    upper->set_parent(lower);
+    upper->__right = middle;
+
+    // If not a NIL, but a valid node, then also specify its new parent.
+    if(middle != nullptr)
+        middle->set_parent(upper);
+
+    // Lower now has the same subtree, that upper used to have.
+    if constexpr(Vranked)
+    {
+        lower->__count = upper->__count;
+        update_count(upper);
+    }
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::right_rotate(sg::node_t<Tvalue, Vranked, Vthreaded>* upper)
+{
+    // Only works when upper has a valid (non-NIL) left child (lower).
+    Tstats::rotated_right();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* lower = upper->left();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* parent = upper->parent();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* middle = lower->right();
+
+    if(parent != nullptr)
+    {
+        // If not a NIL, but a valid node, then specify its new child
+        // (either left or right depending on how upper was connected to it).
+        if(parent->left() == upper)
+            parent->__left = lower;
+        else
+            parent->__right = lower;
     }
     else
     {
@@ -306,24 +1143,34 @@ sg::rbt_t<Tvalue>::right_rotate(sg::node_t<Tvalue>* upper)
         __root = lower;
     }
 
-    lower->__parent = parent;
+    lower->set_parent(parent);
     lower->__right = upper;
 
-    upper->__parent = lower;
+    upper->set_parent(lower);
     upper->__left = middle;
 
     // If not a NIL, but a valid node, then also specify its new parent.
     if(middle != nullptr)
-        middle->__parent = upper;
+        middle->set_parent(upper);
+
+    // Lower now has the same subtree, that upper used to have.
+    if constexpr(Vranked)
+    {
+        lower->__count = upper->__count;
+        update_count(upper);
+    }
 }
 
-template <typename Tvalue>
-inline sg::node_t<Tvalue>*
-sg::rbt_t<Tvalue>::minimal()
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::minimal()
 {
+    if constexpr(Vthreaded)
+        return __leftmost;
+
     if(__root != nullptr)
     {
-        sg::node_t<Tvalue>* result = __root;
+        sg::node_t<Tvalue, Vranked, Vthreaded>* result = __root;
         while(result->left() != nullptr)
         {
             result = result->left();
@@ -333,13 +1180,16 @@ sg::rbt_t<Tvalue>::minimal()
     return nullptr;
 }
 
-template <typename Tvalue>
-inline sg::node_t<Tvalue>*
-sg::rbt_t<Tvalue>::maximal()
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::maximal()
 {
+    if constexpr(Vthreaded)
+        return __rightmost;
+
     if(__root != nullptr)
     {
-        sg::node_t<Tvalue>* result = __root;
+        sg::node_t<Tvalue, Vranked, Vthreaded>* result = __root;
         while(result->right() != nullptr)
         {
             result = result->right();
@@ -349,124 +1199,1752 @@ sg::rbt_t<Tvalue>::maximal()
     return nullptr;
 }
 
-template <typename Tvalue>
-inline sg::node_t<Tvalue>*
-sg::rbt_t<Tvalue>::insert(const Tvalue& value)
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool>
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::insert(const Tvalue& value)
 {
-    sg::node_t<Tvalue>* inserted = nullptr;
+    return insert_value(nullptr, value);
+}
 
-    // First, perform a basic binary-search tree insertion.
-    if(__root != nullptr)
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool>
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::insert(Tvalue&& value)
+{
+    return insert_value(nullptr, std::move(value));
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool>
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::insert(sg::node_t<Tvalue, Vranked, Vthreaded>* hint, const Tvalue& value)
+{
+    // Same as insert, but the place for the value is looked for starting
+    // at the hint (as in search with a hint); a value that goes right next
+    // to the hint is inserted in amortized constant time.
+    return insert_value(hint, value);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool>
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::insert(sg::node_t<Tvalue, Vranked, Vthreaded>* hint, Tvalue&& value)
+{
+    return insert_value(hint, std::move(value));
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename... Targs>
+inline std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool>
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::emplace(Targs&&... args)
+{
+    // The value has to be built to be compared, but it's built outside of
+    // a node and moved into one only if it's not in the tree yet; a value
+    // passed as it is goes straight to insert.
+    if constexpr(sizeof...(Targs) == 1 && (std::is_same_v<std::decay_t<Targs>, Tvalue> && ...))
+        return insert(std::forward<Targs>(args)...);
+    else
+        return insert(Tvalue(std::forward<Targs>(args)...));
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename... Targs>
+inline std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool>
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::emplace_hint(sg::node_t<Tvalue, Vranked, Vthreaded>* hint, Targs&&... args)
+{
+    if constexpr(sizeof...(Targs) == 1 && (std::is_same_v<std::decay_t<Targs>, Tvalue> && ...))
+        return insert(hint, std::forward<Targs>(args)...);
+    else
+        return insert(hint, Tvalue(std::forward<Targs>(args)...));
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Tkey, typename... Targs>
+inline std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool>
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::try_emplace(const Tkey& key, Targs&&... args)
+{
+    // Unlike emplace, looks for the place by the key alone, and builds
+    // the value from the arguments right in a new node only if there's
+    // nothing equal to the key yet; the value built must be equal to it.
+    // Large values are thus neither built in vain nor moved.
+    static_assert(sg::is_transparent<Tcompare>::value, "sg::rbt_t::try_emplace requires a transparent comparator");
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* parent = nullptr;
+    bool to_left = false;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* found = find_place(key, __root, parent, to_left);
+    if(found != nullptr)
+        return {found, false};
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* inserted = create_node(std::in_place, std::forward<Targs>(args)...);
+    link_at(inserted, parent, to_left);
+    return {inserted, true};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool>
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::insert(sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>&& handle)
+{
+    // If the tree already has such a value, the handle keeps its node.
+    if(handle.empty())
+        return {nullptr, false};
+    sg::node_t<Tvalue, Vranked, Vthreaded>* parent = nullptr;
+    bool to_left = false;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* found = find_place(handle.__node->value(), __root, parent, to_left);
+    if(found != nullptr)
+        return {found, false};
+
+    // A node from another tree stays where it was allocated, so the
+    // allocator of this tree has to become one of the owners of its storage.
+    allocator().adopt(*handle.__allocator, handle.__node);
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* inserted = handle.__node;
+    handle.__node = nullptr;
+    handle.__allocator.reset();
+
+    link_at(inserted, parent, to_left);
+    return {inserted, true};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::remove(sg::node_t<Tvalue, Vranked, Vthreaded>* node)
+{
+    unlink_node(node);
+    destroy_node(node);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::remove(sg::node_t<Tvalue, Vranked, Vthreaded>* first, sg::node_t<Tvalue, Vranked, Vthreaded>* last)
+{
+    // Removes the nodes in the range [first, last), where nullptr stands
+    // for the end of the tree; returns last.
+    if(first == last)
+        return last;
+
+    if(first == minimal() && last == nullptr)
+    {
+        // Everything is removed, the storage is released all at once.
+        clear();
+        return nullptr;
+    }
+
+    unsigned int count = 0;
+    for(sg::node_t<Tvalue, Vranked, Vthreaded>* node = first; node != last; node = successor(node))
+    {
+        ++count;
+    }
+
+    if(2 * count < __size)
     {
-        sg::node_t<Tvalue>* parent = nullptr;
-        sg::node_t<Tvalue>* current = __root;
-        while(current != nullptr)
+        // The nodes are removed one by one; rebalancing after a removal
+        // takes amortized constant time, and so does the walk to the next
+        // node in order.
+        sg::node_t<Tvalue, Vranked, Vthreaded>* node = first;
+        while(node != last)
         {
-            if(current->value() == value)
-            {
-                parent = nullptr;
-                break;
-            }
-            parent = current;
-            current = value < parent->value() ? parent->left() : parent->right();
+            sg::node_t<Tvalue, Vranked, Vthreaded>* next = successor(node);
+            remove(node);
+            node = next;
         }
-        if(parent != nullptr)
+    }
+    else
+    {
+        // When most of the tree goes away, it's cheaper to destroy the
+        // removed nodes in one pass and to relink the remaining ones
+        // into a new balanced tree. The walk in order goes up the parent
+        // links, so the nodes are only sorted out during the walk, and
+        // destroyed once the remaining ones are relinked.
+        std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*> remaining;
+        std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*> removed;
+        remaining.reserve(__size - count);
+        removed.reserve(count);
+
+        bool inside = false;
+        for(sg::node_t<Tvalue, Vranked, Vthreaded>* node = minimal(); node != nullptr; node = successor(node))
         {
-            inserted = new sg::node_t<Tvalue>{value};
-            inserted->__parent = parent;
-            if(value < parent->value())
-                parent->__left = inserted;
-            else
-                parent->__right = inserted;
-            __size++;
+            if(node == first)
+                inside = true;
+            else if(node == last)
+                inside = false;
+            (inside ? removed : remaining).push_back(node);
+        }
+
+        __size = remaining.size();
+        __root = link_subtree(remaining.data(), __size, 0, red_depth(__size));
+        if(__root != nullptr)
+            __root->set_parent(nullptr);
+        thread_tree();
+
+        for(sg::node_t<Tvalue, Vranked, Vthreaded>* node : removed)
+        {
+            destroy_node(node);
         }
     }
+
+    return last;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::extract(sg::node_t<Tvalue, Vranked, Vthreaded>* node)
+{
+    unlink_node(node);
+    return sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>{node, __allocator};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::join(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& left, const Tvalue& value, sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& right)
+{
+    // Makes the tree hold the values of left, the value and the values of
+    // right, which must come in this order; left and right are emptied,
+    // and their nodes are moved over as they are, in O(log n) time.
+    sg::node_t<Tvalue, Vranked, Vthreaded>* left_last = left.maximal();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* right_first = right.minimal();
+    if((left_last != nullptr && !less(left_last->value(), value)) || (right_first != nullptr && !less(value, right_first->value())))
+        throw std::invalid_argument{"sg::rbt_t::join requires left values less than the value and right values greater"};
+
+    sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> joined{__compare};
+    joined.take_storage(left, left.__size);
+    joined.take_storage(right, right.__size);
+    sg::node_t<Tvalue, Vranked, Vthreaded>* middle = joined.create_node(value);
+
+    if constexpr(Vthreaded)
+    {
+        middle->__previous = left_last;
+        middle->__next = right_first;
+        if(left_last != nullptr)
+            left_last->__next = middle;
+        if(right_first != nullptr)
+            right_first->__previous = middle;
+        joined.__leftmost = left_last != nullptr ? left.__leftmost : middle;
+        joined.__rightmost = right_first != nullptr ? right.__rightmost : middle;
+    }
+
+    unsigned int height = 0;
+    joined.__root = joined.join_subtrees(left.__root, black_height(left.__root), middle,
+                                         right.__root, black_height(right.__root), height);
+    joined.__root->set_color(sg::color_t::black);
+    joined.__size = left.__size + right.__size + 1;
+
+    left.release();
+    right.release();
+    *this = std::move(joined);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline bool
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::split(const Tvalue& value, sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& left, sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& right)
+{
+    // Moves the values less than the given one to left and the greater
+    // ones to right, emptying the tree; returns whether the value was in
+    // the tree (its node is destroyed). Whatever left and right held before
+    // is cleared. The nodes are relinked by O(log n) joins; unless the tree
+    // is ranked, the sizes of the parts also have to be counted, which
+    // takes time linear in the part that looks smaller.
+    sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> lower{__compare};
+    sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> upper{__compare};
+    lower.take_storage(*this, __size);
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* lower_root = nullptr;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* upper_root = nullptr;
+    unsigned int lower_height = 0;
+    unsigned int upper_height = 0;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* found = split_subtree(__root, black_height(__root), value, lower_root, lower_height, upper_root, upper_height);
+
+    unsigned int lower_size = 0;
+    unsigned int upper_size = 0;
+    unsigned int rest_size = __size - (found != nullptr ? 1 : 0);
+    if constexpr(Vranked)
+    {
+        lower_size = count(lower_root);
+        upper_size = count(upper_root);
+    }
+    else if(lower_height <= upper_height)
+    {
+        lower_size = count_subtree(lower_root);
+        upper_size = rest_size - lower_size;
+    }
     else
     {
-        // If the tree was empty
-        inserted = new sg::node_t<Tvalue>{value};
-        __root = inserted;
-        __size++;
+        upper_size = count_subtree(upper_root);
+        lower_size = rest_size - upper_size;
+    }
+
+    // The part of the values greater than the given one gets a share of
+    // the storage of its own, so that the two parts stay independent.
+    // With pool_t, it co-owns every slab of this tree rather than looking
+    // up the slab of each of its nodes; this is deliberate, and the shared
+    // slabs count in the memory_usage of both trees until one lets go.
+    if(__allocator != nullptr)
+        upper.allocator().adopt_storage(*__allocator, upper_size);
+
+    if constexpr(Vthreaded)
+    {
+        // Only the links across the split are cut.
+        sg::node_t<Tvalue, Vranked, Vthreaded>* lower_last = lower_root;
+        while(lower_last != nullptr && lower_last->__right != nullptr)
+            lower_last = lower_last->__right;
+        sg::node_t<Tvalue, Vranked, Vthreaded>* upper_first = upper_root;
+        while(upper_first != nullptr && upper_first->__left != nullptr)
+            upper_first = upper_first->__left;
+
+        if(lower_last != nullptr)
+        {
+            lower_last->__next = nullptr;
+            lower.__leftmost = __leftmost;
+            lower.__rightmost = lower_last;
+        }
+        if(upper_first != nullptr)
+        {
+            upper_first->__previous = nullptr;
+            upper.__leftmost = upper_first;
+            upper.__rightmost = __rightmost;
+        }
+    }
+
+    lower.__root = lower_root;
+    lower.__size = lower_size;
+    if(lower_root != nullptr)
+    {
+        lower_root->set_parent(nullptr);
+        lower_root->set_color(sg::color_t::black);
+    }
+    upper.__root = upper_root;
+    upper.__size = upper_size;
+    if(upper_root != nullptr)
+    {
+        upper_root->set_parent(nullptr);
+        upper_root->set_color(sg::color_t::black);
     }
 
-    // If a new tree element was inserted, check if the red-black properties
-    // have been violated after the insertion and rebalance the tree if they have.
-    if(inserted != nullptr)
-        insert_rebalance(inserted);
+    if(found != nullptr)
+        destroy_node(found);
+    release();
 
-    return inserted;
+    left = std::move(lower);
+    right = std::move(upper);
+    return found != nullptr;
 }
 
-template <typename Tvalue>
-inline unsigned int
-sg::rbt_t<Tvalue>::size()
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::unite(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other)
 {
-    return __size;
+    // Adds the values of other to the tree, emptying other. As with
+    // the other set operations, the nodes of both trees are reused and
+    // relinked by joins and splits, which takes O(m log(n/m + 1)) time
+    // for trees of m and n > m nodes; the work on the left and the right
+    // subtrees is shared between threads. Threaded trees are threaded
+    // anew afterwards, in linear time.
+    if(&other == this)
+        return;
+
+    take_storage(other, other.__size);
+    std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*> dropped;
+    unsigned int height = 0;
+    __root = unite_subtrees(__root, black_height(__root), other.__root, black_height(other.__root), height, dropped,
+                            std::max(1u, std::thread::hardware_concurrency()));
+    finish_set_operation(other, dropped);
 }
 
-template <typename Tvalue>
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
 inline void
-sg::rbt_t<Tvalue>::insert_rebalance(sg::node_t<Tvalue>* inserted)
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::intersect(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other)
 {
-    sg::node_t<Tvalue>* node = inserted;
-    while(color(node->parent()) == sg::color_t::red)
+    // Leaves in the tree only the values that are also in other, emptying
+    // other.
+    if(&other == this)
+        return;
+
+    take_storage(other, other.__size);
+    std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*> dropped;
+    unsigned int height = 0;
+    __root = intersect_subtrees(__root, black_height(__root), other.__root, black_height(other.__root), height, dropped,
+                                std::max(1u, std::thread::hardware_concurrency()));
+    finish_set_operation(other, dropped);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::subtract(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other)
+{
+    // Removes from the tree the values that are in other, emptying other.
+    if(&other == this)
     {
-        sg::node_t<Tvalue>* parent = node->parent();
-        sg::node_t<Tvalue>* grand = parent->parent();
-        if(parent == grand->left())
-        {
-            sg::node_t<Tvalue>* uncle = grand->right();
-            if(color(uncle) == sg::color_t::red)
-            {
-                parent->__color = sg::color_t::black;
-                uncle->__color = sg::color_t::black;
-                grand->__color = sg::color_t::red;
-                node = grand;
-            }
-            else
-            {
-                if(node == parent->right())
-                {
-                    left_rotate(parent);
-                    // Rename the nodes, so that the lower one is named 'node'
-                    // and its parent is 'parent'.
-                    sg::node_t<Tvalue>* temp = node;
-                    node = parent;
-                    parent = temp;
-                }
-                parent->__color = sg::color_t::black;
-                grand->__color = sg::color_t::red;
-                right_rotate(grand);
-            }
-        }
-        else // parent == grand->right()
+        clear();
+        return;
+    }
+
+    take_storage(other, other.__size);
+    std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*> dropped;
+    unsigned int height = 0;
+    __root = subtract_subtrees(__root, black_height(__root), other.__root, black_height(other.__root), height, dropped,
+                               std::max(1u, std::thread::hardware_concurrency()));
+    finish_set_operation(other, dropped);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Titerator>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::assign(Titerator first, Titerator last)
+{
+    using category_t = typename std::iterator_traits<Titerator>::iterator_category;
+
+    // The new tree is built aside with a pool of its own, so that the old
+    // nodes can be released all at once afterwards.
+    sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> built{__compare};
+
+    // Already sorted input is consumed as it is in one more pass, which
+    // only has to count the unique values; anything else is sorted first.
+    bool sorted = true;
+    unsigned int count = 0;
+    if constexpr(std::is_base_of<std::forward_iterator_tag, category_t>::value)
+    {
+        for(Titerator current = first, previous = first; current != last; previous = current++)
         {
-            sg::node_t<Tvalue>* uncle = grand->left();
-            if(color(uncle) == sg::color_t::red)
-            {
-                parent->__color = sg::color_t::black;
-                uncle->__color = sg::color_t::black;
-                grand->__color = sg::color_t::red;
-                node = grand;
-            }
-            else
+            if(current == first || less(*previous, *current))
+                ++count;
+            else if(less(*current, *previous))
             {
-                if(node == parent->left())
-                {
-                    right_rotate(parent);
-                    // Rename the nodes, so that the lower one is named 'node'
-                    // and its parent is 'parent'.
-                    sg::node_t<Tvalue>* temp = node;
-                    node = parent;
-                    parent = temp;
-                }
-                parent->__color = sg::color_t::black;
-                grand->__color = sg::color_t::red;
-                left_rotate(grand);
+                sorted = false;
+                break;
             }
         }
     }
-    __root->__color = sg::color_t::black;
+    else
+    {
+        sorted = false;
+    }
+
+    if(sorted)
+    {
+        built.__root = built.build_subtree(first, last, count, 0, sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::red_depth(count));
+        built.__size = count;
+    }
+    else
+    {
+        std::vector<Tvalue> values(first, last);
+        std::stable_sort(values.begin(), values.end(),
+                  [this](const Tvalue& a, const Tvalue& b) { return less(a, b); });
+        values.erase(std::unique(values.begin(), values.end(),
+                                 [this](const Tvalue& a, const Tvalue& b) { return !less(a, b); }),
+                     values.end());
+
+        count = values.size();
+        auto current = std::make_move_iterator(values.begin());
+        built.__root = built.build_subtree(current, std::make_move_iterator(values.end()), count, 0,
+                                           sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::red_depth(count));
+        built.__size = count;
+    }
+
+    built.thread_tree();
+    *this = std::move(built);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::insert_many(std::vector<Tvalue>& values)
+{
+    // Inserts all the values at once, moving them out of the vector.
+    // Of equal values, the one that comes first in the vector is kept,
+    // as if they were inserted one by one.
+    std::stable_sort(values.begin(), values.end(),
+                     [this](const Tvalue& a, const Tvalue& b) { return less(a, b); });
+    values.erase(std::unique(values.begin(), values.end(),
+                             [this](const Tvalue& a, const Tvalue& b) { return !less(a, b); }),
+                 values.end());
+
+    // An insertion takes about log2(n) steps and a rebuild n of them,
+    // so a few values are better inserted one by one; going in order,
+    // each starts looking for its place at the one before it.
+    if(values.size() * (red_depth(__size) + 1) < __size)
+    {
+        sg::node_t<Tvalue, Vranked, Vthreaded>* hint = nullptr;
+        for(Tvalue& value : values)
+        {
+            hint = insert(hint, std::move(value)).first;
+        }
+        return;
+    }
+
+    std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*> existing;
+    existing.reserve(__size);
+    for(sg::node_t<Tvalue, Vranked, Vthreaded>* node = minimal(); node != nullptr; node = successor(node))
+    {
+        existing.push_back(node);
+    }
+
+    // The values already in the tree are dropped in one merging pass,
+    // so that nodes are only made for the new ones.
+    auto kept = values.begin();
+    auto node = existing.begin();
+    for(auto value = values.begin(); value != values.end(); ++value)
+    {
+        while(node != existing.end() && less((*node)->value(), *value))
+            ++node;
+        if(node == existing.end() || less(*value, (*node)->value()))
+        {
+            // A value that stays where it is isn't moved onto itself.
+            if(kept != value)
+                *kept = std::move(*value);
+            ++kept;
+        }
+    }
+    values.erase(kept, values.end());
+
+    // Nothing is linked into the tree until all the nodes are made,
+    // so a failure leaves the tree as it was.
+    std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*> created;
+    created.reserve(values.size());
+    try
+    {
+        for(Tvalue& value : values)
+        {
+            created.push_back(create_node(std::move(value)));
+        }
+    }
+    catch(...)
+    {
+        for(sg::node_t<Tvalue, Vranked, Vthreaded>* node : created)
+        {
+            destroy_node(node);
+        }
+        throw;
+    }
+
+    std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*> nodes(existing.size() + created.size());
+    std::merge(existing.begin(), existing.end(), created.begin(), created.end(), nodes.begin(),
+               [this](sg::node_t<Tvalue, Vranked, Vthreaded>* a, sg::node_t<Tvalue, Vranked, Vthreaded>* b) { return less(a->value(), b->value()); });
+
+    __size = nodes.size();
+    __root = link_subtree(nodes.data(), __size, 0, red_depth(__size));
+    if(__root != nullptr)
+        __root->set_parent(nullptr);
+    thread_tree();
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline unsigned int
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::rank(const Tvalue& value)
+{
+    // Number of values in the tree less than the given one; every time
+    // the search goes right, the node and its left subtree are counted.
+    static_assert(Vranked, "sg::rbt_t::rank requires a ranked tree");
+
+    unsigned int result = 0;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __root;
+    while(node != nullptr)
+    {
+        if(less(node->value(), value))
+        {
+            result += count(node->left()) + 1;
+            node = node->right();
+        }
+        else
+        {
+            node = node->left();
+        }
+    }
+    return result;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::select(unsigned int index)
+{
+    // The node with the given zero-based position in order, or nullptr
+    // if there are not that many nodes.
+    static_assert(Vranked, "sg::rbt_t::select requires a ranked tree");
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __root;
+    while(node != nullptr)
+    {
+        unsigned int left_count = count(node->left());
+        if(index < left_count)
+        {
+            node = node->left();
+        }
+        else if(index > left_count)
+        {
+            index -= left_count + 1;
+            node = node->right();
+        }
+        else
+        {
+            break;
+        }
+    }
+    return node;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline unsigned int
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::count_range(const Tvalue& low, const Tvalue& high)
+{
+    // Number of values in the range [low, high).
+    static_assert(Vranked, "sg::rbt_t::count_range requires a ranked tree");
+
+    if(!less(low, high))
+        return 0;
+    return rank(high) - rank(low);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::clear()
+{
+    // Nodes have to be visited only if their values need destruction or
+    // if the allocator can't give back all of its storage at once.
+    if(!Tallocator<sg::node_t<Tvalue, Vranked, Vthreaded>>::bulk_release || !std::is_trivially_destructible<Tvalue>::value)
+        destroy_subtree(__root);
+    // Dropping the allocator frees its storage, unless it's still needed
+    // by the handles of extracted nodes or by other trees.
+    __allocator.reset();
+
+    __root = nullptr;
+    __size = 0;
+    __leftmost = nullptr;
+    __rightmost = nullptr;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline unsigned int
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::size()
+{
+    return __size;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline Tcompare
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::comparator()
+{
+    return __compare;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline std::size_t
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::memory_usage()
+{
+    // Bytes taken by the tree itself and by the storage of its nodes,
+    // as reported by the allocator.
+    return sizeof(*this) + (__allocator ? __allocator->memory_usage() : 0);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::tree_stats_t
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::stats()
+{
+    static_assert(Tstats::enabled, "sg::rbt_t::stats requires a counting stats policy");
+
+    // The counters are kept as the tree works; the height takes a walk
+    // over the whole tree, so it's only measured when asked for.
+    sg::tree_stats_t snapshot = Tstats::counters();
+    snapshot.height = subtree_height(__root);
+    snapshot.black_height = black_height(__root);
+    return snapshot;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::insert_rebalance(sg::node_t<Tvalue, Vranked, Vthreaded>* inserted)
+{
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = inserted;
+    while(color(node->parent()) == sg::color_t::red)
+    {
+        Tstats::rebalanced();
+        sg::node_t<Tvalue, Vranked, Vthreaded>* parent = node->parent();
+        sg::node_t<Tvalue, Vranked, Vthreaded>* grand = parent->parent();
+        if(parent == grand->left())
+        {
+            sg::node_t<Tvalue, Vranked, Vthreaded>* uncle = grand->right();
+            if(color(uncle) == sg::color_t::red)
+            {
+                parent->set_color(sg::color_t::black);
+                uncle->set_color(sg::color_t::black);
+                grand->set_color(sg::color_t::red);
+                Tstats::recolored(3);
+                node = grand;
+            }
+            else
+            {
+                if(node == parent->right())
+                {
+                    left_rotate(parent);
+                    // Rename the nodes, so that the lower one is named 'node'
+                    // and its parent is 'parent'.
+                    sg::node_t<Tvalue, Vranked, Vthreaded>* temp = node;
+                    node = parent;
+                    parent = temp;
+                }
+                parent->set_color(sg::color_t::black);
+                grand->set_color(sg::color_t::red);
+                Tstats::recolored(2);
+                right_rotate(grand);
+            }
+        }
+        else // parent == grand->right()
+        {
+            sg::node_t<Tvalue, Vranked, Vthreaded>* uncle = grand->left();
+            if(color(uncle) == sg::color_t::red)
+            {
+                parent->set_color(sg::color_t::black);
+                uncle->set_color(sg::color_t::black);
+                grand->set_color(sg::color_t::red);
+                Tstats::recolored(3);
+                node = grand;
+            }
+            else
+            {
+                if(node == parent->left())
+                {
+                    right_rotate(parent);
+                    // Rename the nodes, so that the lower one is named 'node'
+                    // and its parent is 'parent'.
+                    sg::node_t<Tvalue, Vranked, Vthreaded>* temp = node;
+                    node = parent;
+                    parent = temp;
+                }
+                parent->set_color(sg::color_t::black);
+                grand->set_color(sg::color_t::red);
+                Tstats::recolored(2);
+                left_rotate(grand);
+            }
+        }
+    }
+    if(__root->color() == sg::color_t::red)
+    {
+        __root->set_color(sg::color_t::black);
+        Tstats::recolored(1);
+    }
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::remove_rebalance(sg::node_t<Tvalue, Vranked, Vthreaded>* node, sg::node_t<Tvalue, Vranked, Vthreaded>* parent)
+{
+    // The node (possibly a NIL, hence its parent is given separately) took
+    // the place of a removed black node, so every path through it lacks
+    // one black node; it's considered "doubly black" until fixed.
+    while(node != __root && color(node) == sg::color_t::black)
+    {
+        if(node == parent->left())
+        {
+            // The sibling can't be a NIL, since the paths through it have
+            // at least one black node more than the paths through node.
+            sg::node_t<Tvalue, Vranked, Vthreaded>* sibling = parent->right();
+            if(color(sibling) == sg::color_t::red)
+            {
+                sibling->set_color(sg::color_t::black);
+                parent->set_color(sg::color_t::red);
+                left_rotate(parent);
+                sibling = parent->right();
+            }
+            if(color(sibling->left()) == sg::color_t::black && color(sibling->right()) == sg::color_t::black)
+            {
+                // Move the missing black node one level up.
+                sibling->set_color(sg::color_t::red);
+                node = parent;
+                parent = node->parent();
+            }
+            else
+            {
+                if(color(sibling->right()) == sg::color_t::black)
+                {
+                    sibling->left()->set_color(sg::color_t::black);
+                    sibling->set_color(sg::color_t::red);
+                    right_rotate(sibling);
+                    sibling = parent->right();
+                }
+                sibling->set_color(parent->color());
+                parent->set_color(sg::color_t::black);
+                sibling->right()->set_color(sg::color_t::black);
+                left_rotate(parent);
+                node = __root;
+            }
+        }
+        else // node == parent->right()
+        {
+            sg::node_t<Tvalue, Vranked, Vthreaded>* sibling = parent->left();
+            if(color(sibling) == sg::color_t::red)
+            {
+                sibling->set_color(sg::color_t::black);
+                parent->set_color(sg::color_t::red);
+                right_rotate(parent);
+                sibling = parent->left();
+            }
+            if(color(sibling->left()) == sg::color_t::black && color(sibling->right()) == sg::color_t::black)
+            {
+                sibling->set_color(sg::color_t::red);
+                node = parent;
+                parent = node->parent();
+            }
+            else
+            {
+                if(color(sibling->left()) == sg::color_t::black)
+                {
+                    sibling->right()->set_color(sg::color_t::black);
+                    sibling->set_color(sg::color_t::red);
+                    left_rotate(sibling);
+                    sibling = parent->left();
+                }
+                sibling->set_color(parent->color());
+                parent->set_color(sg::color_t::black);
+                sibling->left()->set_color(sg::color_t::black);
+                right_rotate(parent);
+                node = __root;
+            }
+        }
+    }
+    if(node != nullptr)
+        node->set_color(sg::color_t::black);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Tv>
+inline std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool>
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::insert_value(sg::node_t<Tvalue, Vranked, Vthreaded>* hint, Tv&& value)
+{
+    // First, find the place for the value as in a basic binary-search tree,
+    // starting at the hint if there's one. The node is created only after
+    // that, so a duplicate costs neither an allocation nor a copy, and
+    // a value passed as an rvalue is moved into the node.
+    sg::node_t<Tvalue, Vranked, Vthreaded>* parent = nullptr;
+    bool to_left = false;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* found = find_place_near(hint, value, parent, to_left);
+    if(found != nullptr)
+        return {found, false};
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* inserted = create_node(std::forward<Tv>(value));
+    link_at(inserted, parent, to_left);
+    return {inserted, true};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::link_at(sg::node_t<Tvalue, Vranked, Vthreaded>* node,
+                                                         sg::node_t<Tvalue, Vranked, Vthreaded>* parent, bool to_left)
+{
+    // Attaches a new red leaf at the place found by find_place.
+    node->set_parent(parent);
+    if(parent == nullptr)
+        __root = node;
+    else if(to_left)
+        parent->__left = node;
+    else
+        parent->__right = node;
+    __size++;
+
+    // A new left child comes in order right before its parent, and
+    // a new right child comes right after it.
+    if constexpr(Vthreaded)
+    {
+        if(parent == nullptr)
+        {
+            node->__previous = nullptr;
+            node->__next = nullptr;
+        }
+        else if(to_left)
+        {
+            node->__previous = parent->__previous;
+            node->__next = parent;
+        }
+        else
+        {
+            node->__previous = parent;
+            node->__next = parent->__next;
+        }
+
+        if(node->__previous != nullptr)
+            node->__previous->__next = node;
+        else
+            __leftmost = node;
+        if(node->__next != nullptr)
+            node->__next->__previous = node;
+        else
+            __rightmost = node;
+    }
+
+    // Every ancestor of the new node gets one more node in its subtree.
+    update_path_counts(parent);
+
+    // Check if the red-black properties have been violated after the
+    // insertion and rebalance the tree if they have.
+    insert_rebalance(node);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::transplant(sg::node_t<Tvalue, Vranked, Vthreaded>* replaced, sg::node_t<Tvalue, Vranked, Vthreaded>* node)
+{
+    // Puts node (possibly a NIL) in place of the replaced one in the
+    // eyes of its parent; the children of both nodes are left untouched.
+    sg::node_t<Tvalue, Vranked, Vthreaded>* parent = replaced->parent();
+    if(parent == nullptr)
+        __root = node;
+    else if(parent->left() == replaced)
+        parent->__left = node;
+    else
+        parent->__right = node;
+
+    if(node != nullptr)
+        node->set_parent(parent);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::unlink_node(sg::node_t<Tvalue, Vranked, Vthreaded>* node)
+{
+    // Detaches the node from the tree without destroying it. If the node
+    // has two children, its successor is moved to its place (instead of
+    // swapping their values), so that all the other nodes stay valid.
+    sg::color_t removed_color = node->color();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* moved = nullptr;        // Node taking the place of the removed one
+    sg::node_t<Tvalue, Vranked, Vthreaded>* moved_parent = nullptr;
+
+    if(node->left() == nullptr)
+    {
+        moved = node->right();
+        moved_parent = node->parent();
+        transplant(node, node->right());
+    }
+    else if(node->right() == nullptr)
+    {
+        moved = node->left();
+        moved_parent = node->parent();
+        transplant(node, node->left());
+    }
+    else
+    {
+        sg::node_t<Tvalue, Vranked, Vthreaded>* next = node->right();
+        while(next->left() != nullptr)
+        {
+            next = next->left();
+        }
+
+        removed_color = next->color();
+        moved = next->right();
+        if(next->parent() == node)
+        {
+            moved_parent = next;
+        }
+        else
+        {
+            moved_parent = next->parent();
+            transplant(next, next->right());
+            next->__right = node->right();
+            next->__right->set_parent(next);
+        }
+        transplant(node, next);
+        next->__left = node->left();
+        next->__left->set_parent(next);
+        next->set_color(node->color());
+    }
+    __size--;
+
+    // The nodes whose subtrees have lost a node are exactly the ones
+    // on the way from the parent of the moved node up to the root.
+    update_path_counts(moved_parent);
+
+    // Only removal of a black node breaks the red-black properties.
+    if(removed_color == sg::color_t::black)
+        remove_rebalance(moved, moved_parent);
+
+    if constexpr(Vthreaded)
+    {
+        if(node->__previous != nullptr)
+            node->__previous->__next = node->__next;
+        else
+            __leftmost = node->__next;
+        if(node->__next != nullptr)
+            node->__next->__previous = node->__previous;
+        else
+            __rightmost = node->__previous;
+        node->__previous = nullptr;
+        node->__next = nullptr;
+    }
+
+    node->set_parent(nullptr);
+    node->__left = nullptr;
+    node->__right = nullptr;
+    node->set_color(sg::color_t::red);
+    update_count(node);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::thread_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>* node, sg::node_t<Tvalue, Vranked, Vthreaded>*& previous)
+{
+    // Links the nodes of the subtree in order, one after another, starting
+    // after the given previous node; previous becomes the last node.
+    if(node == nullptr)
+        return;
+    thread_subtree(node->__left, previous);
+    node->__previous = previous;
+    if(previous != nullptr)
+        previous->__next = node;
+    else
+        __leftmost = node;
+    previous = node;
+    thread_subtree(node->__right, previous);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::thread_tree()
+{
+    // Restores the links between consecutive nodes after the tree has been
+    // assembled by other means than insertions; a no-op if not threaded.
+    if constexpr(Vthreaded)
+    {
+        __leftmost = nullptr;
+        __rightmost = nullptr;
+        sg::node_t<Tvalue, Vranked, Vthreaded>* previous = nullptr;
+        thread_subtree(__root, previous);
+        if(previous != nullptr)
+            previous->__next = nullptr;
+        __rightmost = previous;
+    }
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline Tallocator<sg::node_t<Tvalue, Vranked, Vthreaded>>&
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::allocator()
+{
+    if(__allocator == nullptr)
+        __allocator = std::make_shared<Tallocator<sg::node_t<Tvalue, Vranked, Vthreaded>>>();
+    return *__allocator;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::create_node(const Tvalue& value)
+{
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = allocator().allocate();
+    try
+    {
+        new (node) sg::node_t<Tvalue, Vranked, Vthreaded>{value};
+    }
+    catch(...)
+    {
+        __allocator->deallocate(node);
+        throw;
+    }
+    return node;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::create_node(Tvalue&& value)
+{
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = allocator().allocate();
+    try
+    {
+        new (node) sg::node_t<Tvalue, Vranked, Vthreaded>{std::move(value)};
+    }
+    catch(...)
+    {
+        __allocator->deallocate(node);
+        throw;
+    }
+    return node;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename... Targs>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::create_node(std::in_place_t, Targs&&... args)
+{
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = allocator().allocate();
+    try
+    {
+        new (node) sg::node_t<Tvalue, Vranked, Vthreaded>{std::in_place, std::forward<Targs>(args)...};
+    }
+    catch(...)
+    {
+        __allocator->deallocate(node);
+        throw;
+    }
+    return node;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::destroy_node(sg::node_t<Tvalue, Vranked, Vthreaded>* node)
+{
+    node->~node_t();
+    __allocator->deallocate(node);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline unsigned int
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::destroy_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>* node)
+{
+    // The height of a red-black tree is logarithmic in the number of its
+    // nodes, so the recursion depth stays small even for huge trees.
+    // Returns the number of nodes destroyed.
+    if(node == nullptr)
+        return 0;
+    unsigned int count = destroy_subtree(node->__left);
+    count += destroy_subtree(node->__right);
+    destroy_node(node);
+    return count + 1;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline unsigned int
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::count_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>* node)
+{
+    if(node == nullptr)
+        return 0;
+    return count_subtree(node->__left) + count_subtree(node->__right) + 1;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline unsigned int
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::subtree_height(sg::node_t<Tvalue, Vranked, Vthreaded>* node)
+{
+    // Number of nodes on the longest way down from the node to a NIL.
+    if(node == nullptr)
+        return 0;
+    return std::max(subtree_height(node->__left), subtree_height(node->__right)) + 1;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline unsigned int
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::black_height(sg::node_t<Tvalue, Vranked, Vthreaded>* node)
+{
+    // Number of black nodes on every way down from the node to a NIL,
+    // counting the node itself; any way will do, the leftmost is taken.
+    unsigned int height = 0;
+    for(; node != nullptr; node = node->__left)
+    {
+        if(node->color() == sg::color_t::black)
+            ++height;
+    }
+    return height;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::take_storage(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other, std::size_t count)
+{
+    // Makes the allocator of the tree able to free count nodes
+    // of the other tree, which are about to move over.
+    if(other.__allocator == nullptr || other.__allocator == __allocator)
+        return;
+    if(__allocator == nullptr)
+        __allocator = other.__allocator;
+    else
+        __allocator->adopt_storage(*other.__allocator, count);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::release()
+{
+    // Empties the tree without destroying the nodes, which have been
+    // moved to another tree.
+    __root = nullptr;
+    clear();
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::join_subtrees(sg::node_t<Tvalue, Vranked, Vthreaded>* left, unsigned int left_height, sg::node_t<Tvalue, Vranked, Vthreaded>* middle,
+                 sg::node_t<Tvalue, Vranked, Vthreaded>* right, unsigned int right_height, unsigned int& height)
+{
+    // Links left, middle and right (in this order) into a single subtree
+    // and gives its black height; the root of the result may be red.
+    // Only the nodes along one side of the higher subtree, down to
+    // the height of the lower one, are visited.
+    if(color(left) == sg::color_t::red)
+    {
+        left->set_color(sg::color_t::black);
+        ++left_height;
+    }
+    if(color(right) == sg::color_t::red)
+    {
+        right->set_color(sg::color_t::black);
+        ++right_height;
+    }
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* root = nullptr;
+    if(left_height > right_height)
+    {
+        root = join_right(left, left_height, middle, right, right_height);
+        height = left_height;
+    }
+    else if(left_height < right_height)
+    {
+        root = join_left(left, left_height, middle, right, right_height);
+        height = right_height;
+    }
+    else
+    {
+        // Both roots are black, so the middle node can be red.
+        middle->__left = left;
+        middle->__right = right;
+        if(left != nullptr)
+            left->set_parent(middle);
+        if(right != nullptr)
+            right->set_parent(middle);
+        middle->set_color(sg::color_t::red);
+        update_count(middle);
+        root = middle;
+        height = left_height;
+    }
+    root->set_parent(nullptr);
+    return root;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::join_right(sg::node_t<Tvalue, Vranked, Vthreaded>* node, unsigned int height, sg::node_t<Tvalue, Vranked, Vthreaded>* middle, sg::node_t<Tvalue, Vranked, Vthreaded>* right, unsigned int right_height)
+{
+    // Descends the right side of the subtree of the node down to a black
+    // node with the black height of right, puts the red middle node in its
+    // place with the two of them as its children, and fixes two red nodes
+    // in a row on the way back up, the way insert_rebalance would.
+    if(height == right_height && color(node) == sg::color_t::black)
+    {
+        middle->__left = node;
+        middle->__right = right;
+        if(node != nullptr)
+            node->set_parent(middle);
+        if(right != nullptr)
+            right->set_parent(middle);
+        middle->set_color(sg::color_t::red);
+        update_count(middle);
+        return middle;
+    }
+
+    unsigned int child_height = node->color() == sg::color_t::black ? height - 1 : height;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* child = join_right(node->__right, child_height, middle, right, right_height);
+    node->__right = child;
+    child->set_parent(node);
+    update_count(node);
+
+    if(node->color() == sg::color_t::black && child->color() == sg::color_t::red && color(child->__right) == sg::color_t::red)
+    {
+        child->__right->set_color(sg::color_t::black);
+        node = left_rotate_subtree(node);
+    }
+    return node;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::join_left(sg::node_t<Tvalue, Vranked, Vthreaded>* left, unsigned int left_height, sg::node_t<Tvalue, Vranked, Vthreaded>* middle, sg::node_t<Tvalue, Vranked, Vthreaded>* node, unsigned int height)
+{
+    // Mirror of join_right.
+    if(height == left_height && color(node) == sg::color_t::black)
+    {
+        middle->__left = left;
+        middle->__right = node;
+        if(left != nullptr)
+            left->set_parent(middle);
+        if(node != nullptr)
+            node->set_parent(middle);
+        middle->set_color(sg::color_t::red);
+        update_count(middle);
+        return middle;
+    }
+
+    unsigned int child_height = node->color() == sg::color_t::black ? height - 1 : height;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* child = join_left(left, left_height, middle, node->__left, child_height);
+    node->__left = child;
+    child->set_parent(node);
+    update_count(node);
+
+    if(node->color() == sg::color_t::black && child->color() == sg::color_t::red && color(child->__left) == sg::color_t::red)
+    {
+        child->__left->set_color(sg::color_t::black);
+        node = right_rotate_subtree(node);
+    }
+    return node;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::join_pair(sg::node_t<Tvalue, Vranked, Vthreaded>* left, unsigned int left_height, sg::node_t<Tvalue, Vranked, Vthreaded>* right, unsigned int right_height, unsigned int& height)
+{
+    // Same as join_subtrees, but without a middle node: the last node
+    // of left takes its place.
+    if(left == nullptr)
+    {
+        height = right_height;
+        return right;
+    }
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* rest = nullptr;
+    unsigned int rest_height = 0;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* last = split_last(left, left_height, rest, rest_height);
+    return join_subtrees(rest, rest_height, last, right, right_height, height);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::split_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>* node, unsigned int height, const Tvalue& value, sg::node_t<Tvalue, Vranked, Vthreaded>*& left, unsigned int& left_height,
+                 sg::node_t<Tvalue, Vranked, Vthreaded>*& right, unsigned int& right_height)
+{
+    // Splits the subtree into the nodes less than the value and the nodes
+    // greater than it; returns the node equal to the value, unlinked,
+    // if there's one. The subtrees hanging off the way down to the value
+    // are joined back together on the way up.
+    if(node == nullptr)
+    {
+        left = nullptr;
+        right = nullptr;
+        left_height = 0;
+        right_height = 0;
+        return nullptr;
+    }
+
+    unsigned int child_height = node->color() == sg::color_t::black ? height - 1 : height;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node_left = node->__left;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node_right = node->__right;
+    node->__left = nullptr;
+    node->__right = nullptr;
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* found = nullptr;
+    if(less(value, node->value()))
+    {
+        sg::node_t<Tvalue, Vranked, Vthreaded>* inner = nullptr;
+        unsigned int inner_height = 0;
+        found = split_subtree(node_left, child_height, value, left, left_height, inner, inner_height);
+        right = join_subtrees(inner, inner_height, node, node_right, child_height, right_height);
+    }
+    else if(less(node->value(), value))
+    {
+        sg::node_t<Tvalue, Vranked, Vthreaded>* inner = nullptr;
+        unsigned int inner_height = 0;
+        found = split_subtree(node_right, child_height, value, inner, inner_height, right, right_height);
+        left = join_subtrees(node_left, child_height, node, inner, inner_height, left_height);
+    }
+    else
+    {
+        left = node_left;
+        right = node_right;
+        left_height = child_height;
+        right_height = child_height;
+        node->set_parent(nullptr);
+        update_count(node);
+        found = node;
+    }
+    return found;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::split_last(sg::node_t<Tvalue, Vranked, Vthreaded>* node, unsigned int height, sg::node_t<Tvalue, Vranked, Vthreaded>*& rest, unsigned int& rest_height)
+{
+    // Unlinks the last node of the subtree and returns it; rest gets
+    // the remaining nodes.
+    unsigned int child_height = node->color() == sg::color_t::black ? height - 1 : height;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node_left = node->__left;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node_right = node->__right;
+    node->__left = nullptr;
+    node->__right = nullptr;
+
+    if(node_right == nullptr)
+    {
+        rest = node_left;
+        rest_height = child_height;
+        if(rest != nullptr)
+            rest->set_parent(nullptr);
+        node->set_parent(nullptr);
+        update_count(node);
+        return node;
+    }
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* inner = nullptr;
+    unsigned int inner_height = 0;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* last = split_last(node_right, child_height, inner, inner_height);
+    rest = join_subtrees(node_left, child_height, node, inner, inner_height, rest_height);
+    return last;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::left_rotate_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>* upper)
+{
+    // Same as left_rotate, except that the parent of upper is left
+    // to the caller, who gets the new top of the subtree.
+    sg::node_t<Tvalue, Vranked, Vthreaded>* lower = upper->__right;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* middle = lower->__left;
+
+    upper->__right = middle;
+    if(middle != nullptr)
+        middle->set_parent(upper);
+    lower->__left = upper;
+    lower->set_parent(upper->parent());
+    upper->set_parent(lower);
+
+    if constexpr(Vranked)
+    {
+        lower->__count = upper->__count;
+        update_count(upper);
+    }
+    return lower;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::right_rotate_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>* upper)
+{
+    // Mirror of left_rotate_subtree.
+    sg::node_t<Tvalue, Vranked, Vthreaded>* lower = upper->__left;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* middle = lower->__right;
+
+    upper->__left = middle;
+    if(middle != nullptr)
+        middle->set_parent(upper);
+    lower->__right = upper;
+    lower->set_parent(upper->parent());
+    upper->set_parent(lower);
+
+    if constexpr(Vranked)
+    {
+        lower->__count = upper->__count;
+        update_count(upper);
+    }
+    return lower;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::unite_subtrees(sg::node_t<Tvalue, Vranked, Vthreaded>* first, unsigned int first_height, sg::node_t<Tvalue, Vranked, Vthreaded>* second, unsigned int second_height,
+                  unsigned int& height, std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*>& dropped, unsigned int workers)
+{
+    // The second subtree is split by the root of the first one, the parts
+    // less than the root are united on one side, and the greater ones
+    // on the other, and the results are joined with the root between them.
+    // The nodes of the second subtree equal to some node of the first one
+    // are dropped.
+    if(first == nullptr || second == nullptr)
+    {
+        height = first == nullptr ? second_height : first_height;
+        return first == nullptr ? second : first;
+    }
+
+    unsigned int child_height = first->color() == sg::color_t::black ? first_height - 1 : first_height;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* first_left = first->__left;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* first_right = first->__right;
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* second_left = nullptr;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* second_right = nullptr;
+    unsigned int second_left_height = 0;
+    unsigned int second_right_height = 0;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* found = split_subtree(second, second_height, first->value(), second_left, second_left_height, second_right, second_right_height);
+    if(found != nullptr)
+        dropped.push_back(found);
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* left = nullptr;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* right = nullptr;
+    unsigned int left_height = 0;
+    unsigned int right_height = 0;
+    std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*> right_dropped;
+    run_both(workers, std::max(first_height, second_height),
+             [&](unsigned int share)
+             {
+                 left = unite_subtrees(first_left, child_height, second_left, second_left_height, left_height, dropped, share);
+             },
+             [&](unsigned int share)
+             {
+                 right = unite_subtrees(first_right, child_height, second_right, second_right_height, right_height, right_dropped, share);
+             });
+    dropped.insert(dropped.end(), right_dropped.begin(), right_dropped.end());
+
+    return join_subtrees(left, left_height, first, right, right_height, height);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::intersect_subtrees(sg::node_t<Tvalue, Vranked, Vthreaded>* first, unsigned int first_height, sg::node_t<Tvalue, Vranked, Vthreaded>* second, unsigned int second_height,
+                      unsigned int& height, std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*>& dropped, unsigned int workers)
+{
+    // Same scheme as unite_subtrees; the root of the first subtree is kept
+    // only if the second one has its value too, and whatever is left over
+    // when either side runs out is dropped whole.
+    if(first == nullptr || second == nullptr)
+    {
+        if(first != nullptr)
+            dropped.push_back(first);
+        if(second != nullptr)
+            dropped.push_back(second);
+        height = 0;
+        return nullptr;
+    }
+
+    unsigned int child_height = first->color() == sg::color_t::black ? first_height - 1 : first_height;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* first_left = first->__left;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* first_right = first->__right;
+    first->__left = nullptr;
+    first->__right = nullptr;
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* second_left = nullptr;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* second_right = nullptr;
+    unsigned int second_left_height = 0;
+    unsigned int second_right_height = 0;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* found = split_subtree(second, second_height, first->value(), second_left, second_left_height, second_right, second_right_height);
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* left = nullptr;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* right = nullptr;
+    unsigned int left_height = 0;
+    unsigned int right_height = 0;
+    std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*> right_dropped;
+    run_both(workers, std::max(first_height, second_height),
+             [&](unsigned int share)
+             {
+                 left = intersect_subtrees(first_left, child_height, second_left, second_left_height, left_height, dropped, share);
+             },
+             [&](unsigned int share)
+             {
+                 right = intersect_subtrees(first_right, child_height, second_right, second_right_height, right_height, right_dropped, share);
+             });
+    dropped.insert(dropped.end(), right_dropped.begin(), right_dropped.end());
+
+    if(found != nullptr)
+    {
+        dropped.push_back(found);
+        return join_subtrees(left, left_height, first, right, right_height, height);
+    }
+    dropped.push_back(first);
+    return join_pair(left, left_height, right, right_height, height);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::subtract_subtrees(sg::node_t<Tvalue, Vranked, Vthreaded>* first, unsigned int first_height, sg::node_t<Tvalue, Vranked, Vthreaded>* second, unsigned int second_height,
+                     unsigned int& height, std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*>& dropped, unsigned int workers)
+{
+    // Here the first subtree is split by the root of the second one,
+    // which is dropped along with its equal in the first subtree.
+    if(first == nullptr || second == nullptr)
+    {
+        if(second != nullptr)
+            dropped.push_back(second);
+        height = first_height;
+        return first;
+    }
+
+    unsigned int child_height = second->color() == sg::color_t::black ? second_height - 1 : second_height;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* second_left = second->__left;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* second_right = second->__right;
+    second->__left = nullptr;
+    second->__right = nullptr;
+    dropped.push_back(second);
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* first_left = nullptr;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* first_right = nullptr;
+    unsigned int first_left_height = 0;
+    unsigned int first_right_height = 0;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* found = split_subtree(first, first_height, second->value(), first_left, first_left_height, first_right, first_right_height);
+    if(found != nullptr)
+        dropped.push_back(found);
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* left = nullptr;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* right = nullptr;
+    unsigned int left_height = 0;
+    unsigned int right_height = 0;
+    std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*> right_dropped;
+    run_both(workers, std::max(first_height, second_height),
+             [&](unsigned int share)
+             {
+                 left = subtract_subtrees(first_left, first_left_height, second_left, child_height, left_height, dropped, share);
+             },
+             [&](unsigned int share)
+             {
+                 right = subtract_subtrees(first_right, first_right_height, second_right, child_height, right_height, right_dropped, share);
+             });
+    dropped.insert(dropped.end(), right_dropped.begin(), right_dropped.end());
+
+    return join_pair(left, left_height, right, right_height, height);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::finish_set_operation(sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other, std::vector<sg::node_t<Tvalue, Vranked, Vthreaded>*>& dropped)
+{
+    // Both trees have given their nodes to the result, and the storage
+    // of other is already shared; the nodes left out are destroyed here,
+    // after all the threads are done, since allocators aren't thread-safe.
+    if(__root != nullptr)
+    {
+        __root->set_parent(nullptr);
+        __root->set_color(sg::color_t::black);
+    }
+
+    unsigned int size = __size + other.__size;
+    other.release();
+    for(sg::node_t<Tvalue, Vranked, Vthreaded>* node : dropped)
+    {
+        size -= destroy_subtree(node);
+    }
+    __size = size;
+    thread_tree();
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Tleft, typename Tright>
+inline void
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::run_both(unsigned int workers, unsigned int height, Tleft left, Tright right)
+{
+    // Runs the two halves of a set operation, the right one on a thread
+    // of its own if there are workers to spare and the subtrees are high
+    // enough for a thread to pay off; each half gets its share of workers.
+    // Comparators must not throw here, as an exception can't leave
+    // a thread.
+    constexpr unsigned int parallel_height = 10;
+
+    if(workers < 2 || height < parallel_height)
+    {
+        left(1u);
+        right(1u);
+        return;
+    }
+
+    // If no thread can be started, the right half runs here after all,
+    // rather than leaving the subtrees half done.
+    std::thread worker;
+    try
+    {
+        worker = std::thread{[&]() { right(workers / 2); }};
+    }
+    catch(const std::system_error&)
+    {
+        left(1u);
+        right(1u);
+        return;
+    }
+
+    // The thread is joined even if the left half throws, as destroying
+    // a thread still running ends the process.
+    struct joiner_t
+    {
+        ~joiner_t() { thread.join(); }
+        std::thread& thread;
+    } joiner{worker};
+    left(workers - workers / 2);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::clone_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>* source, sg::node_t<Tvalue, Vranked, Vthreaded>* parent)
+{
+    if(source == nullptr)
+        return nullptr;
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = create_node(source->__value);
+    node->set_parent(parent);
+    node->set_color(source->color());
+    try
+    {
+        node->__left = clone_subtree(source->__left, node);
+        node->__right = clone_subtree(source->__right, node);
+        update_count(node);
+    }
+    catch(...)
+    {
+        // Whatever has been cloned so far is already linked to the node.
+        destroy_subtree(node);
+        throw;
+    }
+    return node;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::link_subtree(sg::node_t<Tvalue, Vranked, Vthreaded>** nodes, unsigned int count,
+                                            unsigned int depth, unsigned int red_depth)
+{
+    // Same as build_subtree, but links together already existing nodes
+    // given in order; the parent of the returned node is left to the caller.
+    if(count == 0)
+        return nullptr;
+
+    unsigned int left_count = (count - 1) / 2;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = nodes[left_count];
+
+    node->__left = link_subtree(nodes, left_count, depth + 1, red_depth);
+    if(node->__left != nullptr)
+        node->__left->set_parent(node);
+    node->__right = link_subtree(nodes + left_count + 1, count - 1 - left_count, depth + 1, red_depth);
+    if(node->__right != nullptr)
+        node->__right->set_parent(node);
+    node->set_color((depth == red_depth && depth > 0) ? sg::color_t::red : sg::color_t::black);
+    update_count(node);
+
+    return node;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline unsigned int
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::red_depth(unsigned int count)
+{
+    // Splitting a sorted sequence in halves gives a tree whose levels are
+    // all full except for the deepest one, which is at depth floor(log2(count)).
+    // Coloring only the nodes of that level red keeps the number of black
+    // nodes the same on every path, and never puts a red node under a red one.
+    unsigned int depth = 0;
+    while(count > 1)
+    {
+        count /= 2;
+        ++depth;
+    }
+    return depth;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Titerator>
+inline sg::node_t<Tvalue, Vranked, Vthreaded>*
+sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::build_subtree(Titerator& current, Titerator last, unsigned int count,
+                                             unsigned int depth, unsigned int red_depth)
+{
+    // Builds a subtree of count nodes out of the next count unique values
+    // of a sorted sequence; the values are consumed in order, so the left
+    // subtree is built before its parent node.
+    if(count == 0)
+        return nullptr;
+
+    unsigned int left_count = (count - 1) / 2;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* left = build_subtree(current, last, left_count, depth + 1, red_depth);
+
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = nullptr;
+    try
+    {
+        node = create_node(*current);
+    }
+    catch(...)
+    {
+        destroy_subtree(left);
+        throw;
+    }
+    node->__left = left;
+    if(left != nullptr)
+        left->set_parent(node);
+    // The root is black even if it's the only node of the tree.
+    node->set_color((depth == red_depth && depth > 0) ? sg::color_t::red : sg::color_t::black);
+
+    // Skip the duplicates of the value just taken; they are compared with
+    // the node, as the value behind a move iterator is left moved from.
+    ++current;
+    while(current != last && !less(node->__value, *current))
+        ++current;
+
+    try
+    {
+        node->__right = build_subtree(current, last, count - 1 - left_count, depth + 1, red_depth);
+    }
+    catch(...)
+    {
+        destroy_subtree(node);
+        throw;
+    }
+    if(node->__right != nullptr)
+        node->__right->set_parent(node);
+    update_count(node);
+
+    return node;
 }
 
 
@@ -0,0 +1,714 @@
+#ifndef __RCU_HPP__
+#define __RCU_HPP__
+
+#include "compare.hpp"
+#include "rbt.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace sg
+{
+    // Node of a tree that readers walk without locks. Readers follow only
+    // the child links, which are atomic; the value never changes once
+    // the node is published, and the parent and the color are seen only
+    // by the writer.
+    template <typename Tvalue>
+    struct rcu_node_t
+    {
+        explicit rcu_node_t(const Tvalue& value);
+
+        const Tvalue __value;
+        std::atomic<sg::rcu_node_t<Tvalue>*> __left{nullptr};
+        std::atomic<sg::rcu_node_t<Tvalue>*> __right{nullptr};
+        sg::rcu_node_t<Tvalue>* __parent = nullptr;
+        sg::color_t __color = sg::color_t::red;
+    };
+
+    // Red-black tree set for one writer and many readers, where readers
+    // never take locks (read-copy-update). Changes are published so that
+    // every path a reader may be on stays a correct search path:
+    //
+    // - a new node is linked in only when it's complete;
+    // - a rotation copies the upper node instead of moving it, links the
+    //   copy under the lower node and only then puts the lower node in
+    //   place of the upper one, so a reader on the old upper node still
+    //   reaches every value below it;
+    // - an erased node with two children is replaced by a copy of its
+    //   successor, and the old successor is unlinked only after readers
+    //   that may still look for it below the erased node have left.
+    //
+    // Nodes taken out of the tree are freed only when no reader can still
+    // see them: a reader announces the epoch it started in, and a node
+    // retired in an epoch is freed once every active reader started later.
+    //
+    // Writers are serialized by a mutex of the set; reads go through
+    // a reader, which every reading thread registers once.
+    template <typename Tvalue, typename Tcompare = std::less<Tvalue>>
+    class rcu_set
+    {
+    protected:
+        // Epoch announced by a reader, 0 when the reader is outside
+        // of a search; aligned so that readers don't share cache lines.
+        struct alignas(64) slot_t
+        {
+            std::atomic<std::uint64_t> epoch{0};
+        };
+
+    public:
+        rcu_set() = default;
+        explicit rcu_set(const Tcompare& compare);
+        rcu_set(const sg::rcu_set<Tvalue, Tcompare>& obj) = delete;
+        ~rcu_set();
+
+        sg::rcu_set<Tvalue, Tcompare>& operator=(const sg::rcu_set<Tvalue, Tcompare>& obj) = delete;
+
+        // Registration of a reading thread; a reader must not outlive
+        // its set and must be used by one thread at a time.
+        class reader
+        {
+        public:
+            explicit reader(sg::rcu_set<Tvalue, Tcompare>& set);
+            reader(const sg::rcu_set<Tvalue, Tcompare>::reader& obj) = delete;
+            ~reader();
+
+            sg::rcu_set<Tvalue, Tcompare>::reader& operator=(const sg::rcu_set<Tvalue, Tcompare>::reader& obj) = delete;
+
+            bool contains(const Tvalue& value);
+            template <typename Tkey, typename Tc = Tcompare, typename = typename Tc::is_transparent>
+            bool contains(const Tkey& key);
+
+        private:
+            template <typename Tkey> bool lookup(const Tkey& key);
+
+            sg::rcu_set<Tvalue, Tcompare>* __set;
+            sg::rcu_set<Tvalue, Tcompare>::slot_t* __slot;
+        };
+
+        bool insert(const Tvalue& value);
+        bool erase(const Tvalue& value);
+        void clear();
+
+        unsigned int size();
+
+    protected:
+        using node_t = sg::rcu_node_t<Tvalue>;
+
+        // Retired nodes are freed in batches, so that the readers are
+        // scanned once per batch rather than once per node.
+        static constexpr std::size_t reclaim_threshold = 64;
+
+        static node_t* left(node_t* node);
+        static node_t* right(node_t* node);
+        static sg::color_t color(node_t* node);
+        template <typename Ta, typename Tb> bool less(const Ta& a, const Tb& b) const;
+        node_t* root();
+        void replace_child(node_t* parent, node_t* old_child, node_t* new_child);
+        node_t* left_rotate(node_t* upper);
+        node_t* right_rotate(node_t* upper);
+        void insert_rebalance(node_t* inserted);
+        void remove_rebalance(node_t* node, node_t* parent);
+        void retire(node_t* node);
+        void reclaim();
+        void synchronize();
+        static void destroy_subtree(node_t* node);
+
+    private:
+        std::atomic<node_t*> __root{nullptr};
+        std::atomic<unsigned int> __size{0};
+        Tcompare __compare;
+
+        std::mutex __writer_mutex;
+        std::atomic<std::uint64_t> __epoch{1};
+        std::vector<std::pair<node_t*, std::uint64_t>> __retired; // Nodes with the epochs they were retired in
+
+        std::mutex __readers_mutex; // Guards the list of readers, not the reads
+        std::vector<std::unique_ptr<slot_t>> __slots;
+    };
+
+} // namespace sg
+
+
+template <typename Tvalue>
+inline
+sg::rcu_node_t<Tvalue>::rcu_node_t(const Tvalue& value) :
+    __value{value}
+{
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::rcu_set<Tvalue, Tcompare>::rcu_set(const Tcompare& compare) :
+    __compare{compare}
+{
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::rcu_set<Tvalue, Tcompare>::~rcu_set()
+{
+    // No reader may be active any more, everything is freed at once.
+    node_t* current = root();
+    if(current != nullptr)
+        destroy_subtree(current);
+    for(auto& [node, epoch] : __retired)
+    {
+        delete node;
+    }
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::rcu_set<Tvalue, Tcompare>::reader::reader(sg::rcu_set<Tvalue, Tcompare>& set) :
+    __set{&set}
+{
+    std::lock_guard<std::mutex> lock{set.__readers_mutex};
+    set.__slots.push_back(std::make_unique<slot_t>());
+    __slot = set.__slots.back().get();
+}
+
+template <typename Tvalue, typename Tcompare>
+inline
+sg::rcu_set<Tvalue, Tcompare>::reader::~reader()
+{
+    std::lock_guard<std::mutex> lock{__set->__readers_mutex};
+    auto found = std::find_if(__set->__slots.begin(), __set->__slots.end(),
+                              [this](const std::unique_ptr<slot_t>& slot) { return slot.get() == __slot; });
+    __set->__slots.erase(found);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline bool
+sg::rcu_set<Tvalue, Tcompare>::reader::contains(const Tvalue& value)
+{
+    return lookup(value);
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Tkey, typename Tc, typename>
+inline bool
+sg::rcu_set<Tvalue, Tcompare>::reader::contains(const Tkey& key)
+{
+    return lookup(key);
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Tkey>
+inline bool
+sg::rcu_set<Tvalue, Tcompare>::reader::lookup(const Tkey& key)
+{
+    // The epoch is announced before the root is read, the fence pairs with
+    // the one of the writer: a writer that doesn't see the announcement
+    // has unlinked its nodes before the reader could reach them.
+    __slot->epoch.store(__set->__epoch.load());
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    node_t* current = __set->__root.load(std::memory_order_acquire);
+
+    // One comparison per level, as in rbt_t; a value copied by
+    // a rotation or by an erasure may be met twice on the way, which
+    // doesn't change the result.
+    node_t* candidate = nullptr;
+    while(current != nullptr)
+    {
+        if(__set->less(key, current->__value))
+        {
+            current = current->__left.load(std::memory_order_acquire);
+        }
+        else
+        {
+            candidate = current;
+            current = current->__right.load(std::memory_order_acquire);
+        }
+    }
+    bool found = candidate != nullptr && !__set->less(candidate->__value, key);
+
+    __slot->epoch.store(0, std::memory_order_release);
+    return found;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline bool
+sg::rcu_set<Tvalue, Tcompare>::insert(const Tvalue& value)
+{
+    // Returns whether the value was added, i.e. it wasn't in the set.
+    std::lock_guard<std::mutex> lock{__writer_mutex};
+
+    node_t* parent = nullptr;
+    bool to_left = false;
+    for(node_t* current = root(); current != nullptr;)
+    {
+        parent = current;
+        if(less(value, current->__value))
+        {
+            to_left = true;
+            current = left(current);
+        }
+        else if(less(current->__value, value))
+        {
+            to_left = false;
+            current = right(current);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // The node is complete before it's published.
+    node_t* inserted = new node_t{value};
+    inserted->__parent = parent;
+    if(parent == nullptr)
+        __root.store(inserted, std::memory_order_release);
+    else if(to_left)
+        parent->__left.store(inserted, std::memory_order_release);
+    else
+        parent->__right.store(inserted, std::memory_order_release);
+    ++__size;
+
+    insert_rebalance(inserted);
+    reclaim();
+    return true;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline bool
+sg::rcu_set<Tvalue, Tcompare>::erase(const Tvalue& value)
+{
+    // Returns whether the value was removed, i.e. it was in the set.
+    std::lock_guard<std::mutex> lock{__writer_mutex};
+
+    node_t* erased = root();
+    while(erased != nullptr)
+    {
+        if(less(value, erased->__value))
+            erased = left(erased);
+        else if(less(erased->__value, value))
+            erased = right(erased);
+        else
+            break;
+    }
+    if(erased == nullptr)
+        return false;
+
+    sg::color_t removed_color = erased->__color;
+    node_t* child = nullptr;   // The node that takes the place of the removed one
+    node_t* parent = nullptr;  // and its parent
+
+    if(left(erased) == nullptr || right(erased) == nullptr)
+    {
+        child = left(erased) != nullptr ? left(erased) : right(erased);
+        parent = erased->__parent;
+        if(child != nullptr)
+            child->__parent = parent;
+        replace_child(parent, erased, child);
+    }
+    else
+    {
+        // The successor can't be moved up, since readers below the erased
+        // node may be on their way to it; its copy takes the place of
+        // the erased node instead.
+        node_t* successor = right(erased);
+        while(left(successor) != nullptr)
+            successor = left(successor);
+
+        removed_color = successor->__color;
+        child = right(successor);
+
+        node_t* copy = new node_t{successor->__value};
+        copy->__color = erased->__color;
+        copy->__parent = erased->__parent;
+        copy->__left.store(left(erased), std::memory_order_relaxed);
+        left(erased)->__parent = copy;
+
+        if(successor == right(erased))
+        {
+            // The old successor is right below the erased node, both are
+            // replaced by the copy at once.
+            copy->__right.store(child, std::memory_order_relaxed);
+            if(child != nullptr)
+                child->__parent = copy;
+            parent = copy;
+            replace_child(erased->__parent, erased, copy);
+            retire(successor);
+        }
+        else
+        {
+            copy->__right.store(right(erased), std::memory_order_relaxed);
+            right(erased)->__parent = copy;
+            replace_child(erased->__parent, erased, copy);
+
+            // Readers that passed the erased node before the copy was
+            // published may still be looking for the successor below it;
+            // it's unlinked once they're done.
+            synchronize();
+            parent = successor->__parent;
+            if(child != nullptr)
+                child->__parent = parent;
+            parent->__left.store(child, std::memory_order_release);
+            retire(successor);
+        }
+    }
+    retire(erased);
+    --__size;
+
+    if(removed_color == sg::color_t::black)
+        remove_rebalance(child, parent);
+    reclaim();
+    return true;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::rcu_set<Tvalue, Tcompare>::clear()
+{
+    std::lock_guard<std::mutex> lock{__writer_mutex};
+
+    node_t* old_root = __root.exchange(nullptr);
+    __size = 0;
+    synchronize();
+    if(old_root != nullptr)
+        destroy_subtree(old_root);
+    reclaim();
+}
+
+template <typename Tvalue, typename Tcompare>
+inline unsigned int
+sg::rcu_set<Tvalue, Tcompare>::size()
+{
+    return __size.load(std::memory_order_relaxed);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::rcu_set<Tvalue, Tcompare>::node_t*
+sg::rcu_set<Tvalue, Tcompare>::left(node_t* node)
+{
+    // Links are changed only by the writer, which reads them without
+    // ordering; so do the other helpers of the writer.
+    return node->__left.load(std::memory_order_relaxed);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::rcu_set<Tvalue, Tcompare>::node_t*
+sg::rcu_set<Tvalue, Tcompare>::right(node_t* node)
+{
+    return node->__right.load(std::memory_order_relaxed);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline sg::color_t
+sg::rcu_set<Tvalue, Tcompare>::color(node_t* node)
+{
+    // NILs are black.
+    if(node == nullptr)
+        return sg::color_t::black;
+    return node->__color;
+}
+
+template <typename Tvalue, typename Tcompare>
+template <typename Ta, typename Tb>
+inline bool
+sg::rcu_set<Tvalue, Tcompare>::less(const Ta& a, const Tb& b) const
+{
+    if constexpr(sg::is_three_way<Tcompare>::value)
+        return __compare(a, b) < 0;
+    else
+        return __compare(a, b);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::rcu_set<Tvalue, Tcompare>::node_t*
+sg::rcu_set<Tvalue, Tcompare>::root()
+{
+    return __root.load(std::memory_order_relaxed);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::rcu_set<Tvalue, Tcompare>::replace_child(node_t* parent, node_t* old_child, node_t* new_child)
+{
+    // Publishes the new child (complete by now) in place of the old one.
+    if(parent == nullptr)
+        __root.store(new_child, std::memory_order_release);
+    else if(left(parent) == old_child)
+        parent->__left.store(new_child, std::memory_order_release);
+    else
+        parent->__right.store(new_child, std::memory_order_release);
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::rcu_set<Tvalue, Tcompare>::node_t*
+sg::rcu_set<Tvalue, Tcompare>::left_rotate(node_t* upper)
+{
+    // Same as rbt_t::left_rotate, except that the upper node is replaced
+    // by its copy, which is returned; the old upper node keeps its links,
+    // so a reader on it still finds everything below it.
+    node_t* lower = right(upper);
+    node_t* parent = upper->__parent;
+    node_t* middle = left(lower);
+
+    node_t* copy = new node_t{upper->__value};
+    copy->__color = upper->__color;
+    copy->__parent = lower;
+    copy->__left.store(left(upper), std::memory_order_relaxed);
+    copy->__right.store(middle, std::memory_order_relaxed);
+    if(left(upper) != nullptr)
+        left(upper)->__parent = copy;
+    if(middle != nullptr)
+        middle->__parent = copy;
+
+    lower->__left.store(copy, std::memory_order_release);
+    replace_child(parent, upper, lower);
+    lower->__parent = parent;
+
+    retire(upper);
+    return copy;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline typename sg::rcu_set<Tvalue, Tcompare>::node_t*
+sg::rcu_set<Tvalue, Tcompare>::right_rotate(node_t* upper)
+{
+    // Mirror of left_rotate.
+    node_t* lower = left(upper);
+    node_t* parent = upper->__parent;
+    node_t* middle = right(lower);
+
+    node_t* copy = new node_t{upper->__value};
+    copy->__color = upper->__color;
+    copy->__parent = lower;
+    copy->__right.store(right(upper), std::memory_order_relaxed);
+    copy->__left.store(middle, std::memory_order_relaxed);
+    if(right(upper) != nullptr)
+        right(upper)->__parent = copy;
+    if(middle != nullptr)
+        middle->__parent = copy;
+
+    lower->__right.store(copy, std::memory_order_release);
+    replace_child(parent, upper, lower);
+    lower->__parent = parent;
+
+    retire(upper);
+    return copy;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::rcu_set<Tvalue, Tcompare>::insert_rebalance(node_t* inserted)
+{
+    // Same as rbt_t::insert_rebalance; a rotated node is replaced by
+    // its copy, which the variables are switched to.
+    node_t* node = inserted;
+    while(color(node->__parent) == sg::color_t::red)
+    {
+        node_t* parent = node->__parent;
+        node_t* grand = parent->__parent;
+        if(parent == left(grand))
+        {
+            node_t* uncle = right(grand);
+            if(color(uncle) == sg::color_t::red)
+            {
+                parent->__color = sg::color_t::black;
+                uncle->__color = sg::color_t::black;
+                grand->__color = sg::color_t::red;
+                node = grand;
+            }
+            else
+            {
+                if(node == right(parent))
+                {
+                    // The lower node becomes the parent, and the copy
+                    // of the parent becomes the node.
+                    node_t* copy = left_rotate(parent);
+                    parent = node;
+                    node = copy;
+                }
+                parent->__color = sg::color_t::black;
+                grand->__color = sg::color_t::red;
+                right_rotate(grand);
+            }
+        }
+        else // parent == right(grand)
+        {
+            node_t* uncle = left(grand);
+            if(color(uncle) == sg::color_t::red)
+            {
+                parent->__color = sg::color_t::black;
+                uncle->__color = sg::color_t::black;
+                grand->__color = sg::color_t::red;
+                node = grand;
+            }
+            else
+            {
+                if(node == left(parent))
+                {
+                    node_t* copy = right_rotate(parent);
+                    parent = node;
+                    node = copy;
+                }
+                parent->__color = sg::color_t::black;
+                grand->__color = sg::color_t::red;
+                left_rotate(grand);
+            }
+        }
+    }
+    root()->__color = sg::color_t::black;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::rcu_set<Tvalue, Tcompare>::remove_rebalance(node_t* node, node_t* parent)
+{
+    // Same as rbt_t::remove_rebalance; a rotated parent is replaced by
+    // its copy, which the variable is switched to.
+    while(node != root() && color(node) == sg::color_t::black)
+    {
+        if(node == left(parent))
+        {
+            node_t* sibling = right(parent);
+            if(color(sibling) == sg::color_t::red)
+            {
+                sibling->__color = sg::color_t::black;
+                parent->__color = sg::color_t::red;
+                parent = left_rotate(parent);
+                sibling = right(parent);
+            }
+            if(color(left(sibling)) == sg::color_t::black && color(right(sibling)) == sg::color_t::black)
+            {
+                sibling->__color = sg::color_t::red;
+                node = parent;
+                parent = node->__parent;
+            }
+            else
+            {
+                if(color(right(sibling)) == sg::color_t::black)
+                {
+                    left(sibling)->__color = sg::color_t::black;
+                    sibling->__color = sg::color_t::red;
+                    right_rotate(sibling);
+                    sibling = right(parent);
+                }
+                sibling->__color = parent->__color;
+                parent->__color = sg::color_t::black;
+                right(sibling)->__color = sg::color_t::black;
+                left_rotate(parent);
+                node = root();
+            }
+        }
+        else // node == right(parent)
+        {
+            node_t* sibling = left(parent);
+            if(color(sibling) == sg::color_t::red)
+            {
+                sibling->__color = sg::color_t::black;
+                parent->__color = sg::color_t::red;
+                parent = right_rotate(parent);
+                sibling = left(parent);
+            }
+            if(color(left(sibling)) == sg::color_t::black && color(right(sibling)) == sg::color_t::black)
+            {
+                sibling->__color = sg::color_t::red;
+                node = parent;
+                parent = node->__parent;
+            }
+            else
+            {
+                if(color(left(sibling)) == sg::color_t::black)
+                {
+                    right(sibling)->__color = sg::color_t::black;
+                    sibling->__color = sg::color_t::red;
+                    left_rotate(sibling);
+                    sibling = left(parent);
+                }
+                sibling->__color = parent->__color;
+                parent->__color = sg::color_t::black;
+                left(sibling)->__color = sg::color_t::black;
+                right_rotate(parent);
+                node = root();
+            }
+        }
+    }
+    if(node != nullptr)
+        node->__color = sg::color_t::black;
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::rcu_set<Tvalue, Tcompare>::retire(node_t* node)
+{
+    __retired.emplace_back(node, __epoch.load());
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::rcu_set<Tvalue, Tcompare>::reclaim()
+{
+    // Opens a new epoch and frees the nodes retired before the epoch of
+    // the oldest active reader; a reader that announces a later epoch
+    // is too late to reach them.
+    __epoch.fetch_add(1);
+    if(__retired.size() < reclaim_threshold)
+        return;
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::uint64_t oldest = UINT64_MAX;
+    {
+        std::lock_guard<std::mutex> lock{__readers_mutex};
+        for(std::unique_ptr<slot_t>& slot : __slots)
+        {
+            std::uint64_t epoch = slot->epoch.load();
+            if(epoch != 0)
+                oldest = std::min(oldest, epoch);
+        }
+    }
+
+    auto kept = std::partition(__retired.begin(), __retired.end(),
+                               [oldest](const std::pair<node_t*, std::uint64_t>& retired) { return retired.second >= oldest; });
+    for(auto iter = kept; iter != __retired.end(); ++iter)
+    {
+        delete iter->first;
+    }
+    __retired.erase(kept, __retired.end());
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::rcu_set<Tvalue, Tcompare>::synchronize()
+{
+    // Waits until every reader that started before now is done
+    // (a grace period); new readers don't delay it.
+    std::uint64_t epoch = __epoch.fetch_add(1) + 1;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    std::lock_guard<std::mutex> lock{__readers_mutex};
+    for(std::unique_ptr<slot_t>& slot : __slots)
+    {
+        while(true)
+        {
+            std::uint64_t announced = slot->epoch.load();
+            if(announced == 0 || announced >= epoch)
+                break;
+            std::this_thread::yield();
+        }
+    }
+}
+
+template <typename Tvalue, typename Tcompare>
+inline void
+sg::rcu_set<Tvalue, Tcompare>::destroy_subtree(node_t* node)
+{
+    // Only used when no reader can see the nodes any more.
+    if(left(node) != nullptr)
+        destroy_subtree(left(node));
+    if(right(node) != nullptr)
+        destroy_subtree(right(node));
+    delete node;
+}
+
+#endif // __RCU_HPP__
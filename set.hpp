@@ -1,110 +1,263 @@
 #ifndef __SET_HPP__
 #define __SET_HPP__
 
+#include "frozen.hpp"
 #include "rbt.hpp"
 
+#include <cstddef>
 #include <exception>
+#include <functional>
+#include <memory>
 #include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace sg
 {
-    template <typename Tvalue>
+    template <typename Tvalue, typename Tcompare = std::less<Tvalue>, template <typename> class Tallocator = sg::pool_t,
+              bool Vranked = false, bool Vthreaded = false, typename Tstats = sg::no_stats_t>
     class set
     {
     public:
+        using node_type = sg::node_handle_t<Tvalue, Tallocator, Vranked, Vthreaded>;
+
         set();
-        set(const sg::set<Tvalue>& obj);
-        set(sg::set<Tvalue>&& obj);
+        explicit set(const Tcompare& compare);
+        template <typename Titerator> set(Titerator first, Titerator last);
+        set(const sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& obj);
+        set(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>&& obj);
         ~set();
 
+        sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& operator=(const sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& obj);
+        sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& operator=(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>&& obj);
+
         class iterator
         {
         public:
             iterator() = delete;
-            iterator(const sg::set<Tvalue>::iterator& iter) = default;
-            iterator(sg::set<Tvalue>::iterator&& iter) = default;
+            iterator(const sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator& iter) = default;
+            iterator(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator&& iter) = default;
+
+            sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator& operator=(const sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator& iter) = default;
+            sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator& operator=(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator&& iter) = default;
 
             const Tvalue& operator->();
             const Tvalue& operator*();
-            sg::set<Tvalue>::iterator operator++();
-            sg::set<Tvalue>::iterator operator++(int);
-            sg::set<Tvalue>::iterator operator--();
-            sg::set<Tvalue>::iterator operator--(int);
-            bool operator==(sg::set<Tvalue>::iterator iter);
-            bool operator!=(sg::set<Tvalue>::iterator iter);
+            sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator operator++();
+            sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator operator++(int);
+            sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator operator--();
+            sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator operator--(int);
+            bool operator==(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator iter);
+            bool operator!=(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator iter);
 
         private:
-            iterator(sg::node_t<Tvalue>* node, sg::rbt_t<Tvalue>* tree);
-            sg::node_t<Tvalue>* __node = nullptr;
-            sg::rbt_t<Tvalue>* __tree = nullptr;
-            friend class sg::set<Tvalue>;
+            iterator(sg::node_t<Tvalue, Vranked, Vthreaded>* node, sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>* tree);
+            sg::node_t<Tvalue, Vranked, Vthreaded>* __node = nullptr;
+            sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>* __tree = nullptr;
+            friend class sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>;
         };
 
-        sg::set<Tvalue>::iterator search(const Tvalue& value);
-        sg::set<Tvalue>::iterator insert(const Tvalue& value);
-        sg::set<Tvalue>::iterator begin();
-        sg::set<Tvalue>::iterator end();
+        sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator search(const Tvalue& value);
+        sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator search(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator hint, const Tvalue& value);
+        template <typename Tkey, typename Tc = Tcompare, typename = typename Tc::is_transparent>
+        sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator search(const Tkey& key);
+        template <typename Titerator, typename Toutput> Toutput search_many(Titerator first, Titerator last, Toutput out);
+        sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator lower_bound(const Tvalue& value);
+        sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator upper_bound(const Tvalue& value);
+        std::pair<sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator, sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator> equal_range(const Tvalue& value);
+        unsigned int scan(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator& first, sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator last, Tvalue* buffer, unsigned int capacity);
+        std::pair<sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator, bool> insert(const Tvalue& value);
+        std::pair<sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator, bool> insert(Tvalue&& value);
+        sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator insert(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator hint, const Tvalue& value);
+        sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator insert(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator hint, Tvalue&& value);
+        std::pair<sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator, bool> insert(node_type&& handle);
+        template <typename... Targs> std::pair<sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator, bool> emplace(Targs&&... args);
+        template <typename... Targs> sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator emplace_hint(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator hint, Targs&&... args);
+        sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator erase(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator position);
+        sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator erase(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator first,
+                                                    sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator last);
+        unsigned int erase(const Tvalue& value);
+        node_type extract(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator position);
+        node_type extract(const Tvalue& value);
+        template <typename Titerator> void assign(Titerator first, Titerator last);
+        void begin_bulk();
+        void end_bulk();
+        void bulk_insert(const Tvalue& value);
+        void bulk_insert(Tvalue&& value);
+        void unite(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other);
+        void intersect(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other);
+        void subtract(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other);
+        unsigned int rank(const Tvalue& value);
+        sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator select(unsigned int index);
+        unsigned int count_range(const Tvalue& low, const Tvalue& high);
+        sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator begin();
+        sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator end();
+        sg::frozen_set<Tvalue, Tcompare> freeze();
+        void save(const std::string& path);
 
         unsigned int size();
+        std::size_t memory_usage();
+        sg::tree_stats_t stats();
 
     private:
-        sg::rbt_t<Tvalue>* __tree;
+        std::pair<sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator, bool> remember_last(std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool> result);
+        void flush();
+
+        sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>* __tree;
+        // The node of the last insertion, where the next one starts looking
+        // for its place; nullptr when unknown.
+        sg::node_t<Tvalue, Vranked, Vthreaded>* __last = nullptr;
+        // Whether the last insertion landed right under (or, after the
+        // rebalancing, right above) the node of the one before it; only then
+        // does the next one start at the last node, as values coming in a
+        // random order would pay for the climb without getting anything.
+        bool __in_order = false;
+        // The values inserted in bulk mode and not yet put into the tree;
+        // nullptr out of bulk mode.
+        std::unique_ptr<std::vector<Tvalue>> __pending;
     };
 
+    // Set operations; the sets are taken by value, so that passing them
+    // as rvalues lets the result reuse their nodes, while passing them
+    // as lvalues copies them and leaves them intact. The work is
+    // O(m log(n/m + 1)) for sets of n and m <= n values only when both
+    // are moved in; an lvalue costs an O(n + m) deep copy first.
+    template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+    sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> set_union(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> first, sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> second);
+    template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+    sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> set_intersection(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> first, sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> second);
+    template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+    sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> set_difference(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> first, sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> second);
+
 } // namespace sg
 
 
-template <typename Tvalue>
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::set()
+{
+    __tree = new sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::set(const Tcompare& compare)
+{
+    __tree = new sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>{compare};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Titerator>
 inline
-sg::set<Tvalue>::set()
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::set(Titerator first, Titerator last)
 {
-    __tree = new sg::rbt_t<Tvalue>;
+    __tree = new sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>;
+    try
+    {
+        __tree->assign(first, last);
+    }
+    catch(...)
+    {
+        delete __tree;
+        throw;
+    }
 }
 
-template <typename Tvalue>
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
 inline
-sg::set<Tvalue>::set(const sg::set<Tvalue>& obj)
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::set(const sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& obj)
 {
-    __tree = new sg::rbt_t<Tvalue>{*(obj.__tree)};
+    __tree = new sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>{*(obj.__tree)};
+    try
+    {
+        if(obj.__pending)
+            __pending = std::make_unique<std::vector<Tvalue>>(*(obj.__pending));
+    }
+    catch(...)
+    {
+        delete __tree;
+        throw;
+    }
 }
 
-template <typename Tvalue>
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
 inline
-sg::set<Tvalue>::set(sg::set<Tvalue>&& obj)
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::set(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>&& obj)
 {
     __tree = obj.__tree;
+    __last = obj.__last;
+    __in_order = obj.__in_order;
+    __pending = std::move(obj.__pending);
     obj.__tree = nullptr;
+    obj.__last = nullptr;
 }
 
-template <typename Tvalue>
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
 inline
-sg::set<Tvalue>::~set()
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::~set()
 {
     if(__tree)
         delete __tree;
 }
 
-template <typename Tvalue>
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>&
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::operator=(const sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& obj)
+{
+    if(this != &obj)
+    {
+        // A moved-from set has no tree of its own anymore.
+        __last = nullptr;
+        if(__tree)
+            *__tree = *(obj.__tree);
+        else
+            __tree = new sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>{*(obj.__tree)};
+        __pending = obj.__pending ? std::make_unique<std::vector<Tvalue>>(*(obj.__pending)) : nullptr;
+    }
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>&
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::operator=(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>&& obj)
+{
+    if(this != &obj)
+    {
+        if(__tree)
+            delete __tree;
+        __tree = obj.__tree;
+        __last = obj.__last;
+        __in_order = obj.__in_order;
+        __pending = std::move(obj.__pending);
+        obj.__tree = nullptr;
+        obj.__last = nullptr;
+    }
+    return *this;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
 inline const Tvalue&
-sg::set<Tvalue>::iterator::operator->()
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator::operator->()
 {
     if(__node == nullptr)
         throw std::runtime_error{"sg::set::iterator out of range"};
     return __node->value();
 }
 
-template <typename Tvalue>
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
 inline const Tvalue&
-sg::set<Tvalue>::iterator::operator*()
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator::operator*()
 {
     if(__node == nullptr)
         throw std::runtime_error{"sg::set::iterator out of range"};
     return __node->value();
 }
 
-template <typename Tvalue>
-inline typename sg::set<Tvalue>::iterator
-sg::set<Tvalue>::iterator::operator++() // Prefix
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator::operator++() // Prefix
 {
     if(__node == nullptr)
         throw std::runtime_error{"sg::set::iterator out of range"};
@@ -112,20 +265,20 @@ sg::set<Tvalue>::iterator::operator++() // Prefix
     return *this;
 }
 
-template <typename Tvalue>
-inline typename sg::set<Tvalue>::iterator
-sg::set<Tvalue>::iterator::operator++(int) // Postfix
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator::operator++(int) // Postfix
 {
     if(__node == nullptr)
         throw std::runtime_error{"sg::set::iterator out of range"};
-    typename sg::set<Tvalue>::iterator old = *this;
+    typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator old = *this;
     __node = __tree->successor(__node);
     return old;
 }
 
-template <typename Tvalue>
-inline typename sg::set<Tvalue>::iterator
-sg::set<Tvalue>::iterator::operator--() // Prefix
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator::operator--() // Prefix
 {
     // Decrementing end iterator should give the maximal element
     if(__node == nullptr)
@@ -135,11 +288,11 @@ sg::set<Tvalue>::iterator::operator--() // Prefix
     return *this;
 }
 
-template <typename Tvalue>
-inline typename sg::set<Tvalue>::iterator
-sg::set<Tvalue>::iterator::operator--(int) // Postfix
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator::operator--(int) // Postfix
 {
-    typename sg::set<Tvalue>::iterator old = this;
+    typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator old = *this;
     // Decrementing end iterator should give the maximal element
     if(__node == nullptr)
         __node = __tree->maximal();
@@ -148,64 +301,507 @@ sg::set<Tvalue>::iterator::operator--(int) // Postfix
     return old;
 }
 
-template <typename Tvalue>
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
 inline bool
-sg::set<Tvalue>::iterator::operator==(sg::set<Tvalue>::iterator iter)
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator::operator==(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator iter)
 {
     return __node == iter.__node;
 }
 
-template <typename Tvalue>
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
 inline bool
-sg::set<Tvalue>::iterator::operator!=(sg::set<Tvalue>::iterator iter)
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator::operator!=(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator iter)
 {
     return __node != iter.__node;
 }
 
-template <typename Tvalue>
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
 inline
-sg::set<Tvalue>::iterator::iterator(sg::node_t<Tvalue>* node, sg::rbt_t<Tvalue>* tree) :
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator::iterator(sg::node_t<Tvalue, Vranked, Vthreaded>* node, sg::rbt_t<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>* tree) :
     __node{node},
     __tree{tree}
 {
 }
 
-template <typename Tvalue>
-inline typename sg::set<Tvalue>::iterator
-sg::set<Tvalue>::search(const Tvalue& value)
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::search(const Tvalue& value)
+{
+    flush();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __tree->search(value);
+    return sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{node, __tree};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::search(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator hint, const Tvalue& value)
+{
+    // The closer the value is to the hint, the faster it's found; the end
+    // iterator stands for the last value, as in insert.
+    flush();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* start = hint.__node != nullptr ? hint.__node : __tree->maximal();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __tree->search(start, value);
+    return sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{node, __tree};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Tkey, typename Tc, typename>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::search(const Tkey& key)
+{
+    // Heterogeneous lookup, only available with a transparent comparator.
+    flush();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __tree->search(key);
+    return sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{node, __tree};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Titerator, typename Toutput>
+inline Toutput
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::search_many(Titerator first, Titerator last, Toutput out)
+{
+    // Writes an iterator for every key in [first, last) to out, end iterator
+    // if the key isn't found; many keys at once are searched for faster
+    // than one by one.
+    flush();
+    constexpr unsigned int batch_size = 256;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* nodes[batch_size];
+
+    while(first != last)
+    {
+        Titerator batch_first = first;
+        unsigned int count = 0;
+        for(; count < batch_size && first != last; ++count)
+        {
+            ++first;
+        }
+
+        __tree->search_many(batch_first, first, nodes);
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            *out = sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{nodes[i], __tree};
+            ++out;
+        }
+    }
+    return out;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::lower_bound(const Tvalue& value)
+{
+    flush();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __tree->lower_bound(value);
+    return sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{node, __tree};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::upper_bound(const Tvalue& value)
+{
+    flush();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __tree->upper_bound(value);
+    return sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{node, __tree};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline std::pair<typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator, typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator>
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::equal_range(const Tvalue& value)
+{
+    flush();
+    std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, sg::node_t<Tvalue, Vranked, Vthreaded>*> range = __tree->equal_range(value);
+    return {sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{range.first, __tree}, sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{range.second, __tree}};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline unsigned int
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::scan(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator& first, sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator last, Tvalue* buffer, unsigned int capacity)
+{
+    // Copies up to capacity consecutive values of [first, last) to
+    // the buffer and moves first past them; returns how many were copied,
+    // zero once the range is over. All the values in [a, b) are thus read
+    // batch by batch, starting with first = lower_bound(a) and last =
+    // lower_bound(b).
+    flush();
+    return __tree->scan(first.__node, last.__node, buffer, capacity);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline std::pair<typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator, bool>
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::insert(const Tvalue& value)
+{
+    return emplace(value);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline std::pair<typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator, bool>
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::insert(Tvalue&& value)
+{
+    return emplace(std::move(value));
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::insert(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator hint, const Tvalue& value)
+{
+    return emplace_hint(hint, value);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::insert(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator hint, Tvalue&& value)
+{
+    return emplace_hint(hint, std::move(value));
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline std::pair<typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator, bool>
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::insert(node_type&& handle)
+{
+    // If the value is already in the set, the handle keeps its node.
+    flush();
+    std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool> result = __tree->insert(std::move(handle));
+    return {sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{result.first, __tree}, result.second};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename... Targs>
+inline std::pair<typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator, bool>
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::emplace(Targs&&... args)
+{
+    // Starts looking for the place of the value where the last insertion
+    // took place while the values come in (or nearly in) order, so that
+    // they take amortized constant time each; otherwise starts at the root.
+    // No node is made for a value that's already in the set.
+    flush();
+    std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool> result = __in_order ? __tree->emplace_hint(__last, std::forward<Targs>(args)...)
+                                              : __tree->emplace(std::forward<Targs>(args)...);
+    return remember_last(result);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename... Targs>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::emplace_hint(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator hint, Targs&&... args)
+{
+    // Starts looking for the place of the value at the hint; the end
+    // iterator stands for the last value. Returns the iterator to the value
+    // in the set, whether it's just been inserted or not.
+    flush();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* start = hint.__node != nullptr ? hint.__node : __tree->maximal();
+    std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool> result = __tree->emplace_hint(start, std::forward<Targs>(args)...);
+    if(result.second)
+        __last = result.first;
+    return sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{result.first, __tree};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline std::pair<typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator, bool>
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::remember_last(std::pair<sg::node_t<Tvalue, Vranked, Vthreaded>*, bool> result)
 {
-    sg::node_t<Tvalue>* node = __tree->search(value);
-    return sg::set<Tvalue>::iterator{node, __tree};
+    if(result.second)
+    {
+        __in_order = __last != nullptr && (result.first->parent() == __last || __last->parent() == result.first);
+        __last = result.first;
+    }
+    return {sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{result.first, __tree}, result.second};
 }
 
-template <typename Tvalue>
-inline typename sg::set<Tvalue>::iterator
-sg::set<Tvalue>::insert(const Tvalue& value)
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::flush()
 {
-    sg::node_t<Tvalue>* node = __tree->insert(value);
-    return sg::set<Tvalue>::iterator{node, __tree};
+    // Puts the values buffered in bulk mode into the tree. The buffer is
+    // taken aside meanwhile, so that if that fails, the values not yet
+    // in the tree are dropped rather than left moved from; otherwise
+    // it gets its storage back for the next values. The values have to be
+    // sorted, so sets of values that can't be have no bulk mode at all.
+    if constexpr(std::is_move_assignable<Tvalue>::value)
+    {
+        if(!__pending || __pending->empty())
+            return;
+        __last = nullptr;
+        __in_order = false;
+        std::vector<Tvalue> values;
+        values.swap(*__pending);
+        __tree->insert_many(values);
+        values.clear();
+        values.swap(*__pending);
+    }
 }
 
-template <typename Tvalue>
-inline typename sg::set<Tvalue>::iterator
-sg::set<Tvalue>::begin()
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::erase(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator position)
 {
-    sg::node_t<Tvalue>* node = __tree->minimal();
-    return sg::set<Tvalue>::iterator{node, __tree};
+    flush();
+    if(position.__node == nullptr)
+        throw std::runtime_error{"sg::set::iterator out of range"};
+    sg::node_t<Tvalue, Vranked, Vthreaded>* next = __tree->successor(position.__node);
+    if(position.__node == __last)
+        __last = nullptr;
+    __tree->remove(position.__node);
+    return sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{next, __tree};
 }
 
-template <typename Tvalue>
-inline typename sg::set<Tvalue>::iterator
-sg::set<Tvalue>::end()
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::erase(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator first,
+                                   sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator last)
 {
-    return sg::set<Tvalue>::iterator{nullptr, __tree};
+    flush();
+    __last = nullptr;
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __tree->remove(first.__node, last.__node);
+    return sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{node, __tree};
 }
 
-template <typename Tvalue>
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
 inline unsigned int
-sg::set<Tvalue>::size()
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::erase(const Tvalue& value)
+{
+    // Returns the number of erased items, i.e. either 0 or 1.
+    flush();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __tree->search(value);
+    if(node == nullptr)
+        return 0;
+    if(node == __last)
+        __last = nullptr;
+    __tree->remove(node);
+    return 1;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::node_type
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::extract(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator position)
+{
+    flush();
+    if(position.__node == nullptr)
+        throw std::runtime_error{"sg::set::iterator out of range"};
+    if(position.__node == __last)
+        __last = nullptr;
+    return __tree->extract(position.__node);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::node_type
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::extract(const Tvalue& value)
+{
+    // Gives an empty handle if there's no such value in the set.
+    flush();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __tree->search(value);
+    if(node == nullptr)
+        return node_type{};
+    if(node == __last)
+        __last = nullptr;
+    return __tree->extract(node);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+template <typename Titerator>
+inline void
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::assign(Titerator first, Titerator last)
+{
+    // Unlike insertion of the items one by one, the tree is built directly
+    // in linear time if the items are already sorted. The values buffered
+    // in bulk mode are dropped along with the old ones.
+    __last = nullptr;
+    if(__pending)
+        __pending->clear();
+    __tree->assign(first, last);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::begin_bulk()
+{
+    // Switches the set to bulk mode, for loading many values at once:
+    // bulk_insert only appends the values to a buffer, which is put into
+    // the tree by end_bulk, sorted and merged with the values already
+    // there in one linear pass, with no rebalancing. Everything else
+    // that reads or modifies the set does the same first, so searches
+    // and insert, which tells whether the value is new, still see
+    // the buffered values, but each of them may cost a rebuild; only
+    // a few of them should come in between the bulk insertions.
+    static_assert(std::is_move_assignable<Tvalue>::value, "sg::set::begin_bulk requires move-assignable values");
+    if(!__pending)
+        __pending = std::make_unique<std::vector<Tvalue>>();
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::end_bulk()
 {
+    flush();
+    __pending = nullptr;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::bulk_insert(const Tvalue& value)
+{
+    // In bulk mode, the value is only buffered, and whether it's new isn't
+    // known until the buffer is put into the tree, so nothing is given
+    // back; out of bulk mode, it's inserted right away.
+    if(__pending)
+        __pending->push_back(value);
+    else
+        emplace(value);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::bulk_insert(Tvalue&& value)
+{
+    if(__pending)
+        __pending->push_back(std::move(value));
+    else
+        emplace(std::move(value));
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::unite(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other)
+{
+    // Adds the values of other to the set, emptying other.
+    flush();
+    other.flush();
+    __last = nullptr;
+    other.__last = nullptr;
+    __tree->unite(*(other.__tree));
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::intersect(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other)
+{
+    // Keeps only the values that are in other as well, emptying other.
+    flush();
+    other.flush();
+    __last = nullptr;
+    other.__last = nullptr;
+    __tree->intersect(*(other.__tree));
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::subtract(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>& other)
+{
+    // Removes the values that are in other, emptying other.
+    flush();
+    other.flush();
+    __last = nullptr;
+    other.__last = nullptr;
+    __tree->subtract(*(other.__tree));
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline unsigned int
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::rank(const Tvalue& value)
+{
+    // The following order statistics are only available for ranked sets.
+    flush();
+    return __tree->rank(value);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::select(unsigned int index)
+{
+    flush();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __tree->select(index);
+    return sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{node, __tree};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline unsigned int
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::count_range(const Tvalue& low, const Tvalue& high)
+{
+    flush();
+    return __tree->count_range(low, high);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::begin()
+{
+    flush();
+    sg::node_t<Tvalue, Vranked, Vthreaded>* node = __tree->minimal();
+    return sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{node, __tree};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline typename sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::end()
+{
+    return sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::iterator{nullptr, __tree};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::frozen_set<Tvalue, Tcompare>
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::freeze()
+{
+    // Makes a read-only copy of the set, which is faster to search;
+    // the set itself stays as it is.
+    return sg::frozen_set<Tvalue, Tcompare>{begin(), end(), __tree->comparator()};
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline void
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::save(const std::string& path)
+{
+    // Writes a snapshot file of the set, which sg::mapped_set serves
+    // without rebuilding anything; see frozen_set::save.
+    freeze().save(path);
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline unsigned int
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::size()
+{
+    flush();
     return __tree->size();
 }
 
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline std::size_t
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::memory_usage()
+{
+    std::size_t pending = __pending ? sizeof(*__pending) + __pending->capacity() * sizeof(Tvalue) : 0;
+    return sizeof(*this) + __tree->memory_usage() + pending;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::tree_stats_t
+sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>::stats()
+{
+    return __tree->stats();
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>
+sg::set_union(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> first, sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> second)
+{
+    // O(m log(n/m + 1)) for moved-in sets, plus the copy of any lvalue.
+    first.unite(second);
+    return first;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>
+sg::set_intersection(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> first, sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> second)
+{
+    // O(m log(n/m + 1)) for moved-in sets, plus the copy of any lvalue.
+    first.intersect(second);
+    return first;
+}
+
+template <typename Tvalue, typename Tcompare, template <typename> class Tallocator, bool Vranked, bool Vthreaded, typename Tstats>
+inline sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats>
+sg::set_difference(sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> first, sg::set<Tvalue, Tcompare, Tallocator, Vranked, Vthreaded, Tstats> second)
+{
+    // O(m log(n/m + 1)) for moved-in sets, plus the copy of any lvalue.
+    first.subtract(second);
+    return first;
+}
+
 #endif // __SET_HPP__
\ No newline at end of file
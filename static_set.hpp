@@ -0,0 +1,373 @@
+#ifndef __STATIC_SET_HPP__
+#define __STATIC_SET_HPP__
+
+#include "compare.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+namespace sg
+{
+    // The number of levels of the smallest full binary tree
+    // that holds the given number of values.
+    constexpr unsigned int static_set_levels(std::size_t size)
+    {
+        unsigned int count = 0;
+        for(; size != 0; size >>= 1)
+        {
+            ++count;
+        }
+        return count;
+    }
+
+    // Read-only sorted set of values known at compile time, such as
+    // the keys of an opcode table. The set is built by a constexpr
+    // constructor from a literal array of values in any order, so
+    // a constexpr set is laid out by the compiler and takes no time
+    // at startup and no heap at all:
+    //
+    //     constexpr sg::static_set opcodes{{0x90, 0x0f, 0xc3, 0xe8}};
+    //     static_assert(opcodes.search(0xc3) != opcodes.end());
+    //
+    // The values are kept in the Eytzinger order as in sg::frozen_set,
+    // in an array that's part of the set; the array is filled up to
+    // a full tree with copies of the greatest value, so that a search
+    // takes one comparison per level and nothing else, the same number
+    // for every key, and is written out as a fixed sequence of them.
+    //
+    // Values must be literal types, default-constructible and assignable
+    // in constant expressions; duplicates are dropped, so the set may
+    // hold fewer values than it's been given.
+    template <typename Tvalue, std::size_t Vsize, typename Tcompare = std::less<Tvalue>>
+    class static_set
+    {
+    public:
+        constexpr static_set(const Tvalue (&values)[Vsize], const Tcompare& compare = Tcompare{});
+
+        class iterator
+        {
+        public:
+            iterator() = delete;
+
+            constexpr const Tvalue& operator->() const;
+            constexpr const Tvalue& operator*() const;
+            constexpr sg::static_set<Tvalue, Vsize, Tcompare>::iterator operator++();
+            constexpr sg::static_set<Tvalue, Vsize, Tcompare>::iterator operator++(int);
+            constexpr sg::static_set<Tvalue, Vsize, Tcompare>::iterator operator--();
+            constexpr sg::static_set<Tvalue, Vsize, Tcompare>::iterator operator--(int);
+            constexpr bool operator==(sg::static_set<Tvalue, Vsize, Tcompare>::iterator iter) const;
+            constexpr bool operator!=(sg::static_set<Tvalue, Vsize, Tcompare>::iterator iter) const;
+
+        private:
+            constexpr iterator(std::size_t index, const sg::static_set<Tvalue, Vsize, Tcompare>* set);
+            std::size_t __index = 0; // Index in the Eytzinger array, 0 is the end
+            const sg::static_set<Tvalue, Vsize, Tcompare>* __set = nullptr;
+            friend class sg::static_set<Tvalue, Vsize, Tcompare>;
+        };
+
+        constexpr sg::static_set<Tvalue, Vsize, Tcompare>::iterator search(const Tvalue& value) const;
+        template <typename Tkey, typename Tc = Tcompare, typename = typename Tc::is_transparent>
+        constexpr sg::static_set<Tvalue, Vsize, Tcompare>::iterator search(const Tkey& key) const;
+        constexpr sg::static_set<Tvalue, Vsize, Tcompare>::iterator lower_bound(const Tvalue& value) const;
+        template <typename Tkey, typename Tc = Tcompare, typename = typename Tc::is_transparent>
+        constexpr sg::static_set<Tvalue, Vsize, Tcompare>::iterator lower_bound(const Tkey& key) const;
+        constexpr sg::static_set<Tvalue, Vsize, Tcompare>::iterator begin() const;
+        constexpr sg::static_set<Tvalue, Vsize, Tcompare>::iterator end() const;
+
+        constexpr unsigned int size() const;
+
+    protected:
+        static constexpr unsigned int level_count = sg::static_set_levels(Vsize);
+        static constexpr std::size_t slot_count = (std::size_t{1} << level_count) - 1;
+
+        template <typename Ta, typename Tb> constexpr bool less(const Ta& a, const Tb& b) const;
+        template <typename Tkey> constexpr std::size_t lower_index(const Tkey& key) const;
+        template <typename Tkey, std::size_t... Vlevels>
+        constexpr std::size_t descend(const Tkey& key, std::index_sequence<Vlevels...> levels) const;
+        constexpr std::size_t first_index() const;
+        constexpr std::size_t last_index() const;
+        constexpr std::size_t next_index(std::size_t index) const;
+        static constexpr std::size_t next_slot(std::size_t index);
+        constexpr std::size_t previous_index(std::size_t index) const;
+
+    private:
+        Tvalue __values[slot_count + 1]; // Eytzinger array, the root at index 1
+        std::size_t __size = 0;
+        std::size_t __last = 0; // Index of the greatest value; the slots after it in order are copies
+        Tcompare __compare;
+    };
+
+} // namespace sg
+
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr
+sg::static_set<Tvalue, Vsize, Tcompare>::static_set(const Tvalue (&values)[Vsize], const Tcompare& compare) :
+    __values{}, __compare(compare)
+{
+    // The values are sorted by insertion, which is quadratic, but only
+    // ever runs in the compiler, on tables written by hand.
+    Tvalue sorted[Vsize] = {};
+    for(std::size_t i = 0; i < Vsize; ++i)
+    {
+        std::size_t position = i;
+        for(; position > 0 && less(values[i], sorted[position - 1]); --position)
+        {
+            sorted[position] = sorted[position - 1];
+        }
+        sorted[position] = values[i];
+    }
+
+    // Of equal values, the first one is kept.
+    for(std::size_t i = 0; i < Vsize; ++i)
+    {
+        if(__size == 0 || less(sorted[__size - 1], sorted[i]))
+            sorted[__size++] = sorted[i];
+    }
+
+    // As in frozen_set, the slots of the array are visited in order,
+    // which puts every value at its place; the greatest value goes on
+    // to the slots left over.
+    std::size_t position = 0;
+    for(std::size_t index = first_index(); index != 0; index = next_slot(index))
+    {
+        if(position == __size - 1)
+            __last = index;
+        __values[index] = sorted[position < __size ? position : __size - 1];
+        ++position;
+    }
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr typename sg::static_set<Tvalue, Vsize, Tcompare>::iterator
+sg::static_set<Tvalue, Vsize, Tcompare>::search(const Tvalue& value) const
+{
+    std::size_t index = lower_index(value);
+    if(index != 0 && less(value, __values[index]))
+        index = 0;
+    return sg::static_set<Tvalue, Vsize, Tcompare>::iterator{index, this};
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+template <typename Tkey, typename Tc, typename>
+constexpr typename sg::static_set<Tvalue, Vsize, Tcompare>::iterator
+sg::static_set<Tvalue, Vsize, Tcompare>::search(const Tkey& key) const
+{
+    std::size_t index = lower_index(key);
+    if(index != 0 && less(key, __values[index]))
+        index = 0;
+    return sg::static_set<Tvalue, Vsize, Tcompare>::iterator{index, this};
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr typename sg::static_set<Tvalue, Vsize, Tcompare>::iterator
+sg::static_set<Tvalue, Vsize, Tcompare>::lower_bound(const Tvalue& value) const
+{
+    return sg::static_set<Tvalue, Vsize, Tcompare>::iterator{lower_index(value), this};
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+template <typename Tkey, typename Tc, typename>
+constexpr typename sg::static_set<Tvalue, Vsize, Tcompare>::iterator
+sg::static_set<Tvalue, Vsize, Tcompare>::lower_bound(const Tkey& key) const
+{
+    return sg::static_set<Tvalue, Vsize, Tcompare>::iterator{lower_index(key), this};
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr typename sg::static_set<Tvalue, Vsize, Tcompare>::iterator
+sg::static_set<Tvalue, Vsize, Tcompare>::begin() const
+{
+    return sg::static_set<Tvalue, Vsize, Tcompare>::iterator{first_index(), this};
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr typename sg::static_set<Tvalue, Vsize, Tcompare>::iterator
+sg::static_set<Tvalue, Vsize, Tcompare>::end() const
+{
+    return sg::static_set<Tvalue, Vsize, Tcompare>::iterator{0, this};
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr unsigned int
+sg::static_set<Tvalue, Vsize, Tcompare>::size() const
+{
+    return __size;
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+template <typename Ta, typename Tb>
+constexpr bool
+sg::static_set<Tvalue, Vsize, Tcompare>::less(const Ta& a, const Tb& b) const
+{
+    if constexpr(sg::is_three_way<Tcompare>::value)
+        return __compare(a, b) < 0;
+    else
+        return __compare(a, b);
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+template <typename Tkey>
+constexpr std::size_t
+sg::static_set<Tvalue, Vsize, Tcompare>::lower_index(const Tkey& key) const
+{
+    // The same descent as in frozen_set, through all the levels of the full
+    // tree. A copy of the greatest value is never the first value not less
+    // than a key, as the greatest value itself comes before it in order,
+    // so the copies needn't be told apart from the values.
+    std::size_t index = descend(key, std::make_index_sequence<level_count>{});
+    while(index & 1)
+        index >>= 1;
+    return index >> 1;
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+template <typename Tkey, std::size_t... Vlevels>
+constexpr std::size_t
+sg::static_set<Tvalue, Vsize, Tcompare>::descend(const Tkey& key, std::index_sequence<Vlevels...> /* levels */) const
+{
+    // One step per level, expanded by the compiler rather than looped over,
+    // so that the search has no loop at all whatever the optimizations.
+    std::size_t index = 1;
+    ((static_cast<void>(Vlevels), index = 2 * index + less(__values[index], key)), ...);
+    return index;
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr std::size_t
+sg::static_set<Tvalue, Vsize, Tcompare>::first_index() const
+{
+    // The leftmost slot of the full tree, which always holds a value.
+    return (slot_count + 1) / 2;
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr std::size_t
+sg::static_set<Tvalue, Vsize, Tcompare>::last_index() const
+{
+    return __last;
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr std::size_t
+sg::static_set<Tvalue, Vsize, Tcompare>::next_index(std::size_t index) const
+{
+    return index == __last ? 0 : next_slot(index);
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr std::size_t
+sg::static_set<Tvalue, Vsize, Tcompare>::next_slot(std::size_t index)
+{
+    // Same as frozen_set::next_index, in a tree with no missing slots.
+    if(2 * index + 1 <= slot_count)
+    {
+        index = 2 * index + 1;
+        while(2 * index <= slot_count)
+            index *= 2;
+        return index;
+    }
+
+    while(index & 1)
+        index >>= 1;
+    return index >> 1;
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr std::size_t
+sg::static_set<Tvalue, Vsize, Tcompare>::previous_index(std::size_t index) const
+{
+    // The greatest value comes after all the others in order, so going
+    // back from a value never reaches a copy of it.
+    if(2 * index <= slot_count)
+    {
+        index = 2 * index;
+        while(2 * index + 1 <= slot_count)
+            index = 2 * index + 1;
+        return index;
+    }
+
+    while(index > 1 && !(index & 1))
+        index >>= 1;
+    return index >> 1;
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr
+sg::static_set<Tvalue, Vsize, Tcompare>::iterator::iterator(std::size_t index, const sg::static_set<Tvalue, Vsize, Tcompare>* set) :
+    __index(index), __set(set)
+{
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr const Tvalue&
+sg::static_set<Tvalue, Vsize, Tcompare>::iterator::operator->() const
+{
+    return operator*();
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr const Tvalue&
+sg::static_set<Tvalue, Vsize, Tcompare>::iterator::operator*() const
+{
+    if(__index == 0)
+        throw std::runtime_error{"sg::static_set::iterator out of range"};
+    return __set->__values[__index];
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr typename sg::static_set<Tvalue, Vsize, Tcompare>::iterator
+sg::static_set<Tvalue, Vsize, Tcompare>::iterator::operator++()
+{
+    if(__index == 0)
+        throw std::runtime_error{"sg::static_set::iterator out of range"};
+    __index = __set->next_index(__index);
+    return *this;
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr typename sg::static_set<Tvalue, Vsize, Tcompare>::iterator
+sg::static_set<Tvalue, Vsize, Tcompare>::iterator::operator++(int)
+{
+    sg::static_set<Tvalue, Vsize, Tcompare>::iterator old = *this;
+    operator++();
+    return old;
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr typename sg::static_set<Tvalue, Vsize, Tcompare>::iterator
+sg::static_set<Tvalue, Vsize, Tcompare>::iterator::operator--()
+{
+    std::size_t index = __index == 0 ? __set->last_index() : __set->previous_index(__index);
+    if(index == 0)
+        throw std::runtime_error{"sg::static_set::iterator out of range"};
+    __index = index;
+    return *this;
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr typename sg::static_set<Tvalue, Vsize, Tcompare>::iterator
+sg::static_set<Tvalue, Vsize, Tcompare>::iterator::operator--(int)
+{
+    sg::static_set<Tvalue, Vsize, Tcompare>::iterator old = *this;
+    operator--();
+    return old;
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr bool
+sg::static_set<Tvalue, Vsize, Tcompare>::iterator::operator==(sg::static_set<Tvalue, Vsize, Tcompare>::iterator iter) const
+{
+    return __index == iter.__index && __set == iter.__set;
+}
+
+template <typename Tvalue, std::size_t Vsize, typename Tcompare>
+constexpr bool
+sg::static_set<Tvalue, Vsize, Tcompare>::iterator::operator!=(sg::static_set<Tvalue, Vsize, Tcompare>::iterator iter) const
+{
+    return !operator==(iter);
+}
+
+#endif // __STATIC_SET_HPP__
@@ -0,0 +1,117 @@
+#ifndef __STATS_HPP__
+#define __STATS_HPP__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace sg
+{
+    // Snapshot of what a tree counted since it was created, along with
+    // the shape of the tree at the moment the snapshot was taken.
+    struct tree_stats_t
+    {
+        static constexpr std::size_t depth_count = 64;
+
+        // Comparisons made by searches and by insertions (including
+        // the hinted ones) to find the place of a value.
+        std::uint64_t comparisons = 0;
+        std::uint64_t searches = 0;
+        std::uint64_t left_rotations = 0;
+        std::uint64_t right_rotations = 0;
+        // Nodes whose color was changed while rebalancing after
+        // an insertion, and the iterations of the rebalancing loop.
+        std::uint64_t recolorings = 0;
+        std::uint64_t rebalance_iterations = 0;
+        // The number of searches that visited the given number of nodes;
+        // the last entry also counts the longer searches.
+        std::array<std::uint64_t, depth_count> search_depths{};
+        unsigned int height = 0;
+        unsigned int black_height = 0;
+    };
+
+    // Stats policy of a tree that counts nothing: its hooks are empty,
+    // so a tree built with it compiles to the same code as if it had
+    // no hooks at all. This is the default.
+    class no_stats_t
+    {
+    public:
+        static constexpr bool enabled = false;
+
+        void compared() {}
+        void searched(unsigned int /* depth */) {}
+        void rotated_left() {}
+        void rotated_right() {}
+        void recolored(unsigned int /* count */) {}
+        void rebalanced() {}
+    };
+
+    // Stats policy that counts the work done on the hot paths of a tree,
+    // for relating its speed to its shape. The counters are plain, not
+    // atomic, so a tree searched by several threads at once must not
+    // use it.
+    class counting_stats_t
+    {
+    public:
+        static constexpr bool enabled = true;
+
+        void compared();
+        void searched(unsigned int depth);
+        void rotated_left();
+        void rotated_right();
+        void recolored(unsigned int count);
+        void rebalanced();
+
+        const sg::tree_stats_t& counters() const;
+
+    private:
+        sg::tree_stats_t __counters;
+    };
+
+} // namespace sg
+
+
+inline void
+sg::counting_stats_t::compared()
+{
+    ++__counters.comparisons;
+}
+
+inline void
+sg::counting_stats_t::searched(unsigned int depth)
+{
+    ++__counters.searches;
+    ++__counters.search_depths[depth < sg::tree_stats_t::depth_count ? depth : sg::tree_stats_t::depth_count - 1];
+}
+
+inline void
+sg::counting_stats_t::rotated_left()
+{
+    ++__counters.left_rotations;
+}
+
+inline void
+sg::counting_stats_t::rotated_right()
+{
+    ++__counters.right_rotations;
+}
+
+inline void
+sg::counting_stats_t::recolored(unsigned int count)
+{
+    __counters.recolorings += count;
+}
+
+inline void
+sg::counting_stats_t::rebalanced()
+{
+    ++__counters.rebalance_iterations;
+}
+
+inline const sg::tree_stats_t&
+sg::counting_stats_t::counters() const
+{
+    return __counters;
+}
+
+#endif // __STATS_HPP__
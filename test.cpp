@@ -1,10 +1,31 @@
+#include "btree.hpp"
+#include "compact.hpp"
+#include "concurrent.hpp"
+#include "lean.hpp"
+#include "map.hpp"
+#include "mapped.hpp"
+#include "persistent.hpp"
+#include "rcu.hpp"
 #include "set.hpp"
+#include "static_set.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <fstream>
+#include <functional>
 #include <iomanip>
+#include <iterator>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 namespace
 {
@@ -18,18 +39,56 @@ namespace
         return static_cast<int>(std::rand() * (static_cast<double>(rand_max) / RAND_MAX));
     }
 
+    // A string that counts how many times it has been copied, to tell
+    // whether a set copies the values it's given.
+    struct counted_string_t
+    {
+        counted_string_t(const std::string& str) : value{str} {}
+        counted_string_t(std::size_t count, char symbol) : value(count, symbol) {}
+        counted_string_t(const counted_string_t& obj) : value{obj.value} { ++copies; }
+        counted_string_t(counted_string_t&& obj) = default;
+
+        bool operator<(const counted_string_t& other) const { return value < other.value; }
+
+        std::string value;
+        static inline unsigned int copies = 0;
+    };
+
+    // Keys of a static set, made up at compile time by a linear
+    // congruential generator, so that they come unsorted and with
+    // duplicates as in a table written by hand.
+    template <std::size_t Vsize>
+    struct static_keys_t
+    {
+        int values[Vsize] = {};
+    };
+
+    template <std::size_t Vsize>
+    constexpr sg::static_set<int, Vsize> make_static_set(unsigned int range)
+    {
+        static_keys_t<Vsize> keys;
+        unsigned int state = 1;
+        for(int& value : keys.values)
+        {
+            state = state * 1664525 + 1013904223;
+            value = state % range;
+        }
+        return sg::static_set<int, Vsize>{keys.values};
+    }
+
 } // unnamed namespace
 
 // Tests addition of new elements and tests whether the tree
 // properly checks for duplicates.
 // (std::set is used as a reference)
-void test0(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+template <typename Tset = sg::set<int>>
+bool test0(unsigned int sample_size, unsigned int random_range, bool verbose = true)
 {
     bool total_test_result = true;
 
     std::srand(1);
     std::set<int> stl_set;
-    sg::set<int> sg_set;
+    Tset sg_set;
 
     for(int i = 0; i < sample_size; ++i)
     {
@@ -37,8 +96,7 @@ void test0(unsigned int sample_size, unsigned int random_range, bool verbose = t
 
         auto [stl_iter, stl_added] = stl_set.insert(random_number);
 
-        auto sg_iter = sg_set.insert(random_number);
-        bool sg_added = sg_iter != sg_set.end();
+        auto [sg_iter, sg_added] = sg_set.insert(random_number);
 
         if(verbose)
         {
@@ -48,22 +106,24 @@ void test0(unsigned int sample_size, unsigned int random_range, bool verbose = t
             std::cout << "same: " << get_yes_no(stl_added == sg_added) << std::endl;
         }
 
-        total_test_result = total_test_result && (stl_added == sg_added);
+        total_test_result = total_test_result && (stl_added == sg_added) && *sg_iter == random_number;
     }
 
     std::cout << "Total test0 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
 }
 
 // Generates a big tree and checks that in the range [0, random_range]
 // search results correspond to the numbers really added
 // (again, std::set is used as a reference).
-void test1(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+template <typename Tset = sg::set<int>>
+bool test1(unsigned int sample_size, unsigned int random_range, bool verbose = true)
 {
     bool total_test_result = true;
 
     std::srand(1);
     std::set<int> stl_set;
-    sg::set<int> sg_set;
+    Tset sg_set;
 
     for(int i = 0; i < sample_size; ++i)
     {
@@ -93,12 +153,1657 @@ void test1(unsigned int sample_size, unsigned int random_range, bool verbose = t
     }
 
     std::cout << "Total test1 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Copies a big tree and checks that the copy holds the same items in the
+// same order as the original one, and that both trees stay independent
+// when one of them is modified afterwards (std::set is used as a reference).
+template <typename Tset = sg::set<int>>
+bool test2(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    bool total_test_result = true;
+
+    std::srand(1);
+    std::set<int> stl_set;
+    Tset sg_set;
+
+    for(int i = 0; i < sample_size; ++i)
+    {
+        int random_number = get_random_int(random_range);
+
+        stl_set.insert(random_number);
+        sg_set.insert(random_number);
+    }
+
+    Tset sg_copy{sg_set};
+    Tset sg_assigned;
+    sg_assigned.insert(random_range + 1);
+    sg_assigned = sg_copy;
+
+    // The copy gets a new item, which must not appear in the original.
+    sg_copy.insert(random_range + 1);
+
+    auto check_same = [&](const char* name, Tset& sg_checked, const std::set<int>& stl_checked)
+    {
+        bool same = sg_checked.size() == stl_checked.size();
+        auto stl_iter = stl_checked.begin();
+        for(auto sg_iter = sg_checked.begin(); same && sg_iter != sg_checked.end(); ++sg_iter, ++stl_iter)
+        {
+            same = (stl_iter != stl_checked.end()) && (*sg_iter == *stl_iter);
+        }
+
+        if(verbose)
+        {
+            std::cout << "[Checking: " << std::setw(8) << name << "] ";
+            std::cout << "size: " << std::setw(5) << sg_checked.size() << "; ";
+            std::cout << "same: " << get_yes_no(same) << std::endl;
+        }
+
+        total_test_result = total_test_result && same;
+    };
+
+    std::set<int> stl_copy{stl_set};
+    stl_copy.insert(random_range + 1);
+
+    check_same("original", sg_set, stl_set);
+    check_same("copy", sg_copy, stl_copy);
+    check_same("assigned", sg_assigned, stl_set);
+
+    std::cout << "Total test2 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Builds trees at once out of sorted and unsorted sequences with duplicates,
+// and checks that they hold the same items as std::set built by insertion.
+bool test3(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    bool total_test_result = true;
+
+    std::srand(1);
+    std::vector<int> unsorted;
+    for(int i = 0; i < sample_size; ++i)
+    {
+        unsorted.push_back(get_random_int(random_range));
+    }
+    std::vector<int> sorted{unsorted};
+    std::sort(sorted.begin(), sorted.end());
+
+    std::set<int> stl_set{unsorted.begin(), unsorted.end()};
+    sg::set<int> sg_sorted{sorted.begin(), sorted.end()};
+    sg::set<int> sg_unsorted;
+    sg_unsorted.insert(random_range + 1);
+    sg_unsorted.assign(unsorted.begin(), unsorted.end());
+
+    for(sg::set<int>* sg_set : {&sg_sorted, &sg_unsorted})
+    {
+        bool same = sg_set->size() == stl_set.size();
+        auto stl_iter = stl_set.begin();
+        for(auto sg_iter = sg_set->begin(); same && sg_iter != sg_set->end(); ++sg_iter, ++stl_iter)
+        {
+            same = (*sg_iter == *stl_iter) && (sg_set->search(*stl_iter) == sg_iter);
+        }
+
+        if(verbose)
+        {
+            std::cout << "[Checking: " << (sg_set == &sg_sorted ? "sorted" : "unsorted") << "] ";
+            std::cout << "size: " << std::setw(5) << sg_set->size() << "; ";
+            std::cout << "same: " << get_yes_no(same) << std::endl;
+        }
+
+        total_test_result = total_test_result && same;
+    }
+
+    // Unsorted values are moved into the nodes, so long strings that don't
+    // fit in place check that the duplicates are told apart from the nodes.
+    std::vector<std::string> strings;
+    for(int i = 0; i < sample_size; ++i)
+    {
+        strings.push_back(std::string(40, 'a') + std::to_string(get_random_int(random_range)));
+    }
+    std::set<std::string, std::greater<std::string>> stl_strings{strings.begin(), strings.end()};
+    sg::set<std::string, std::greater<std::string>> sg_strings{strings.begin(), strings.end()};
+    bool same_strings = sg_strings.size() == stl_strings.size() &&
+                        std::equal(stl_strings.begin(), stl_strings.end(), sg_strings.begin());
+    if(verbose)
+    {
+        std::cout << "[Checking: strings] ";
+        std::cout << "size: " << std::setw(5) << sg_strings.size() << "; ";
+        std::cout << "same: " << get_yes_no(same_strings) << std::endl;
+    }
+    total_test_result = total_test_result && same_strings;
+
+    std::cout << "Total test3 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Mixes insertions with erasures by value, by iterator and by range, and
+// moves items between two sets through node handles; after every round
+// both sets are compared with their std::set references.
+bool test4(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    bool total_test_result = true;
+
+    std::srand(1);
+    std::set<int> stl_set, stl_other;
+    sg::set<int> sg_set, sg_other;
+
+    auto check_same = [&](sg::set<int>& sg_checked, const std::set<int>& stl_checked)
+    {
+        bool same = sg_checked.size() == stl_checked.size();
+        auto stl_iter = stl_checked.begin();
+        for(auto sg_iter = sg_checked.begin(); same && sg_iter != sg_checked.end(); ++sg_iter, ++stl_iter)
+        {
+            same = (stl_iter != stl_checked.end()) && (*sg_iter == *stl_iter);
+        }
+        return same;
+    };
+
+    for(int round = 0; round < 10; ++round)
+    {
+        for(int i = 0; i < sample_size; ++i)
+        {
+            int random_number = get_random_int(random_range);
+            stl_set.insert(random_number);
+            sg_set.insert(random_number);
+
+            random_number = get_random_int(random_range);
+            bool stl_erased = stl_set.erase(random_number) == 1;
+            bool sg_erased = sg_set.erase(random_number) == 1;
+            total_test_result = total_test_result && (stl_erased == sg_erased);
+        }
+
+        // Erase a small range by iterators, then every other item from
+        // the beginning of the set.
+        int low = get_random_int(random_range);
+        int high = low + random_range / 100;
+        auto sg_first = sg_set.begin();
+        while(sg_first != sg_set.end() && *sg_first < low)
+            ++sg_first;
+        auto sg_last = sg_first;
+        while(sg_last != sg_set.end() && *sg_last < high)
+            ++sg_last;
+        sg_set.erase(sg_first, sg_last);
+        stl_set.erase(stl_set.lower_bound(low), stl_set.lower_bound(high));
+
+        auto sg_iter = sg_set.begin();
+        for(int i = 0; i < 100 && sg_iter != sg_set.end(); ++i)
+        {
+            stl_set.erase(*sg_iter);
+            sg_iter = sg_set.erase(sg_iter);
+            if(sg_iter != sg_set.end())
+                ++sg_iter;
+        }
+
+        // Move a few items to the other set and back.
+        for(int i = 0; i < 100; ++i)
+        {
+            int random_number = get_random_int(random_range);
+            auto handle = sg_set.extract(random_number);
+            if(!handle)
+                continue;
+            stl_set.erase(random_number);
+            if(i % 2 == 0 && sg_other.insert(std::move(handle)).second)
+                stl_other.insert(random_number);
+            else if(sg_set.insert(std::move(handle)).second)
+                stl_set.insert(random_number);
+        }
+
+        bool same = check_same(sg_set, stl_set) && check_same(sg_other, stl_other);
+
+        if(verbose)
+        {
+            std::cout << "[Round: " << std::setw(2) << round << "] ";
+            std::cout << "sizes: " << std::setw(5) << sg_set.size() << ", " << std::setw(5) << sg_other.size() << "; ";
+            std::cout << "same: " << get_yes_no(same) << std::endl;
+        }
+
+        total_test_result = total_test_result && same;
+    }
+
+    // Ranges holding most of a set are erased by relinking the rest
+    // of it; a heap-allocated set frees every node right away, so that
+    // touching a removed node would show under a memory checker.
+    for(int size = 4; size <= 200; ++size)
+    {
+        for(int low : {0, size / 4})
+        {
+            sg::set<int, std::less<int>, sg::heap_t> sg_heap_set;
+            std::set<int> stl_heap_set;
+            for(int i = 0; i < size; ++i)
+            {
+                sg_heap_set.insert(i);
+                stl_heap_set.insert(i);
+            }
+            int high = low == 0 ? size - 1 : size;
+            auto sg_last = high == size ? sg_heap_set.end() : sg_heap_set.search(high);
+            sg_heap_set.erase(sg_heap_set.search(low), sg_last);
+            stl_heap_set.erase(stl_heap_set.lower_bound(low), stl_heap_set.lower_bound(high));
+            sg_heap_set.insert(size);
+            stl_heap_set.insert(size);
+            total_test_result = total_test_result && sg_heap_set.size() == stl_heap_set.size() &&
+                                std::equal(stl_heap_set.begin(), stl_heap_set.end(), sg_heap_set.begin());
+        }
+    }
+
+    // Erasing everything gives back an empty, but still usable set.
+    sg_set.erase(sg_set.begin(), sg_set.end());
+    sg_set.insert(1);
+    total_test_result = total_test_result && sg_set.size() == 1 && *sg_set.begin() == 1;
+
+    std::cout << "Total test4 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Checks order statistics of a ranked set, which undergoes insertions
+// and erasures, against positions of the items in a sorted std::vector.
+bool test5(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    bool total_test_result = true;
+
+    std::srand(1);
+    std::set<int> stl_set;
+    sg::set<int, std::less<int>, sg::pool_t, true> sg_set;
+
+    for(int i = 0; i < sample_size; ++i)
+    {
+        int random_number = get_random_int(random_range);
+        stl_set.insert(random_number);
+        sg_set.insert(random_number);
+
+        if(i % 3 == 0)
+        {
+            random_number = get_random_int(random_range);
+            stl_set.erase(random_number);
+            sg_set.erase(random_number);
+        }
+    }
+
+    std::vector<int> sorted{stl_set.begin(), stl_set.end()};
+    for(int number = 0; number < random_range; ++number)
+    {
+        unsigned int stl_rank = std::lower_bound(sorted.begin(), sorted.end(), number) - sorted.begin();
+        unsigned int sg_rank = sg_set.rank(number);
+
+        bool same = stl_rank == sg_rank;
+        if(number < sorted.size())
+            same = same && *sg_set.select(number) == sorted[number];
+
+        int high = number + get_random_int(random_range / 10);
+        unsigned int stl_count = std::lower_bound(sorted.begin(), sorted.end(), high) - sorted.begin() - stl_rank;
+        same = same && sg_set.count_range(number, high) == stl_count;
+
+        if(verbose)
+        {
+            std::cout << "[Checking: " << std::setw(5) << number << "] ";
+            std::cout << "std::set rank: " << std::setw(5) << stl_rank << ", ";
+            std::cout << "sg::set rank: " << std::setw(5) << sg_rank << "; ";
+            std::cout << "same: " << get_yes_no(same) << std::endl;
+        }
+
+        total_test_result = total_test_result && same;
+    }
+    total_test_result = total_test_result && sg_set.select(sorted.size()) == sg_set.end();
+
+    std::cout << "Total test5 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Checks sets ordered by custom comparators: a reversed order of numbers,
+// and strings compared either with a three-way comparator or with
+// a transparent one, searched for by std::string_view.
+bool test6(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    bool total_test_result = true;
+
+    std::srand(1);
+    std::set<int, std::greater<int>> stl_reversed;
+    sg::set<int, std::greater<int>> sg_reversed;
+    std::set<std::string> stl_strings;
+    sg::set<std::string, sg::compare_three_way_t> sg_three_way;
+    sg::set<std::string, std::less<>> sg_transparent;
+
+    for(int i = 0; i < sample_size; ++i)
+    {
+        int random_number = get_random_int(random_range);
+        stl_reversed.insert(random_number);
+        sg_reversed.insert(random_number);
+
+        std::string random_string = std::to_string(random_number);
+        stl_strings.insert(random_string);
+        sg_three_way.insert(random_string);
+        sg_transparent.insert(random_string);
+    }
+
+    bool same = sg_reversed.size() == stl_reversed.size();
+    auto stl_iter = stl_reversed.begin();
+    for(auto sg_iter = sg_reversed.begin(); same && sg_iter != sg_reversed.end(); ++sg_iter, ++stl_iter)
+    {
+        same = *sg_iter == *stl_iter;
+    }
+    total_test_result = total_test_result && same;
+
+    for(int number = 0; number < random_range; ++number)
+    {
+        std::string string = std::to_string(number);
+        std::string_view view{string};
+
+        bool stl_found = stl_strings.find(string) != stl_strings.end();
+        bool sg_three_way_found = sg_three_way.search(view) != sg_three_way.end();
+        bool sg_transparent_found = sg_transparent.search(view) != sg_transparent.end();
+        bool sg_reversed_found = sg_reversed.search(number) != sg_reversed.end();
+
+        same = (stl_found == sg_three_way_found) && (stl_found == sg_transparent_found) &&
+               (stl_found == sg_reversed_found);
+
+        if(verbose)
+        {
+            std::cout << "[Checking: " << std::setw(5) << number << "] ";
+            std::cout << "std::set found: " << std::setw(5) << std::boolalpha << stl_found << ", ";
+            std::cout << "sg::set found: " << std::setw(5) << std::boolalpha << sg_three_way_found << "; ";
+            std::cout << "same: " << get_yes_no(same) << std::endl;
+        }
+
+        total_test_result = total_test_result && same;
+    }
+
+    std::cout << "Total test6 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Checks that a threaded set, which undergoes insertions and erasures,
+// is iterated in both directions the same way as std::set.
+bool test7(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    bool total_test_result = true;
+
+    std::srand(1);
+    std::set<int> stl_set;
+    sg::set<int, std::less<int>, sg::pool_t, false, true> sg_set;
+
+    for(int round = 0; round < 10; ++round)
+    {
+        for(int i = 0; i < sample_size; ++i)
+        {
+            int random_number = get_random_int(random_range);
+            stl_set.insert(random_number);
+            sg_set.insert(random_number);
+
+            random_number = get_random_int(random_range);
+            stl_set.erase(random_number);
+            sg_set.erase(random_number);
+        }
+
+        bool same = sg_set.size() == stl_set.size();
+        auto stl_iter = stl_set.begin();
+        for(auto sg_iter = sg_set.begin(); same && sg_iter != sg_set.end(); ++sg_iter, ++stl_iter)
+        {
+            same = *sg_iter == *stl_iter;
+        }
+
+        auto stl_reverse = stl_set.rbegin();
+        auto sg_reverse = sg_set.end();
+        for(; same && stl_reverse != stl_set.rend(); ++stl_reverse)
+        {
+            same = *(--sg_reverse) == *stl_reverse;
+        }
+
+        if(verbose)
+        {
+            std::cout << "[Round: " << std::setw(2) << round << "] ";
+            std::cout << "size: " << std::setw(5) << sg_set.size() << "; ";
+            std::cout << "same: " << get_yes_no(same) << std::endl;
+        }
+
+        total_test_result = total_test_result && same;
+    }
+
+    // Copies and trees built at once must be threaded as well.
+    sg::set<int, std::less<int>, sg::pool_t, false, true> sg_copy{sg_set};
+    std::vector<int> sorted{stl_set.begin(), stl_set.end()};
+    sg::set<int, std::less<int>, sg::pool_t, false, true> sg_built{sorted.begin(), sorted.end()};
+    for(auto* sg_checked : {&sg_copy, &sg_built})
+    {
+        bool same = sg_checked->size() == stl_set.size();
+        auto stl_iter = stl_set.begin();
+        for(auto sg_iter = sg_checked->begin(); same && sg_iter != sg_checked->end(); ++sg_iter, ++stl_iter)
+        {
+            same = *sg_iter == *stl_iter;
+        }
+        same = same && (stl_set.empty() || *(--sg_checked->end()) == *stl_set.rbegin());
+        total_test_result = total_test_result && same;
+    }
+
+    std::cout << "Total test7 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Searches for many keys at once and checks the results against
+// the searches of the keys one by one.
+bool test8(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    bool total_test_result = true;
+
+    std::srand(1);
+    sg::set<int> sg_set;
+    sg::set<int, sg::compare_three_way_t> sg_three_way;
+
+    for(int i = 0; i < sample_size; ++i)
+    {
+        int random_number = get_random_int(random_range);
+        sg_set.insert(random_number);
+        sg_three_way.insert(random_number);
+    }
+
+    std::vector<int> keys;
+    for(int number = 0; number < random_range; ++number)
+    {
+        keys.push_back(number);
+    }
+
+    std::vector<sg::set<int>::iterator> found;
+    std::vector<sg::set<int, sg::compare_three_way_t>::iterator> three_way_found;
+    sg_set.search_many(keys.begin(), keys.end(), std::back_inserter(found));
+    sg_three_way.search_many(keys.begin(), keys.end(), std::back_inserter(three_way_found));
+
+    total_test_result = found.size() == keys.size() && three_way_found.size() == keys.size();
+    for(int i = 0; total_test_result && i < keys.size(); ++i)
+    {
+        bool same = (found[i] == sg_set.search(keys[i])) && (three_way_found[i] == sg_three_way.search(keys[i]));
+
+        if(verbose)
+        {
+            std::cout << "[Checking: " << std::setw(5) << keys[i] << "] ";
+            std::cout << "found: " << std::setw(5) << std::boolalpha << (found[i] != sg_set.end()) << "; ";
+            std::cout << "same: " << get_yes_no(same) << std::endl;
+        }
+
+        total_test_result = total_test_result && same;
+    }
+
+    std::cout << "Total test8 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Tests the frozen copy of a set: its iteration in both directions,
+// search and lower bounds; sets of every size up to a few levels are
+// checked, as the shape of the implicit tree depends on the size.
+// (std::set is used as a reference)
+bool test9(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    bool total_test_result = true;
+
+    std::srand(1);
+    std::set<int> stl_set;
+    sg::set<int, sg::compare_three_way_t> sg_set;
+
+    for(int i = 0; i < sample_size; ++i)
+    {
+        sg::frozen_set<int, sg::compare_three_way_t> frozen = sg_set.freeze();
+
+        bool same_order = frozen.size() == stl_set.size() && std::equal(stl_set.begin(), stl_set.end(), frozen.begin());
+        bool same_reverse_order = true;
+        auto frozen_iter = frozen.end();
+        for(auto stl_iter = stl_set.rbegin(); stl_iter != stl_set.rend(); ++stl_iter)
+        {
+            same_reverse_order = same_reverse_order && *(--frozen_iter) == *stl_iter;
+        }
+        same_reverse_order = same_reverse_order && frozen_iter == frozen.begin();
+
+        bool same_search = true;
+        for(int number = -1; number <= random_range; ++number)
+        {
+            auto stl_bound = stl_set.lower_bound(number);
+            auto frozen_bound = frozen.lower_bound(number);
+            bool found = frozen.search(number) != frozen.end();
+
+            same_search = same_search && found == (stl_set.count(number) == 1);
+            same_search = same_search && (stl_bound == stl_set.end() ? frozen_bound == frozen.end() : *frozen_bound == *stl_bound);
+        }
+
+        if(verbose)
+        {
+            std::cout << "[Checking size: " << std::setw(5) << stl_set.size() << "] ";
+            std::cout << "order: " << get_yes_no(same_order && same_reverse_order) << "; ";
+            std::cout << "search: " << get_yes_no(same_search) << std::endl;
+        }
+
+        total_test_result = total_test_result && same_order && same_reverse_order && same_search;
+
+        int random_number = get_random_int(random_range);
+        stl_set.insert(random_number);
+        sg_set.insert(random_number);
+    }
+
+    std::cout << "Total test9 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Inserts, erases and searches values of a sharded set from several
+// threads at once and checks that the set ends up holding what a single
+// std::set gets from the same operations.
+bool test10(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    constexpr unsigned int thread_count = 8;
+
+    std::srand(1);
+    std::vector<int> numbers;
+    for(int i = 0; i < sample_size; ++i)
+    {
+        numbers.push_back(get_random_int(random_range));
+    }
+
+    // Every thread takes the numbers of its own residue, so that the final
+    // content doesn't depend on the order of the operations; numbers
+    // divisible by three are erased right after they're inserted.
+    std::set<int> stl_set;
+    for(int number : numbers)
+    {
+        if(number % 3 != 0)
+            stl_set.insert(number);
+    }
+
+    std::vector<int> boundaries;
+    for(int boundary = random_range / 16; boundary < random_range; boundary += random_range / 16)
+    {
+        boundaries.push_back(boundary);
+    }
+    sg::concurrent_set<int> sg_set{boundaries};
+
+    std::vector<std::thread> threads;
+    for(int thread = 0; thread < thread_count; ++thread)
+    {
+        threads.emplace_back([&, thread]()
+        {
+            for(int number : numbers)
+            {
+                if(number % thread_count != thread)
+                {
+                    sg_set.contains(number);
+                    continue;
+                }
+
+                sg_set.insert(number);
+                if(number % 3 == 0)
+                    sg_set.erase(number);
+            }
+        });
+    }
+    for(std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::vector<int> sg_values;
+    sg_set.for_each([&](int value) { sg_values.push_back(value); });
+    bool same_order = sg_values.size() == stl_set.size() && std::equal(stl_set.begin(), stl_set.end(), sg_values.begin());
+
+    bool same_search = true;
+    for(int number = 0; number < random_range; ++number)
+    {
+        same_search = same_search && sg_set.contains(number) == (stl_set.count(number) == 1);
+    }
+
+    if(verbose)
+    {
+        std::cout << "[Checking: " << sg_set.shard_count() << " shards] ";
+        std::cout << "size: " << std::setw(5) << sg_set.size() << "; ";
+        std::cout << "order: " << get_yes_no(same_order) << "; ";
+        std::cout << "search: " << get_yes_no(same_search) << std::endl;
+    }
+
+    bool total_test_result = same_order && same_search && sg_set.size() == stl_set.size();
+    std::cout << "Total test10 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Runs lock-free readers against a writer that keeps inserting and erasing
+// values (and so rotating the tree). Multiples of 4 are inserted before
+// the readers start and never erased, numbers of the form 4k + 1 are
+// never inserted: every search for them must give the same answer all
+// the time, whatever the writer is doing. At the end the set must hold
+// what std::set got from the same operations.
+bool test11(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    constexpr unsigned int reader_count = 4;
+
+    sg::rcu_set<int> sg_set;
+    std::set<int> stl_set;
+    for(int number = 0; number < random_range; number += 4)
+    {
+        sg_set.insert(number);
+        stl_set.insert(number);
+    }
+
+    std::atomic<bool> writing{true};
+    std::atomic<unsigned int> search_count{0};
+    std::atomic<unsigned int> wrong_count{0};
+
+    std::vector<std::thread> readers;
+    for(int thread = 0; thread < reader_count; ++thread)
+    {
+        readers.emplace_back([&, thread]()
+        {
+            sg::rcu_set<int>::reader reader{sg_set};
+            unsigned int searches = 0;
+            unsigned int wrong = 0;
+            for(int number = thread; writing; number = (number + 1) % random_range)
+            {
+                if(number % 4 == 0 && !reader.contains(number))
+                    ++wrong;
+                if(number % 4 == 1 && reader.contains(number))
+                    ++wrong;
+                ++searches;
+            }
+            search_count += searches;
+            wrong_count += wrong;
+        });
+    }
+
+    std::srand(1);
+    for(int i = 0; i < sample_size; ++i)
+    {
+        // Only numbers of the forms 4k + 2 and 4k + 3 are changed.
+        int number = get_random_int(random_range / 4 - 1) * 4 + 2 + get_random_int(1);
+        if(get_random_int(1) == 0)
+        {
+            sg_set.insert(number);
+            stl_set.insert(number);
+        }
+        else
+        {
+            sg_set.erase(number);
+            stl_set.erase(number);
+        }
+    }
+    writing = false;
+    for(std::thread& reader : readers)
+    {
+        reader.join();
+    }
+
+    sg::rcu_set<int>::reader reader{sg_set};
+    bool same_search = sg_set.size() == stl_set.size();
+    for(int number = 0; number < random_range; ++number)
+    {
+        same_search = same_search && reader.contains(number) == (stl_set.count(number) == 1);
+    }
+
+    if(verbose)
+    {
+        std::cout << "[Checking: " << search_count << " concurrent searches] ";
+        std::cout << "wrong: " << wrong_count << "; ";
+        std::cout << "final search: " << get_yes_no(same_search) << std::endl;
+    }
+
+    bool total_test_result = wrong_count == 0 && same_search;
+    std::cout << "Total test11 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Takes a snapshot of a persistent set every few insertions, together
+// with a copy of a std::set, and keeps inserting; at the end every
+// snapshot must still hold what the copy taken with it holds, both in
+// order and in searches, and the early ones are released before the last
+// ones are checked.
+bool test12(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    constexpr unsigned int snapshot_step = 100;
+
+    std::srand(1);
+    sg::persistent_set<int> sg_set;
+    std::set<int> stl_set;
+    std::vector<sg::snapshot_t<int>> snapshots;
+    std::vector<std::set<int>> stl_copies;
+
+    bool same_insert = true;
+    for(int i = 0; i < sample_size; ++i)
+    {
+        if(i % snapshot_step == 0)
+        {
+            snapshots.push_back(sg_set.snapshot());
+            stl_copies.push_back(stl_set);
+        }
+
+        int random_number = get_random_int(random_range);
+        same_insert = same_insert && sg_set.insert(random_number) == stl_set.insert(random_number).second;
+    }
+    snapshots.push_back(sg_set.snapshot());
+    stl_copies.push_back(stl_set);
+
+    // Releasing every other version must leave the others whole.
+    for(std::size_t i = 0; i < snapshots.size(); ++i)
+    {
+        snapshots.erase(snapshots.begin() + i);
+        stl_copies.erase(stl_copies.begin() + i);
+    }
+
+    bool total_test_result = same_insert;
+    for(std::size_t i = 0; total_test_result && i < snapshots.size(); ++i)
+    {
+        sg::snapshot_t<int>& snapshot = snapshots[i];
+        const std::set<int>& stl_copy = stl_copies[i];
+
+        bool same_order = snapshot.size() == stl_copy.size();
+        auto stl_iter = stl_copy.begin();
+        for(auto iter = snapshot.begin(); same_order && iter != snapshot.end(); ++iter, ++stl_iter)
+        {
+            same_order = stl_iter != stl_copy.end() && *iter == *stl_iter;
+        }
+        same_order = same_order && stl_iter == stl_copy.end();
+
+        bool same_reverse_order = true;
+        auto stl_reverse_iter = stl_copy.rbegin();
+        for(auto iter = snapshot.end(); same_reverse_order && iter != snapshot.begin();)
+        {
+            --iter;
+            same_reverse_order = stl_reverse_iter != stl_copy.rend() && *iter == *stl_reverse_iter++;
+        }
+        same_reverse_order = same_reverse_order && stl_reverse_iter == stl_copy.rend();
+
+        bool same_search = true;
+        for(int number = 0; number <= random_range; ++number)
+        {
+            auto found = snapshot.search(number);
+            same_search = same_search && (found != snapshot.end()) == (stl_copy.count(number) == 1);
+            same_search = same_search && (found == snapshot.end() || *found == number);
+        }
+
+        if(verbose)
+        {
+            std::cout << "[Checking snapshot of size: " << std::setw(5) << stl_copy.size() << "] ";
+            std::cout << "order: " << get_yes_no(same_order && same_reverse_order) << "; ";
+            std::cout << "search: " << get_yes_no(same_search) << std::endl;
+        }
+
+        total_test_result = total_test_result && same_order && same_reverse_order && same_search;
+    }
+
+    std::cout << "Total test12 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Builds pairs of sets of different sizes and overlaps and checks their
+// unions, intersections and differences against the std:: algorithms,
+// both when the sets are copied (they must stay intact) and when they're
+// given up; then splits a tree by every one of a few values and joins
+// the parts back.
+bool test13(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    std::srand(1);
+    bool total_test_result = true;
+
+    for(unsigned int second_size : {0u, 1u, sample_size / 100, sample_size / 2, sample_size})
+    {
+        std::vector<int> first_numbers;
+        std::vector<int> second_numbers;
+        for(int i = 0; i < sample_size; ++i)
+        {
+            first_numbers.push_back(get_random_int(random_range));
+        }
+        for(int i = 0; i < second_size; ++i)
+        {
+            second_numbers.push_back(get_random_int(random_range));
+        }
+        std::set<int> stl_first(first_numbers.begin(), first_numbers.end());
+        std::set<int> stl_second(second_numbers.begin(), second_numbers.end());
+
+        std::vector<int> stl_union;
+        std::vector<int> stl_intersection;
+        std::vector<int> stl_difference;
+        std::set_union(stl_first.begin(), stl_first.end(), stl_second.begin(), stl_second.end(), std::back_inserter(stl_union));
+        std::set_intersection(stl_first.begin(), stl_first.end(), stl_second.begin(), stl_second.end(), std::back_inserter(stl_intersection));
+        std::set_difference(stl_first.begin(), stl_first.end(), stl_second.begin(), stl_second.end(), std::back_inserter(stl_difference));
+
+        // The sets are filled by insertions, so that their shapes aren't
+        // as regular as those of the sets built out of sorted values.
+        sg::set<int> sg_first;
+        sg::set<int> sg_second;
+        for(int number : first_numbers)
+        {
+            sg_first.insert(number);
+        }
+        for(int number : second_numbers)
+        {
+            sg_second.insert(number);
+        }
+
+        auto same_values = [](auto& sg_set, const auto& stl_values)
+        {
+            bool same = sg_set.size() == stl_values.size();
+            auto stl_iter = stl_values.begin();
+            for(auto iter = sg_set.begin(); same && iter != sg_set.end(); ++iter, ++stl_iter)
+            {
+                same = *iter == *stl_iter;
+            }
+            return same;
+        };
+
+        sg::set<int> sg_union = sg::set_union(sg_first, sg_second);
+        sg::set<int> sg_intersection = sg::set_intersection(sg_first, sg_second);
+        sg::set<int> sg_difference = sg::set_difference(sg_first, sg_second);
+        bool same_copied = same_values(sg_union, stl_union) && same_values(sg_intersection, stl_intersection) &&
+                           same_values(sg_difference, stl_difference);
+        bool same_inputs = same_values(sg_first, stl_first) && same_values(sg_second, stl_second);
+
+        // Ranked and threaded trees have more links to keep right.
+        sg::set<int, std::less<int>, sg::pool_t, true, true> augmented_first;
+        sg::set<int, std::less<int>, sg::pool_t, true, true> augmented_second;
+        for(int number : first_numbers)
+        {
+            augmented_first.insert(number);
+        }
+        for(int number : second_numbers)
+        {
+            augmented_second.insert(number);
+        }
+        auto augmented_union = sg::set_union(std::move(augmented_first), std::move(augmented_second));
+        bool same_ranks = true;
+        for(int i = 0; i < stl_union.size(); ++i)
+        {
+            same_ranks = same_ranks && *augmented_union.select(i) == stl_union[i] && augmented_union.rank(stl_union[i]) == i;
+        }
+        std::vector<int> reversed;
+        for(auto iter = augmented_union.end(); iter != augmented_union.begin();)
+        {
+            reversed.push_back(*--iter);
+        }
+        bool same_augmented = same_values(augmented_union, stl_union) && same_ranks &&
+                              std::equal(reversed.rbegin(), reversed.rend(), stl_union.begin(), stl_union.end());
+
+        sg::set<int> sg_moved_union = sg::set_union(sg::set<int>{sg_first}, sg::set<int>{sg_second});
+        sg::set<int> sg_moved_intersection = sg::set_intersection(sg::set<int>{sg_first}, sg::set<int>{sg_second});
+        sg::set<int> sg_moved_difference = sg::set_difference(std::move(sg_first), std::move(sg_second));
+        bool same_moved = same_values(sg_moved_union, stl_union) && same_values(sg_moved_intersection, stl_intersection) &&
+                          same_values(sg_moved_difference, stl_difference);
+
+        if(verbose)
+        {
+            std::cout << "[Checking sizes: " << std::setw(5) << stl_first.size() << ", " << std::setw(5) << stl_second.size() << "] ";
+            std::cout << "copied: " << get_yes_no(same_copied && same_inputs) << "; ";
+            std::cout << "moved: " << get_yes_no(same_moved) << "; ";
+            std::cout << "ranked and threaded: " << get_yes_no(same_augmented) << std::endl;
+        }
+
+        total_test_result = total_test_result && same_copied && same_inputs && same_moved && same_augmented;
+    }
+
+    std::set<int> stl_set;
+    sg::rbt_t<int> sg_tree;
+    for(int i = 0; i < sample_size; ++i)
+    {
+        int random_number = get_random_int(random_range);
+        stl_set.insert(random_number);
+        sg_tree.insert(random_number);
+    }
+    bool same_split = true;
+    for(int number = -1; number <= random_range + 1; number += random_range / 10)
+    {
+        sg::rbt_t<int> lower;
+        sg::rbt_t<int> upper;
+        bool found = sg_tree.split(number, lower, upper);
+        same_split = same_split && sg_tree.size() == 0 && found == (stl_set.count(number) == 1);
+        same_split = same_split && lower.size() == std::distance(stl_set.begin(), stl_set.lower_bound(number));
+        same_split = same_split && upper.size() == std::distance(stl_set.upper_bound(number), stl_set.end());
+        same_split = same_split && (lower.size() == 0 || lower.maximal()->value() < number);
+        same_split = same_split && (upper.size() == 0 || number < upper.minimal()->value());
+
+        sg_tree.join(lower, number, upper);
+        stl_set.insert(number);
+        same_split = same_split && sg_tree.size() == stl_set.size() && lower.size() == 0 && upper.size() == 0;
+    }
+    std::vector<int> sg_values;
+    for(sg::node_t<int>* node = sg_tree.minimal(); node != nullptr; node = sg_tree.successor(node))
+    {
+        sg_values.push_back(node->value());
+    }
+    same_split = same_split && std::equal(sg_values.begin(), sg_values.end(), stl_set.begin(), stl_set.end());
+
+    if(verbose)
+        std::cout << "[Checking split and join] same: " << get_yes_no(same_split) << std::endl;
+
+    total_test_result = total_test_result && same_split;
+    std::cout << "Total test13 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Inserts values in increasing, nearly increasing, decreasing and random
+// order, each time both by plain insertion (which starts at the last
+// inserted node) and with random hints, and searches for every number
+// of the range with random hints; std::set is used as a reference.
+bool test14(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    std::srand(1);
+    bool total_test_result = true;
+
+    std::vector<std::pair<std::string, std::vector<int>>> orders;
+    std::vector<int> numbers;
+    for(int i = 0; i < sample_size; ++i)
+    {
+        numbers.push_back(get_random_int(random_range));
+    }
+    orders.emplace_back("random", numbers);
+    std::sort(numbers.begin(), numbers.end());
+    orders.emplace_back("increasing", numbers);
+    orders.emplace_back("decreasing", std::vector<int>(numbers.rbegin(), numbers.rend()));
+    for(int i = 0; i + 1 < sample_size; i += 1 + get_random_int(8))
+    {
+        std::swap(numbers[i], numbers[i + 1]);
+    }
+    orders.emplace_back("nearly increasing", numbers);
+
+    for(const auto& [name, order] : orders)
+    {
+        std::set<int> stl_set;
+        sg::set<int> sg_set;
+        sg::set<int> hinted_set;
+        std::vector<int> hinted_values;
+        bool same_added = true;
+        for(int number : order)
+        {
+            bool stl_added = stl_set.insert(number).second;
+            bool sg_added = sg_set.insert(number).second;
+
+            // Hints are random values of the set, or the end.
+            auto hint = hinted_set.end();
+            if(!hinted_values.empty() && get_random_int(4) != 0)
+                hint = hinted_set.search(hinted_values[get_random_int(hinted_values.size() - 1)]);
+            unsigned int hinted_size = hinted_set.size();
+            auto hinted = hinted_set.insert(hint, number);
+            bool hinted_added = hinted_set.size() != hinted_size;
+            if(hinted_added)
+                hinted_values.push_back(number);
+
+            same_added = same_added && stl_added == sg_added && stl_added == hinted_added && *hinted == number;
+        }
+
+        bool same_order = sg_set.size() == stl_set.size() && hinted_set.size() == stl_set.size();
+        auto hinted_iter = hinted_set.begin();
+        auto stl_iter = stl_set.begin();
+        for(auto iter = sg_set.begin(); same_order && iter != sg_set.end(); ++iter, ++hinted_iter, ++stl_iter)
+        {
+            same_order = *iter == *stl_iter && *hinted_iter == *stl_iter;
+        }
+
+        bool same_search = true;
+        for(int number = -1; number <= random_range + 1; ++number)
+        {
+            auto hint = hinted_set.search(hinted_values[get_random_int(hinted_values.size() - 1)]);
+            if(get_random_int(8) == 0)
+                hint = hinted_set.end();
+            auto found = hinted_set.search(hint, number);
+            same_search = same_search && (found != hinted_set.end()) == (stl_set.count(number) == 1);
+            same_search = same_search && (found == hinted_set.end() || *found == number);
+        }
+
+        if(verbose)
+        {
+            std::cout << "[Checking " << name << " order] ";
+            std::cout << "insertion: " << get_yes_no(same_added) << "; ";
+            std::cout << "order: " << get_yes_no(same_order) << "; ";
+            std::cout << "search: " << get_yes_no(same_search) << std::endl;
+        }
+
+        total_test_result = total_test_result && same_added && same_order && same_search;
+    }
+
+    std::cout << "Total test14 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Inserts moved values and emplaces values from their constructor
+// arguments, plain and with hints, and checks that no value is ever
+// copied, that a duplicate leaves a moved value as it was, and that
+// the returned iterator points to the value in the set either way;
+// std::set is used as a reference.
+bool test15(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    std::srand(1);
+    std::set<std::string> stl_set;
+    sg::set<counted_string_t> sg_set;
+    counted_string_t::copies = 0;
+
+    bool same_added = true;
+    bool same_position = true;
+    bool kept_duplicates = true;
+    for(int i = 0; i < sample_size; ++i)
+    {
+        // Strings of one repeated letter come from the constructor
+        // arguments; others are built first and moved in.
+        int random_number = get_random_int(random_range);
+        std::string str = random_number % 4 == 0 ? std::string(random_number % 26 + 1, 'a' + random_number % 26) : std::to_string(random_number);
+        bool stl_added = stl_set.insert(str).second;
+
+        bool sg_added = false;
+        if(random_number % 4 == 0)
+        {
+            auto [iter, added] = sg_set.emplace(static_cast<std::size_t>(random_number % 26 + 1), static_cast<char>('a' + random_number % 26));
+            sg_added = added;
+            same_position = same_position && (*iter).value == str;
+        }
+        else if(i % 2 == 0)
+        {
+            counted_string_t value{str};
+            auto [iter, added] = sg_set.insert(std::move(value));
+            sg_added = added;
+            same_position = same_position && (*iter).value == str;
+            kept_duplicates = kept_duplicates && (added || value.value == str);
+        }
+        else
+        {
+            std::size_t size = sg_set.size();
+            auto iter = sg_set.emplace_hint(sg_set.end(), str);
+            sg_added = sg_set.size() != size;
+            same_position = same_position && (*iter).value == str;
+        }
+        same_added = same_added && stl_added == sg_added;
+    }
+
+    bool same_order = sg_set.size() == stl_set.size();
+    auto stl_iter = stl_set.begin();
+    for(auto iter = sg_set.begin(); same_order && iter != sg_set.end(); ++iter, ++stl_iter)
+    {
+        same_order = (*iter).value == *stl_iter;
+    }
+
+    bool no_copies = counted_string_t::copies == 0;
+    if(verbose)
+    {
+        std::cout << "[Checking moved and emplaced values] ";
+        std::cout << "insertion: " << get_yes_no(same_added) << "; ";
+        std::cout << "position: " << get_yes_no(same_position) << "; ";
+        std::cout << "duplicates kept: " << get_yes_no(kept_duplicates) << "; ";
+        std::cout << "order: " << get_yes_no(same_order) << "; ";
+        std::cout << "copies: " << counted_string_t::copies << std::endl;
+    }
+
+    bool total_test_result = same_added && same_position && kept_duplicates && same_order && no_copies;
+    std::cout << "Total test15 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Checks lower_bound, upper_bound and equal_range for every number of
+// the range [-1, random_range + 1], and reads random ranges [a, b)
+// with buffered scans of random capacities; std::set is used as
+// a reference.
+template <typename Tset = sg::set<int>>
+bool test16(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    std::srand(1);
+    std::set<int> stl_set;
+    Tset sg_set;
+    for(int i = 0; i < sample_size; ++i)
+    {
+        int random_number = get_random_int(random_range);
+        stl_set.insert(random_number);
+        sg_set.insert(random_number);
+    }
+
+    auto same_position = [&](auto sg_iter, auto stl_iter)
+    {
+        return (sg_iter == sg_set.end()) == (stl_iter == stl_set.end()) && (sg_iter == sg_set.end() || *sg_iter == *stl_iter);
+    };
+
+    bool same_bounds = true;
+    for(int number = -1; number <= static_cast<int>(random_range) + 1; ++number)
+    {
+        auto [sg_lower, sg_upper] = sg_set.equal_range(number);
+        auto [stl_lower, stl_upper] = stl_set.equal_range(number);
+        same_bounds = same_bounds && same_position(sg_set.lower_bound(number), stl_set.lower_bound(number));
+        same_bounds = same_bounds && same_position(sg_set.upper_bound(number), stl_set.upper_bound(number));
+        same_bounds = same_bounds && same_position(sg_lower, stl_lower) && same_position(sg_upper, stl_upper);
+    }
+
+    bool same_scans = true;
+    int buffer[16];
+    for(int round = 0; round < 100; ++round)
+    {
+        int low = get_random_int(random_range);
+        int high = low + get_random_int(random_range / 10);
+        unsigned int capacity = 1 + get_random_int(15);
+
+        std::vector<int> scanned;
+        auto first = sg_set.lower_bound(low);
+        auto last = sg_set.lower_bound(high);
+        unsigned int count = 0;
+        while((count = sg_set.scan(first, last, buffer, capacity)) != 0)
+        {
+            scanned.insert(scanned.end(), buffer, buffer + count);
+        }
+
+        same_scans = same_scans && first == last;
+        same_scans = same_scans && std::equal(scanned.begin(), scanned.end(), stl_set.lower_bound(low), stl_set.lower_bound(high));
+    }
+
+    if(verbose)
+    {
+        std::cout << "[Checking bounds and scans] ";
+        std::cout << "bounds: " << get_yes_no(same_bounds) << "; ";
+        std::cout << "scans: " << get_yes_no(same_scans) << std::endl;
+    }
+
+    bool total_test_result = same_bounds && same_scans;
+    std::cout << "Total test16 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Saves a set and an empty set as snapshot files and checks that
+// the mapped sets have the same order, searches and lower bounds as
+// std::set, that a copy keeps the mapping alive, and that truncated
+// files and files of another value type are rejected.
+bool test17(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    std::srand(1);
+    const std::string path = "sg_snapshot_test.bin";
+    std::set<int> stl_set;
+    sg::set<int> sg_set;
+    for(int i = 0; i < sample_size; ++i)
+    {
+        int random_number = get_random_int(random_range);
+        stl_set.insert(random_number);
+        sg_set.insert(random_number);
+    }
+    sg_set.save(path);
+
+    bool same_order = false;
+    bool same_search = true;
+    std::unique_ptr<sg::mapped_set<int>> copy;
+    std::unique_ptr<sg::frozen_set<int>> sliced;
+    {
+        sg::mapped_set<int> mapped{path};
+        same_order = mapped.size() == stl_set.size() && std::equal(stl_set.begin(), stl_set.end(), mapped.begin());
+        for(int number = -1; number <= static_cast<int>(random_range) + 1; ++number)
+        {
+            auto stl_bound = stl_set.lower_bound(number);
+            auto mapped_bound = mapped.lower_bound(number);
+            bool found = mapped.search(number) != mapped.end();
+            same_search = same_search && found == (stl_set.count(number) == 1);
+            same_search = same_search && (stl_bound == stl_set.end() ? mapped_bound == mapped.end() : *mapped_bound == *stl_bound);
+        }
+        copy = std::make_unique<sg::mapped_set<int>>(mapped);
+        sliced = std::make_unique<sg::frozen_set<int>>(mapped);
+    }
+    bool same_copy = copy->size() == stl_set.size() && std::equal(stl_set.begin(), stl_set.end(), copy->begin());
+    copy.reset();
+    // A copy to a plain frozen_set keeps the mapping alive on its own as well.
+    same_copy = same_copy && sliced->size() == stl_set.size() && std::equal(stl_set.begin(), stl_set.end(), sliced->begin()) &&
+                sliced->search(*stl_set.begin()) != sliced->end();
+    sliced.reset();
+
+    sg::set<int>{}.save(path);
+    sg::mapped_set<int> empty{path};
+    bool same_empty = empty.size() == 0 && empty.begin() == empty.end() && empty.search(0) == empty.end();
+
+    auto rejected = [&](auto&& open)
+    {
+        try
+        {
+            open();
+        }
+        catch(const std::runtime_error&)
+        {
+            return true;
+        }
+        return false;
+    };
+    sg_set.save(path);
+    bool wrong_type_rejected = rejected([&] { sg::mapped_set<long long> mapped{path}; });
+    std::string contents;
+    {
+        std::ifstream file{path, std::ios::binary};
+        contents.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+    }
+    {
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        file.write(contents.data(), contents.size() - sizeof(int));
+    }
+    bool truncated_rejected = rejected([&] { sg::mapped_set<int> mapped{path}; });
+    std::remove(path.c_str());
+    bool missing_rejected = rejected([&] { sg::mapped_set<int> mapped{path}; });
+    bool same_rejections = wrong_type_rejected && truncated_rejected && missing_rejected;
+
+    if(verbose)
+    {
+        std::cout << "[Checking mapped snapshots] ";
+        std::cout << "order: " << get_yes_no(same_order) << "; ";
+        std::cout << "search: " << get_yes_no(same_search) << "; ";
+        std::cout << "copy: " << get_yes_no(same_copy) << "; ";
+        std::cout << "empty: " << get_yes_no(same_empty) << "; ";
+        std::cout << "rejections: " << get_yes_no(same_rejections) << std::endl;
+    }
+
+    bool total_test_result = same_order && same_search && same_copy && same_empty && same_rejections;
+    std::cout << "Total test17 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+bool test18(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    std::srand(1);
+    sg::set<int, std::less<int>, sg::pool_t, false, false, sg::counting_stats_t> sg_set;
+    sg::tree_stats_t empty = sg_set.stats();
+    bool same_empty = empty.comparisons == 0 && empty.searches == 0 && empty.height == 0 && empty.black_height == 0;
+
+    for(int i = 0; i < sample_size; ++i)
+    {
+        sg_set.insert(get_random_int(random_range));
+    }
+    sg::tree_stats_t inserted = sg_set.stats();
+    bool same_insert = inserted.comparisons > 0 && inserted.searches == 0 && inserted.rebalance_iterations > 0 &&
+                       inserted.left_rotations > 0 && inserted.right_rotations > 0 && inserted.recolorings > 0;
+
+    // Every search compares the key with each node it visits, and then
+    // at most once more with the candidate for being equal to it.
+    for(int number = 0; number < random_range; ++number)
+    {
+        sg_set.search(number);
+    }
+    sg::tree_stats_t searched = sg_set.stats();
+    std::uint64_t depth_count = 0;
+    std::uint64_t visited = 0;
+    for(std::size_t depth = 0; depth < sg::tree_stats_t::depth_count; ++depth)
+    {
+        depth_count += searched.search_depths[depth];
+        visited += depth * searched.search_depths[depth];
+    }
+    std::uint64_t search_comparisons = searched.comparisons - inserted.comparisons;
+    bool same_search = searched.searches == random_range && depth_count == random_range &&
+                       search_comparisons >= visited && search_comparisons <= visited + random_range &&
+                       searched.left_rotations == inserted.left_rotations && searched.recolorings == inserted.recolorings;
+
+    // A red-black tree is never more than twice as high as its black
+    // height, which is at most log2(n + 1).
+    unsigned int log_size = 0;
+    while((2u << log_size) <= sg_set.size() + 1)
+    {
+        ++log_size;
+    }
+    bool same_shape = searched.height <= 2 * searched.black_height && searched.black_height <= log_size + 1 &&
+                      searched.height >= log_size;
+
+    // Increasing values always go to the right, so they only take left
+    // rotations.
+    sg::set<int, std::less<int>, sg::pool_t, false, false, sg::counting_stats_t> sequential;
+    for(int i = 0; i < sample_size; ++i)
+    {
+        sequential.insert(i);
+    }
+    sg::tree_stats_t rotated = sequential.stats();
+    bool same_sequential = rotated.left_rotations > 0 && rotated.right_rotations == 0 &&
+                           rotated.height <= 2 * rotated.black_height;
+
+    if(verbose)
+    {
+        std::cout << "[Checking stats] ";
+        std::cout << "empty: " << get_yes_no(same_empty) << "; ";
+        std::cout << "insert: " << get_yes_no(same_insert) << "; ";
+        std::cout << "search: " << get_yes_no(same_search) << "; ";
+        std::cout << "shape: " << get_yes_no(same_shape) << "; ";
+        std::cout << "sequential: " << get_yes_no(same_sequential) << std::endl;
+    }
+
+    bool total_test_result = same_empty && same_insert && same_search && same_shape && same_sequential;
+    std::cout << "Total test18 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+template <typename Tmap = sg::map<int, std::string>>
+bool test19(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    std::srand(1);
+    std::map<int, std::string> stl_map;
+    Tmap sg_map;
+    auto same_contents = [&](Tmap& map)
+    {
+        if(map.size() != stl_map.size())
+            return false;
+        auto stl_iter = stl_map.begin();
+        for(auto iter = map.begin(); iter != map.end(); ++iter, ++stl_iter)
+        {
+            if(iter->first != stl_iter->first || (*iter).second != stl_iter->second)
+                return false;
+        }
+        return true;
+    };
+
+    // Every operation is repeated on std::map, whose try_emplace and
+    // insert_or_assign tell whether the key was new.
+    bool same_results = true;
+    for(int i = 0; i < sample_size; ++i)
+    {
+        int key = get_random_int(random_range);
+        std::string value = std::to_string(i);
+        switch(i % 4)
+        {
+        case 0:
+            sg_map[key] += value;
+            stl_map[key] += value;
+            break;
+        case 1:
+        {
+            // A value passed to try_emplace isn't moved from, unless
+            // the key is new.
+            std::string moved = value;
+            bool inserted = sg_map.try_emplace(key, std::move(moved)).second;
+            same_results = same_results && inserted == stl_map.try_emplace(key, value).second && (inserted || moved == value);
+            break;
+        }
+        case 2:
+        {
+            auto result = sg_map.insert_or_assign(key, value);
+            same_results = same_results && result.second == stl_map.insert_or_assign(key, value).second && result.first->second == value;
+            break;
+        }
+        default:
+            same_results = same_results && sg_map.erase(key) == stl_map.erase(key);
+            break;
+        }
+    }
+    bool same_insert = same_results && same_contents(sg_map);
+
+    bool same_search = true;
+    for(int key = -1; key <= static_cast<int>(random_range) + 1; ++key)
+    {
+        auto iter = sg_map.find(key);
+        auto stl_iter = stl_map.find(key);
+        same_search = same_search && (stl_iter == stl_map.end() ? iter == sg_map.end() : iter->second == stl_iter->second);
+    }
+
+    // Copies have mapped values of their own, which is checked by changing
+    // every value of the copy.
+    Tmap copy{sg_map};
+    for(auto iter = copy.begin(); iter != copy.end(); ++iter)
+    {
+        iter->second += "!";
+    }
+    bool same_copy = same_contents(sg_map) && copy.size() == sg_map.size() &&
+                     (sg_map.size() == 0 || copy.begin()->second == sg_map.begin()->second + "!");
+    copy = sg_map;
+    Tmap moved{std::move(copy)};
+    same_copy = same_copy && same_contents(moved) && copy.size() == 0;
+
+    while(sg_map.size() > stl_map.size() / 2)
+    {
+        stl_map.erase(stl_map.begin());
+        sg_map.erase(sg_map.begin());
+    }
+    bool same_erase = same_contents(sg_map);
+    sg_map.clear();
+    stl_map.clear();
+    same_erase = same_erase && same_contents(sg_map) && sg_map.begin() == sg_map.end();
+
+    if(verbose)
+    {
+        std::cout << "[Checking maps] ";
+        std::cout << "insert: " << get_yes_no(same_insert) << "; ";
+        std::cout << "search: " << get_yes_no(same_search) << "; ";
+        std::cout << "copy: " << get_yes_no(same_copy) << "; ";
+        std::cout << "erase: " << get_yes_no(same_erase) << std::endl;
+    }
+
+    bool total_test_result = same_insert && same_search && same_copy && same_erase;
+    std::cout << "Total test19 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Loads random values into sets in bulk mode, empty and already filled
+// ones, with few and with many values at a time and a search now and
+// then, and compares them with std::set after every load; the tree
+// has to be a valid red-black tree afterwards, which the stats of
+// the set tell.
+template <typename Tset>
+bool test20(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    std::srand(1);
+    std::set<int> stl_set;
+    Tset sg_set;
+    bool same_search = true;
+    bool same_order = true;
+    bool same_shape = true;
+
+    // The loads grow from a tenth of the sample to the whole of it,
+    // and then shrink to a few values, which go in one by one.
+    for(unsigned int load_size : {sample_size / 10, sample_size, sample_size / 100, 1u})
+    {
+        sg_set.begin_bulk();
+        for(unsigned int i = 0; i < load_size; ++i)
+        {
+            int random_number = get_random_int(random_range);
+            stl_set.insert(random_number);
+            sg_set.bulk_insert(random_number);
+            if(i % 1000 == 999)
+            {
+                int searched = get_random_int(random_range);
+                auto sg_iter = sg_set.search(searched);
+                bool stl_found = stl_set.find(searched) != stl_set.end();
+                same_search = same_search && (sg_iter != sg_set.end()) == stl_found && (!stl_found || *sg_iter == searched);
+            }
+        }
+        sg_set.end_bulk();
+
+        same_order = same_order && sg_set.size() == stl_set.size() &&
+                     std::equal(stl_set.begin(), stl_set.end(), sg_set.begin());
+        sg::tree_stats_t shape = sg_set.stats();
+        same_shape = same_shape && shape.height <= 2 * shape.black_height;
+    }
+
+    // In bulk mode, insert still tells whether the value is new, buffered
+    // values included, and outside of it insertions go on as usual.
+    int number = random_range + 1;
+    sg_set.begin_bulk();
+    sg_set.bulk_insert(number);
+    auto [found, found_added] = sg_set.insert(number);
+    bool same_insert = !found_added && found != sg_set.end() && *found == number;
+    sg_set.bulk_insert(number + 1);
+    auto [iter, added] = sg_set.insert(number + 2);
+    same_insert = same_insert && added && iter != sg_set.end() && *iter == number + 2 && sg_set.search(number + 1) != sg_set.end();
+    sg_set.end_bulk();
+    same_insert = same_insert && !sg_set.insert(number).second && sg_set.insert(number + 3).second;
+
+    // Values that own memory are moved within the buffer as it's merged
+    // with the tree, and must come out of it whole.
+    sg::set<std::vector<int>> sg_vectors;
+    sg_vectors.insert(std::vector<int>{0});
+    sg_vectors.begin_bulk();
+    for(int i = 1; i <= 5; ++i)
+    {
+        sg_vectors.bulk_insert(std::vector<int>(3, i));
+    }
+    sg_vectors.end_bulk();
+    bool same_vectors = sg_vectors.size() == 6;
+    for(int i = 1; same_vectors && i <= 5; ++i)
+    {
+        same_vectors = sg_vectors.search(std::vector<int>(3, i)) != sg_vectors.end();
+    }
+
+    if(verbose)
+    {
+        std::cout << "[Checking bulk loads] ";
+        std::cout << "search: " << get_yes_no(same_search) << "; ";
+        std::cout << "order: " << get_yes_no(same_order) << "; ";
+        std::cout << "shape: " << get_yes_no(same_shape) << "; ";
+        std::cout << "insert: " << get_yes_no(same_insert) << "; ";
+        std::cout << "vectors: " << get_yes_no(same_vectors) << std::endl;
+    }
+
+    bool total_test_result = same_search && same_order && same_shape && same_insert && same_vectors;
+    std::cout << "Total test20 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Checks a static set built at compile time against std::set holding
+// the same keys: the size, iteration in both directions, and search
+// and lower_bound for every number of the range [-1, range + 1].
+// Both the size and the range are template parameters, as the set is
+// made by the compiler.
+template <std::size_t Vsize, unsigned int Vrange>
+bool test21(bool verbose = true)
+{
+    constexpr sg::static_set<int, Vsize> static_set = make_static_set<Vsize>(Vrange);
+    static_assert(static_set.size() <= Vsize && static_set.begin() != static_set.end(), "sg::static_set isn't built at compile time");
+
+    std::set<int> stl_set;
+    static_keys_t<Vsize> keys;
+    unsigned int state = 1;
+    for(int& value : keys.values)
+    {
+        state = state * 1664525 + 1013904223;
+        value = state % Vrange;
+        stl_set.insert(value);
+    }
+
+    bool same_order = static_set.size() == stl_set.size() && std::equal(stl_set.begin(), stl_set.end(), static_set.begin());
+    auto static_iter = static_set.end();
+    bool same_reverse_order = true;
+    for(auto stl_iter = stl_set.rbegin(); stl_iter != stl_set.rend(); ++stl_iter)
+    {
+        same_reverse_order = same_reverse_order && *(--static_iter) == *stl_iter;
+    }
+    same_reverse_order = same_reverse_order && static_iter == static_set.begin();
+
+    bool same_search = true;
+    for(int number = -1; number <= static_cast<int>(Vrange) + 1; ++number)
+    {
+        auto stl_bound = stl_set.lower_bound(number);
+        auto static_bound = static_set.lower_bound(number);
+        bool found = static_set.search(number) != static_set.end();
+        same_search = same_search && found == (stl_set.count(number) == 1);
+        same_search = same_search && (stl_bound == stl_set.end() ? static_bound == static_set.end() : *static_bound == *stl_bound);
+    }
+
+    // A set of strings, searched by a key of another type.
+    constexpr sg::static_set<std::string_view, 4, sg::compare_three_way_t> words{{"while", "if", "else", "if"}};
+    static_assert(words.size() == 3 && words.search("else") != words.end() && words.search("for") == words.end(),
+                  "sg::static_set isn't searched at compile time");
+    bool same_words = words.search(std::string{"while"}) != words.end() && *words.begin() == "else";
+
+    if(verbose)
+    {
+        std::cout << "[Checking static set of " << static_set.size() << " keys] ";
+        std::cout << "order: " << get_yes_no(same_order) << "; ";
+        std::cout << "reverse order: " << get_yes_no(same_reverse_order) << "; ";
+        std::cout << "search: " << get_yes_no(same_search) << "; ";
+        std::cout << "words: " << get_yes_no(same_words) << std::endl;
+    }
+
+    bool total_test_result = same_order && same_reverse_order && same_search && same_words;
+    std::cout << "Total test21 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
+}
+
+// Checks the iterators of lean sets, which carry the path to their node
+// instead of following parent links: the neighbours of every value just
+// inserted, whose path is rebuilt after the rotations, a walk backwards
+// from the end and steps both ways from a value found.
+bool test22(unsigned int sample_size, unsigned int random_range, bool verbose = true)
+{
+    std::srand(1);
+    std::set<int> stl_set;
+    sg::lean_set<int> lean_set;
+
+    bool same_neighbours = true;
+    for(int i = 0; i < sample_size; ++i)
+    {
+        int random_number = get_random_int(random_range);
+        auto [iter, added] = lean_set.insert(random_number);
+        auto [stl_iter, stl_added] = stl_set.insert(random_number);
+        same_neighbours = same_neighbours && added == stl_added && *iter == random_number;
+
+        auto next = iter;
+        ++next;
+        auto stl_next = std::next(stl_iter);
+        same_neighbours = same_neighbours && (stl_next == stl_set.end() ? next == lean_set.end() : next != lean_set.end() && *next == *stl_next);
+        auto previous = iter;
+        if(stl_iter == stl_set.begin())
+        {
+            same_neighbours = same_neighbours && previous == lean_set.begin();
+        }
+        else
+        {
+            --previous;
+            same_neighbours = same_neighbours && *previous == *std::prev(stl_iter);
+        }
+    }
+
+    bool same_reverse = true;
+    auto iter = lean_set.end();
+    for(auto stl_iter = stl_set.rbegin(); same_reverse && stl_iter != stl_set.rend(); ++stl_iter)
+    {
+        --iter;
+        same_reverse = *iter == *stl_iter;
+    }
+    same_reverse = same_reverse && iter == lean_set.begin();
+
+    // Postfix steps give the old position, and a step back from the end
+    // and forth again lands on the end.
+    int middle = *std::next(stl_set.begin(), stl_set.size() / 2);
+    auto found = lean_set.search(middle);
+    auto before = found++;
+    bool same_steps = *before == middle && *found == *std::next(stl_set.find(middle));
+    before = found--;
+    same_steps = same_steps && *before == *std::next(stl_set.find(middle)) && *found == middle;
+    auto last = lean_set.end();
+    --last;
+    same_steps = same_steps && *last == *stl_set.rbegin() && ++last == lean_set.end();
+
+    if(verbose)
+    {
+        std::cout << "[Checking lean iterators] ";
+        std::cout << "neighbours: " << get_yes_no(same_neighbours) << "; ";
+        std::cout << "reverse: " << get_yes_no(same_reverse) << "; ";
+        std::cout << "steps: " << get_yes_no(same_steps) << std::endl;
+    }
+
+    bool total_test_result = same_neighbours && same_reverse && same_steps;
+    std::cout << "Total test22 result: " << get_yes_no(total_test_result) << std::endl;
+    return total_test_result;
 }
 
-int main_tests(int argc, char** argv)
+int main(int argc, char** argv)
 {
-    test0(10000, 1000, false);
-    test1(10000, 20000, false);
+    // Every test runs even if an earlier one fails, so that the output
+    // shows all the failures at once.
+    bool passed = true;
+    passed = test0(10000, 1000, false) && passed;
+    passed = test1(10000, 20000, false) && passed;
+    passed = test2(10000, 20000, false) && passed;
+    passed = test0<sg::btree_set<int>>(10000, 1000, false) && passed;
+    passed = test1<sg::btree_set<int>>(10000, 20000, false) && passed;
+    passed = test2<sg::btree_set<int>>(10000, 20000, false) && passed;
+    passed = test0<sg::compact_set<int>>(10000, 1000, false) && passed;
+    passed = test1<sg::compact_set<int>>(10000, 20000, false) && passed;
+    passed = test2<sg::compact_set<int>>(10000, 20000, false) && passed;
+    passed = test0<sg::lean_set<int>>(10000, 1000, false) && passed;
+    passed = test1<sg::lean_set<int>>(10000, 20000, false) && passed;
+    passed = test2<sg::lean_set<int>>(10000, 20000, false) && passed;
+    passed = test3(10000, 20000, false) && passed;
+    passed = test4(1000, 2000, false) && passed;
+    passed = test5(10000, 20000, false) && passed;
+    passed = test6(10000, 20000, false) && passed;
+    passed = test7(1000, 2000, false) && passed;
+    passed = test8(10000, 20000, false) && passed;
+    passed = test9(300, 600, false) && passed;
+    passed = test10(100000, 200000, false) && passed;
+    passed = test11(200000, 20000, false) && passed;
+    passed = test12(3000, 6000, false) && passed;
+    passed = test13(20000, 40000, false) && passed;
+    passed = test14(10000, 20000, false) && passed;
+    passed = test15(10000, 2000, false) && passed;
+    passed = test16(10000, 20000, false) && passed;
+    passed = test16<sg::set<int, std::less<int>, sg::pool_t, false, true>>(10000, 20000, false) && passed;
+    passed = test16<sg::set<int, sg::compare_three_way_t>>(10000, 20000, false) && passed;
+    passed = test17(10000, 20000, false) && passed;
+    passed = test18(10000, 20000, false) && passed;
+    passed = test19(10000, 2000, false) && passed;
+    passed = test19<sg::map<int, std::string, std::less<int>, sg::pool_t, true>>(10000, 2000, false) && passed;
+    passed = test19<sg::map<int, std::string, sg::compare_three_way_t, sg::heap_t, true>>(10000, 2000, false) && passed;
+    passed = test20<sg::set<int, std::less<int>, sg::pool_t, false, false, sg::counting_stats_t>>(100000, 200000, false) && passed;
+    passed = test20<sg::set<int, std::less<int>, sg::pool_t, true, true, sg::counting_stats_t>>(100000, 200000, false) && passed;
+    passed = test21<1, 10>(false) && passed;
+    passed = test21<7, 1000>(false) && passed;
+    passed = test21<1000, 2000>(false) && passed;
+    passed = test22(10000, 20000, false) && passed;
+    passed = test22(100000, 1000000, false) && passed;
 
-    return 0;
+    return passed ? 0 : 1;
 }